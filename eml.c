@@ -1,7 +1,24 @@
 #include "eml.h"
 #include <stdio.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// eml_ingest() reads through io_uring where the kernel headers have it, & falls back to blocking reads elsewhere
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #include <sys/syscall.h>
+        #define EML_IO_URING
+    #endif
+#endif
 
 // #define EML_PARSER_VERSION "0.0.0"
 // #define DEBUG
@@ -13,28 +30,472 @@
 
 #define MAX_FORMATTED_EML_STRING_LENGTH 12
 
+#define EML_FROZEN_MAGIC 0x4C4D4546 // "FEML"
+
+// Number of candidate singles a query filters at a time
+#define QUERY_BATCH_SIZE 64
+
+#define EML_INDEX_MAGIC 0x494C4D45 // "EMLI"
+#define EML_CORPUS_MAGIC 0x434C4D45 // "EMLC"
+#define EML_LOG_MAGIC 0x4C4C4D45 // "EMLL"
+#define EML_AGGREGATE_MAGIC 0x414C4D45 // "EMLA"
+
+// Log files start with the magic & format version
+#define LOG_HEADER_LENGTH 8
+
+// Log records start with the payload length & its CRC-32
+#define LOG_RECORD_HEADER_LENGTH 8
+
+// Aggregates files start with the magic, format version, payload length & its CRC-32
+#define AGGREGATE_HEADER_LENGTH 16
+
+// Alignment of each allocation parse_exact() carves from its block
+#define ARENA_ALIGNMENT 16
+
+// Fewest body bytes parse_parallel() gives a thread; smaller documents use fewer threads
+#define PARALLEL_MIN_CHUNK 65536
+
+// Files each eml_ingest() worker keeps in flight, & the size its (recycled) read buffers start at
+#define INGEST_QUEUE_DEPTH 32
+#define INGEST_BUFFER_SIZE 4096
+
+// Width of a rollup bucket in seconds
+#define ROLLUP_WEEK 604800
+
+// eml_template_compile() parses placeholder N as TEMPLATE_MARKER + N, then as TEMPLATE_PROBE + N, to find where it lands
+#define TEMPLATE_MARKER 11000000U
+#define TEMPLATE_PROBE 12000000U
+#define TEMPLATE_MAX_SLOTS 1000000U
+
+// Bytes of CSV an eml_csv_writer buffers before handing them to its sink
+#define CSV_BUFFER_SIZE 65536
+
+// csv_row() set of a row standing for more than one set (or none)
+#define CSV_NO_SET 0xFFFFFFFFU
+
+// FNV-1a (64 bit) parameters used by eml_hash
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+// 1 lbs = 0.45359237 kg, as a ratio of integers so conversions round exactly
+#define KG_PER_LBS_NUMERATOR 45359237ULL
+#define KG_PER_LBS_DENOMINATOR 100000000ULL
+
+/*
+ * Stats (-DEML_STATS): STAT counts into the calling thread's eml_stats, STAT_TIMER/STAT_ELAPSED time a span of code.
+ * Without EML_STATS they expand to nothing, and malloc/calloc/realloc are the C library's own. The allocator macros
+ * are undefined at the end of this file.
+ */
+#ifdef EML_STATS
+    static _Thread_local eml_stats stats;
+
+    static uint64_t stats_now(void);
+    static void *stats_malloc(size_t size);
+    static void *stats_calloc(size_t count, size_t size);
+    static void *stats_realloc(void *p, size_t size);
+
+    #define STAT(field, n) (stats.field += (n))
+    #define STAT_TIMER(t) uint64_t t = stats_now()
+    #define STAT_ELAPSED(field, t) (stats.field += stats_now() - (t))
+
+    #define malloc(size) stats_malloc(size)
+    #define calloc(count, size) stats_calloc(count, size)
+    #define realloc(p, size) stats_realloc(p, size)
+#else
+    #define STAT(field, n) ((void)0)
+    #define STAT_TIMER(t)
+    #define STAT_ELAPSED(field, t) ((void)0)
+#endif
+
 #define true 1
 #define false 0
 #define right 1
 #define left 0
 
 /* 
- * Parser Parameters:
+ * Parser Parameters (per thread, so documents may be parsed on several threads at once):
  * version - the version in the eml header
  * weightUnit - the weight abbreviation in the eml header
  */ 
-static char version[MAX_VERSION_STRING_LENGTH + 1];
-static char weightUnit[MAX_WEIGHT_UNIT_STRING_LENGTH + 1];
+static _Thread_local char version[MAX_VERSION_STRING_LENGTH + 1];
+static _Thread_local char weightUnit[MAX_WEIGHT_UNIT_STRING_LENGTH + 1];
+
+/*
+ * parse_arena - The block parse_exact() parses into. While `base` is set, parse_alloc() carves from it (failing once
+ *               `size` is used up) & parse_release() does nothing. `objects` is the prescanned top level object count.
+ */
+typedef struct ParseArena {
+    uint8_t  *base;
+    uint64_t used;
+    uint64_t size;
+    uint32_t objects;
+} parse_arena;
+
+static _Thread_local parse_arena arena;
+
+/*
+ * parse_chunk - A run of top level objects parse_parallel() gives a thread: bytes [begin, end) of `eml_string`, parsed
+ *               into `result`, or failing with `error` at `offset` (from the start of the document). `failed` is
+ *               shared by the chunks: the lowest index of a chunk that failed, past which chunks are not parsed.
+ */
+typedef struct ParseChunk {
+    char                 *eml_string;
+    uint32_t             begin;
+    uint32_t             end;
+    uint32_t             index;
+    atomic_uint_fast32_t *failed;
+    eml_result           *result;
+    int                  error;
+    uint32_t             offset;
+    pthread_t            thread;
+    bool                 started;
+} parse_chunk;
+
+/*
+ * name_table - Interns strings to dense ids. Slots hold id + 1 (0 is empty) in an open addressed, power of two table.
+ */
+typedef struct NameTable {
+    char     **names;
+    uint32_t *slots;
+    uint32_t count;
+    uint32_t capacity;
+} name_table;
+
+/*
+ * index_entry - A posting of term `term` collected while building an index.
+ */
+typedef struct IndexEntry {
+    uint32_t term;
+    uint32_t doc;
+    uint32_t obj;
+    uint32_t flags;
+} index_entry;
+
+/*
+ * index_order - A term id & name, sorted by name to lay out an index's term table.
+ */
+typedef struct IndexOrder {
+    char     *name;
+    uint32_t term;
+} index_order;
+
+/*
+ * postings_cursor - Decodes a postings list one eml_posting at a time.
+ */
+typedef struct PostingsCursor {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t      remaining;
+    bool          first;
+    eml_posting   last;
+} postings_cursor;
+
+/*
+ * rollup_entry - The point of one exercise side & week while rolling up.
+ */
+typedef struct RollupEntry {
+    uint32_t         name;
+    uint32_t         side;
+    eml_rollup_point point;
+} rollup_entry;
+
+/*
+ * rollup_table - A (partial) rollup: entries keyed by (name, side, week) in an open addressed, power of two table.
+ *                Slots hold entry index + 1 (0 is empty).
+ */
+typedef struct RollupTable {
+    name_table   names;
+    rollup_entry *entries;
+    uint32_t     *slots;
+    uint32_t     count;
+    uint32_t     capacity;
+} rollup_table;
+
+/*
+ * rollup_worker - A thread's slice of the sessions & its partial rollup.
+ */
+typedef struct RollupWorker {
+    eml_session  *sessions;
+    uint32_t     count;
+    rollup_table table;
+    int          error;
+} rollup_worker;
+
+/*
+ * rollup_order - A rollup entry & its name, sorted by name, side & week to lay out an eml_rollup.
+ */
+typedef struct RollupOrder {
+    const char   *name;
+    rollup_entry *entry;
+} rollup_order;
+
+/*
+ * byte_buffer - A growable run of bytes.
+ */
+typedef struct ByteBuffer {
+    uint8_t  *data;
+    uint64_t length;
+    uint64_t capacity;
+} byte_buffer;
+
+/*
+ * log_name - A name of a log's dictionary while replaying, pointing into the mapped log.
+ */
+typedef struct LogName {
+    const char *name;
+    uint32_t   length;
+} log_name;
+
+/*
+ * log_dictionary - The names introduced by a log's records so far, by id.
+ */
+typedef struct LogDictionary {
+    log_name *names;
+    uint32_t count;
+    uint32_t capacity;
+} log_dictionary;
+
+/*
+ * Log - See eml_log. `names` mirrors the dictionary of the records on disk, `body` & `record` are reused by appends.
+ */
+struct Log {
+    int         fd;
+    bool        durable;
+    uint64_t    size;
+    name_table  names;
+    byte_buffer body;
+    byte_buffer record;
+};
+
+/*
+ * work_entry - A canonical work node of a WorkTable, with its frozen kind, content hash & size in bytes.
+ */
+typedef struct WorkEntry {
+    uint64_t hash;
+    void     *node;
+    uint32_t kind;
+    uint32_t size;
+} work_entry;
+
+/*
+ * WorkTable - See eml_work_table. An open addressed, power of two set of work nodes (node NULL is empty).
+ */
+struct WorkTable {
+    pthread_mutex_t lock;
+    work_entry      *entries;
+    uint32_t        count;
+    uint32_t        capacity;
+    uint64_t        references;
+    uint64_t        bytes_saved;
+};
+
+/*
+ * template_placeholder - A "$N" of a template's text, at bytes [begin, end).
+ */
+typedef struct TemplatePlaceholder {
+    uint32_t begin;
+    uint32_t end;
+    uint32_t slot;
+} template_placeholder;
+
+/*
+ * template_target - Where a template writes the value of `slot`: the eml_number `offset` bytes into its block, a reps
+ *                   value (which must be integral) if `reps`, otherwise a weight/RPE modifier.
+ */
+typedef struct TemplateTarget {
+    uint32_t offset;
+    uint32_t slot;
+    bool     reps;
+} template_target;
+
+/*
+ * Template - See eml_template. `block` (`size` bytes) is the parse_exact() block of the template parsed with markers
+ *            for placeholders; the result is `result_offset` bytes into it.
+ */
+struct Template {
+    char                 *text;
+    uint32_t             length;
+    template_placeholder *placeholders;
+    uint32_t             placeholder_count;
+    uint32_t             slots;
+    char                 *block;
+    uint64_t             size;
+    uint64_t             result_offset;
+    template_target      *targets;
+    uint32_t             target_count;
+    uint32_t             target_capacity;
+};
+
+/*
+ * diff_entry - A performed single for eml_diff() to match, chained to the next performed single of the same name.
+ */
+typedef struct DiffEntry {
+    eml_single_t *single;
+    uint64_t     hash;
+    uint32_t     obj;
+    uint32_t     member;
+    uint32_t     next; // Index + 1 of the next entry of this name, 0 for none
+    bool         matched;
+} diff_entry;
+
+/*
+ * diff_slot - A name of a diff_index: the first (`key`), first unmatched (`head`) & last (`tail`) of its entries, each
+ *             index + 1. An empty slot has key 0; `key` is never cleared, so probing passes names all matched.
+ */
+typedef struct DiffSlot {
+    uint32_t key;
+    uint32_t head;
+    uint32_t tail;
+} diff_slot;
+
+/*
+ * diff_index - The performed singles of an eml_diff() in document order & an open addressed, power of two table of
+ *              their names.
+ */
+typedef struct DiffIndex {
+    diff_entry *entries;
+    uint32_t   count;
+    diff_slot  *slots;
+    uint32_t   capacity;
+} diff_index;
+
+/*
+ * CsvWriter - See eml_csv_writer. `prefix` holds the fields every row of the current document starts with (its header
+ *             values), `lead` those every row of the current single & side does. Each top level object is parsed into
+ *             `scratch`, a parse_exact() block reused from object to object; an object split across writes is gathered
+ *             in `pending`. `offset` is the input offset of the first byte not yet transcoded, `scanned`, `member` &
+ *             `quoted` how far the search for the end of the unit starting there has got, so each byte is searched
+ *             once however the input is split.
+ */
+struct CsvWriter {
+    eml_csv_sink sink;
+    void         *context;
+    uint32_t     rows;
+    const char   **columns;
+    uint32_t     column_count;
+    byte_buffer  prefix;
+    byte_buffer  lead;
+    byte_buffer  out;
+    byte_buffer  pending;
+    uint8_t      *scratch;
+    uint64_t     scratch_size;
+    uint64_t     offset;
+    uint32_t     scanned;
+    bool         member;
+    bool         quoted;
+    uint32_t     documents;
+    uint32_t     objects;
+    int          error;
+};
+
+/*
+ * Lazy - See eml_lazy. `entries` holds the `count` (of `capacity`) top level objects found, `results` each one's
+ *        parse_exact() result once it has been asked for (NULL until then) & `head` the document's header.
+ */
+struct Lazy {
+    char           *document;
+    uint32_t       length;
+    eml_result     *head;
+    eml_lazy_entry *entries;
+    eml_result     **results;
+    uint32_t       count;
+    uint32_t       capacity;
+};
+
+/*
+ * Aggregates - See eml_aggregates. `entries` are in the order they were first seen; `keys` maps name id * 3 + side
+ *              (ids from `names`) to entry index + 1 (0 for none yet), so a set finds its entry without a search.
+ */
+struct Aggregates {
+    name_table    names;
+    eml_aggregate *entries;
+    uint32_t      count;
+    uint32_t      capacity;
+    uint32_t      *keys;
+    uint32_t      key_capacity;
+};
+
+/*
+ * Shared - See eml_shared. `references` starts at 1 for the handle eml_share() returns.
+ */
+struct Shared {
+    atomic_uint_fast32_t references;
+    eml_result           *result;
+};
+
+/*
+ * ingest_job - An eml_ingest() call shared by its workers. Files are claimed in order through `next`; `stop` holds the
+ *              first non-zero callback return.
+ */
+typedef struct IngestJob {
+    const char           **paths;
+    uint32_t             count;
+    atomic_uint_fast32_t next;
+    atomic_int           stop;
+    eml_ingest_callback  callback;
+    void                 *context;
+} ingest_job;
+
+/*
+ * ingest_slot - A file in flight & the buffer it is read into. Buffers stay with their slot & are reused, only
+ *               growing for larger files.
+ */
+typedef struct IngestSlot {
+    uint32_t i;
+    int      fd;
+    char     *buffer;
+    uint64_t capacity;
+    uint64_t length;
+} ingest_slot;
+
+/*
+ * ingest_worker - A thread of eml_ingest(), with its own slots (& so its own parser state, which is thread local).
+ */
+typedef struct IngestWorker {
+    ingest_job  *job;
+    ingest_slot slots[INGEST_QUEUE_DEPTH];
+    int         error;
+} ingest_worker;
+
+#ifdef EML_IO_URING
+/*
+ * ingest_ring - An io_uring mapped by ingest_ring_init(). `tail` is the local submission tail, published on submit.
+ */
+typedef struct IngestRing {
+    int                 fd;
+    void                *sq_ring;
+    size_t              sq_ring_size;
+    void                *cq_ring;
+    size_t              cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t              sqes_size;
+    uint32_t            *sq_tail;
+    uint32_t            *sq_mask;
+    uint32_t            *sq_array;
+    uint32_t            *cq_head;
+    uint32_t            *cq_tail;
+    uint32_t            *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint32_t            tail;
+    uint32_t            queued;
+} ingest_ring;
+#endif
+
+/*
+ * crc32_table - Lookup table for crc32(), built once by build_crc32_table().
+ */
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
 
 /*
- * Global Parser Vars:
+ * Global Parser Vars (per thread):
  * emlString - The eml to be parsed
  * emlstringlen - The length of the emlString (excluding sentinel)
  * current_position - The index of emlString the parser is currently on
  */
-static char *emlString;
-static int emlstringlen;
-static int current_postition;
+static _Thread_local char *emlString;
+static _Thread_local uint32_t emlstringlen;
+static _Thread_local uint32_t current_postition;
 
 static int parse_header(eml_result *result);
 
@@ -43,54 +504,212 @@ static void validate_header_t(eml_header_t *h);
 static int parse_string(char **result);
 
 static int parse_header_t(eml_header_t **tht);
-static int parse_super_t(eml_super_t **tsupt);
-static int parse_single_t(eml_single_t **tst);
+static int grow_result(eml_result *result);
+static int parse_super_t(eml_super_t *tsupt);
+static int grow_super_t(eml_super_t *s);
+static int parse_single_t(eml_single_t *tst);
 
 static int applying_reps_type(eml_reps *r, uint32_t t);
 static int flush(eml_single_t *tst, uint32_t *vcount, eml_kind_flag kind, eml_modifier_flag mod, eml_number *buf, uint32_t *dcount);
 static void move_to_asymmetric(eml_single_t *tst, bool side);
 static int upgrade_to_asymmetric(eml_single_t *tst);
-static int upgrade_to_standard_varied(eml_single_t *tst);
+static int upgrade_to_standard_varied(eml_single_t *tst, uint32_t sets);
 static int upgrade_to_standard(eml_single_t *tst);
 
+static void *parse_alloc(uint64_t size);
+static void parse_release(void *p);
+static uint64_t arena_size(uint64_t size);
+static uint64_t prescan_string(const char *s, uint32_t length, uint32_t *position);
+static uint64_t prescan_single_t(const char *s, uint32_t length, uint32_t *position);
+static uint64_t prescan_super_t(const char *s, uint32_t length, uint32_t *position, uint32_t *members);
+static uint64_t prescan(const char *s, uint32_t length, uint32_t *objects);
+static void *parse_chunk_run(void *arg);
+
 static void format_eml_number(eml_number *e, char *f);
-static void print_standard_k(eml_standard_k *k);
-static void print_standard_varied_k(eml_standard_varied_k *k);
-static void print_single_t(eml_single_t *s);
-static void print_super_t(eml_super_t *s);
-static void print_emlobj(eml_obj *e);
-
-static void free_single_t(eml_single_t *s);
-static void free_super_t(eml_super_t *s);
+static void print_standard_k(eml_standard_k *k, const char *unit);
+static void print_standard_varied_k(eml_standard_varied_k *k, const char *unit);
+static void print_single_t(eml_single_t *s, const char *unit);
+static void print_super_t(eml_super_t *s, const char *unit);
+static void print_emlobj(eml_obj *e, const char *unit);
+
+static void size_single_t(eml_single_t *s, uint32_t *reps, uint32_t *strings);
+static eml_offset freeze_string(char *base, eml_offset *cursor, char *str);
+static void freeze_work(char *base, eml_offset *reps, eml_frozen_work *w, eml_none_k *n, eml_standard_k *k, eml_standard_varied_k *v);
+static void freeze_single_t(char *base, eml_offset *reps, eml_offset *strings, eml_frozen_single *fs, eml_single_t *s);
+static bool frozen_range_valid(uint32_t size, eml_offset offset, uint64_t length);
+static bool frozen_string_valid(const char *base, uint32_t size, eml_offset offset);
+static bool frozen_work_valid(uint32_t size, eml_frozen_work *w);
+
+static eml_header_t *find_header_t(eml_result *result, const char *parameter);
+static eml_reps *work_reps(eml_single_t *s, bool side, uint32_t *count);
+static uint32_t work_kind(eml_single_t *s, bool side, uint32_t *sets);
+static bool reps_has_weight(eml_reps *r);
+static bool reps_has_modifier(eml_reps *r);
+static uint32_t gather_weights(eml_single_t *s, eml_number **weights);
+static uint32_t lbs_to_kg(eml_number *values, uint32_t count);
+static uint32_t kg_to_lbs(eml_number *values, uint32_t count);
+
+static uint64_t hash_u32(uint64_t h, uint32_t v);
+static uint64_t hash_string(uint64_t h, const char *str);
+static uint64_t hash_mix(uint64_t h);
+static uint64_t hash_single_t(uint64_t h, eml_single_t *s);
+static bool equal_reps(eml_reps *a, eml_reps *b);
+static bool equal_single_t(eml_single_t *a, eml_single_t *b);
+static uint32_t count_header_t(eml_result *result, eml_header_t *h);
+static uint64_t hash_work(uint32_t kind, uint32_t sets, eml_reps *reps, uint32_t count);
+static bool equal_work(work_entry *e, uint32_t kind, uint32_t sets, eml_reps *reps, uint32_t count);
+static int work_table_grow(eml_work_table *t, uint32_t extra);
+static int intern_work(eml_work_table *t, bool owned, eml_none_k **n, eml_standard_k **k, eml_standard_varied_k **v);
+static int intern_single_t(eml_work_table *t, bool owned, eml_single_t *s);
+static void detach_work(eml_single_t *s);
+
+static int template_scan(eml_template *t);
+static int template_splice(eml_template *t, const eml_number *values, char *buffer, uint32_t capacity, uint32_t *length);
+static int template_target_add(eml_template *t, eml_number *marked, eml_number *probed, bool reps);
+static int template_targets(eml_template *t, eml_result *marked, eml_result *probed);
+static int template_check(eml_template *t, const eml_number *values, uint32_t count);
+static void rebase_single_t(eml_single_t *s, char *from, char *to);
+static void rebase_result(eml_result *r, char *from, char *to);
+
+static int diff_index_build(eml_result *performed, diff_index *index);
+static uint32_t diff_index_match(diff_index *index, const char *name);
+static void diff_emit(eml_difference *d, uint32_t kind, uint32_t set, uint32_t planned, uint32_t performed, eml_difference *differences, uint32_t capacity, uint32_t *found);
+static int diff_convert(eml_result *planned, eml_result *performed, uint32_t *convert);
+static void diff_reps(eml_difference *d, uint32_t set, eml_reps *a, eml_reps *b, uint32_t convert, eml_difference *differences, uint32_t capacity, uint32_t *found);
+static void diff_side(eml_difference *d, eml_single_t *a, bool a_side, eml_single_t *b, bool b_side, uint32_t convert, eml_difference *differences, uint32_t capacity, uint32_t *found);
+static void diff_single_t(eml_difference *d, eml_single_t *a, eml_single_t *b, uint32_t convert, eml_difference *differences, uint32_t capacity, uint32_t *found);
+
+static int csv_flush(eml_csv_writer *csv);
+static int csv_text(byte_buffer *b, const char *text, char end);
+static int csv_u32(byte_buffer *b, uint32_t v, char end);
+static int csv_eml_number(byte_buffer *b, eml_number e, char end);
+static int csv_header(eml_csv_writer *csv, eml_result *result);
+static int csv_row(eml_csv_writer *csv, uint32_t set, uint32_t sets, eml_reps *r);
+static int csv_single_t(eml_csv_writer *csv, eml_objtype type, uint32_t member, eml_single_t *s);
+static uint32_t csv_unit_end(eml_csv_writer *csv, const char *s, uint32_t length, uint32_t position);
+static int csv_unit(eml_csv_writer *csv, const char *s, uint32_t length);
+static int csv_transcode(eml_csv_writer *csv, const char *s, uint32_t length, bool last, uint32_t *consumed);
+
+static int lazy_add(eml_lazy *lazy, uint32_t begin, uint32_t end);
+static bool lazy_has_name(eml_lazy *lazy, eml_lazy_entry *e, const char *name, uint32_t length);
+
+static int aggregates_entry(eml_aggregates *a, const char *name, uint32_t side, eml_aggregate **entry);
+static int aggregate_best(eml_aggregate *e, uint32_t reps, uint32_t weight);
+static int aggregate_reps(eml_aggregate *e, uint32_t sets, eml_reps *r);
+static int aggregate_single_t(eml_aggregates *a, eml_single_t *s, int64_t timestamp);
+static int aggregates_decode(eml_aggregates *a, const uint8_t *p, const uint8_t *end);
+
+static bool range_contains(eml_range *r, uint32_t v);
+static uint64_t query_weight(eml_number w, uint32_t convert);
+static uint32_t query_convert(eml_compiled_query *q, eml_result *result);
+static bool query_side(eml_compiled_query *q, eml_single_t *s, bool side, uint32_t convert);
+static uint32_t query_batch(eml_compiled_query *q, eml_query_match *batch, uint32_t n, uint32_t convert, eml_query_match *matches, uint32_t capacity, uint32_t *found);
+
+static int name_table_reserve(name_table *t, uint32_t extra);
+static int name_table_intern(name_table *t, const char *name, uint32_t *id);
+static void name_table_adopt(name_table *t, char *name);
+static void name_table_free(name_table *t);
+static uint32_t write_varint(uint8_t *buf, uint64_t v);
+static bool read_varint(const uint8_t **p, const uint8_t *end, uint64_t *v);
+static int compare_index_order(const void *a, const void *b);
+static int collect_index_entries(eml_result *result, uint32_t doc, name_table *names, index_entry **entries, uint64_t *count, uint64_t *capacity);
+static int write_index(const char *path, name_table *names, index_entry *entries, uint64_t count);
+static const eml_index_term *find_index_term(eml_index *index, const char *name);
+static void open_postings(eml_index *index, const eml_index_term *term, postings_cursor *c);
+static bool next_posting(postings_cursor *c, eml_posting *posting);
+
+static uint32_t rollup_slot(rollup_table *t, uint32_t name, uint32_t side, int64_t week);
+static int rollup_table_point(rollup_table *t, uint32_t name, uint32_t side, int64_t week, eml_rollup_point **point);
+static void rollup_table_free(rollup_table *t);
+static void rollup_reps(eml_rollup_point *p, uint32_t sets, eml_reps *r);
+static int rollup_single_t(rollup_table *t, eml_single_t *s, int64_t week);
+static void *rollup_worker_run(void *arg);
+static void merge_rollup_point(eml_rollup_point *into, eml_rollup_point *from);
+static int compare_rollup_order(const void *a, const void *b);
+
+static int map_file(const char *path, uint64_t minimum, int truncated, const char **base, uint64_t *size);
+static int sync_directory(const char *path);
+
+static int buffer_reserve(byte_buffer *b, uint64_t length);
+static int buffer_varint(byte_buffer *b, uint64_t v);
+static int buffer_bytes(byte_buffer *b, const void *data, uint64_t length);
+static bool read_varint32(const uint8_t **p, const uint8_t *end, uint32_t *v);
+static void build_crc32_table(void);
+static uint32_t crc32(const uint8_t *data, uint64_t length);
+static bool name_table_find(name_table *t, const char *name, uint32_t *id);
+static int log_string(eml_log *log, name_table *fresh, const char *str);
+static int log_single_t(eml_log *log, name_table *fresh, eml_single_t *s);
+static int log_encode(eml_log *log, name_table *fresh, eml_result *result);
+static int log_dictionary_add(log_dictionary *d, const char *name, uint32_t length);
+static int log_read_names(const uint8_t **p, const uint8_t *end, log_dictionary *d);
+static int log_read_string(const uint8_t **p, const uint8_t *end, log_dictionary *d, char **str);
+static int log_read_work(const uint8_t **p, const uint8_t *end, eml_none_k **n, eml_standard_k **k, eml_standard_varied_k **v);
+static int log_read_single_t(const uint8_t **p, const uint8_t *end, log_dictionary *d, eml_single_t *s);
+static int log_decode(const uint8_t *p, const uint8_t *end, log_dictionary *d, eml_result **result);
+static bool log_record(const uint8_t *base, uint64_t size, uint64_t offset, const uint8_t **payload, uint32_t *length);
+static int log_write(int fd, const uint8_t *data, uint64_t length);
+
+static bool ingest_claim(ingest_job *job, ingest_slot *slot);
+static int ingest_grow(ingest_slot *slot);
+static int ingest_finish(ingest_job *job, ingest_slot *slot, int error);
+static int ingest_pread(ingest_worker *w);
+static void *ingest_worker_run(void *arg);
+#ifdef EML_IO_URING
+static int ingest_ring_init(ingest_ring *r, uint32_t entries);
+static void ingest_ring_free(ingest_ring *r);
+static struct io_uring_sqe *ingest_sqe(ingest_ring *r, uint8_t opcode, uint32_t slot);
+static int ingest_submit(ingest_ring *r, uint32_t wait);
+static void ingest_read(ingest_ring *r, ingest_slot *slot, uint32_t s);
+static int ingest_uring(ingest_worker *w, ingest_ring *r);
+static void ingest_drain(ingest_worker *w, ingest_ring *r, bool *busy, uint32_t in_flight);
+#endif
+
+static void clear_single_t(eml_single_t *s);
+static void clear_super_t(eml_super_t *s);
 static void free_emlobj(eml_obj *e);
 
 /*
  * parse: Entry point for parsing eml. Starts at '{', ends at (emlstringlen - 1)
  */
 int parse(char *eml_string, eml_result **result) {
+    size_t length = strlen(eml_string);
+
+    // Offsets are 32 bit
+    if (length > UINT32_MAX) {
+        return string_length_error;
+    }
+
+    return parse_length(eml_string, length, result);
+}
+
+/*
+ * parse_length: Parses the first `length` bytes of `eml_string`, which need not be terminated. `eml_string` is only read.
+ */
+int parse_length(char *eml_string, uint32_t length, eml_result **result) {
     emlString = eml_string;
-    emlstringlen = strlen(eml_string);
+    emlstringlen = length;
     current_postition = 0;
 
     version[0] = 0;
     weightUnit[0] = 0;
 
-    *result = malloc(sizeof(eml_result));
+    *result = parse_alloc(sizeof(eml_result));
     if (*result == NULL) {
         return allocation_error;
     }
 
     (*result)->header = NULL;
     (*result)->objs = NULL;
-
-    eml_obj *obj_tail = NULL;
+    (*result)->count = 0;
+    (*result)->capacity = 0;
+    (*result)->block = NULL;
+    (*result)->works = NULL;
 
     #ifdef DEBUG
         printf("EML String: %s, length: %i\n", eml_string, emlstringlen);
     #endif
 
-    eml_super_t *tsupt = NULL;
-    eml_single_t *tst = NULL;
+    eml_obj *obj = NULL;
     int error = 0;
 
     while (current_postition < emlstringlen) {
@@ -117,70 +736,46 @@ int parse(char *eml_string, eml_result **result) {
 
             break;
         case (int)'s': // Give control to parse_super_t()
-            if ((error = parse_super_t(&tsupt))) {
+            if ((error = grow_result(*result))) {
                 goto bail;
             }
 
-            eml_obj *temp_super = malloc(sizeof(eml_obj));
-            if (temp_super == NULL) {
-                error = allocation_error;
-                goto bail;
-            }
-            temp_super->type = super;
-            temp_super->data = tsupt;
-            temp_super->next = NULL;
+            // Counted before parsing so a partially parsed object is freed with the result
+            obj = &(*result)->objs[(*result)->count++];
+            obj->type = super;
+            STAT(objects, 1);
+            STAT(supers, 1);
 
-            if ((*result)->objs == NULL) {
-                (*result)->objs = temp_super;
-            } else {
-                obj_tail->next = temp_super;
+            if ((error = parse_super_t(&obj->data.super))) {
+                goto bail;
             }
-
-            obj_tail = temp_super;
             break;
         case (int)'c': // Give control to parse_super_t()
-            if ((error = parse_super_t(&tsupt))) {
+            if ((error = grow_result(*result))) {
                 goto bail;
             }
 
-            eml_obj *temp_circuit = malloc(sizeof(eml_obj));
-            if (temp_circuit == NULL) {
-                error = allocation_error;
-                goto bail;
-            }
-            temp_circuit->type = circuit;
-            temp_circuit->data = tsupt;
-            temp_circuit->next = NULL;
+            obj = &(*result)->objs[(*result)->count++];
+            obj->type = circuit;
+            STAT(objects, 1);
+            STAT(circuits, 1);
 
-            if ((*result)->objs == NULL) {
-                (*result)->objs = temp_circuit;
-            } else {
-                obj_tail->next = temp_circuit;
+            if ((error = parse_super_t(&obj->data.circuit))) {
+                goto bail;
             }
-
-            obj_tail = temp_circuit;
             break;
         case (int)'\"': // Give control to parse_single_t() 
-            if ((error = parse_single_t(&tst))) {
+            if ((error = grow_result(*result))) {
                 goto bail;
             }
 
-            eml_obj *temp_single = malloc(sizeof(eml_obj));
-            if (temp_single == NULL) {
-                error = allocation_error;
-                goto bail;
-            }
-            temp_single->type = single;
-            temp_single->data = tst;
-            temp_single->next = NULL;
+            obj = &(*result)->objs[(*result)->count++];
+            obj->type = single;
+            STAT(objects, 1);
 
-            if ((*result)->objs == NULL) {
-                (*result)->objs = temp_single;
-            } else {
-                obj_tail->next = temp_single;
+            if ((error = parse_single_t(&obj->data.single))) {
+                goto bail;
             }
-
-            obj_tail = temp_single;
             break;
         case (int)';':
             ++current_postition;
@@ -191,160 +786,580 @@ int parse(char *eml_string, eml_result **result) {
         }
     }
 
+    STAT(bytes_scanned, current_postition);
     return no_error;
 
     bail:
-        if (tst != NULL) {
-            free_single_t(tst);
-        }
-
-        if (tsupt != NULL) {
-            free_super_t(tsupt);
+        STAT(bytes_scanned, current_postition);
+        STAT(errors[error < EML_ERROR_COUNT ? error : unexpected_error], 1);
+        if (arena.base == NULL) {
+            free_result(*result);
         }
-
-        free_result(*result);
+        *result = NULL;
         return error;
 }
 
 /*
- * parse_header: Parses header section or exits. Starts on "{" of header, ends on char succeeding "}"
-*/
-static int parse_header(eml_result *result) {
-    eml_header_t *tht = NULL;
-    int error = no_error;
+ * parse_exact: Like parse_length(), but a prescan first totals the size of the result, which is then built inside one
+ *              exact allocation (result->block) without speculative allocations or upgrades. free_result() frees it
+ *              whole. Should the prescan & parse disagree, or the document have an error, it is parsed again by
+ *              parse_length().
+ */
+int parse_exact(char *eml_string, uint32_t length, eml_result **result) {
+    uint32_t objects;
+    uint64_t size = prescan(eml_string, length, &objects);
 
-    if (emlString[current_postition++] != (int)'{') {
-        error = missing_header_start_char;
-        return error;
+    arena.base = malloc(size);
+    if (arena.base == NULL) {
+        return allocation_error;
     }
 
-    while (current_postition < emlstringlen) {
-        char current = emlString[current_postition];
+    arena.used = 0;
+    arena.size = size;
+    arena.objects = objects;
 
-        switch (current){
-        case (int)'}': // Release control & inc
-            ++current_postition;
-            return no_error;
-        case (int)',':
-            ++current_postition;
-            break;
-        case (int)'\"':
-            if ((error = parse_header_t(&tht))) {
-                return error;
-            }
-            validate_header_t(tht);
-            tht->next = result->header;
-            result->header = tht;
-            break;
-        default:
-            return unexpected_error;
-        }
-    }
+    int error = parse_length(eml_string, length, result);
 
-    error = unexpected_error;
+    void *block = arena.base;
+    arena.base = NULL;
 
-    return error;
+    if (error == no_error) {
+        (*result)->block = block;
+        return no_error;
+    }
+
+    free(block);
+    return parse_length(eml_string, length, result);
 }
 
 /*
- * parse_header_t: Returns an eml_header_t or exits. Starts on '"', ends on ',' or '}'.
-*/
-static int parse_header_t(eml_header_t **tht) {
-    *tht = malloc(sizeof(eml_header_t));
-    if (*tht == NULL) {
-        return allocation_error;
+ * parse_parallel: Like parse_length(), with the body split at top level object boundaries into up to `threads` chunks
+ *                 parsed at once, their objects then joined in order. The header is parsed first, on this thread. The
+ *                 result, error & parse_error_offset() are those of parse_length(), to which small documents, & any
+ *                 with a header error or a second header, are left.
+ */
+int parse_parallel(char *eml_string, uint32_t length, uint32_t threads, eml_result **result) {
+    int error = no_error;
+    uint32_t body = 0;
+
+    if (length > 0 && eml_string[0] == (int)'{') {
+        emlString = eml_string;
+        emlstringlen = length;
+        current_postition = 0;
+        version[0] = 0;
+        weightUnit[0] = 0;
+
+        eml_result header = {0};
+        error = parse_header(&header);
+        body = current_postition;
+
+        // Only the chunks are parsed again below; the header is parsed again by whichever parse makes the result
+        for (eml_header_t *h = header.header, *next; h != NULL; h = next) {
+            next = h->next;
+            free(h->parameter);
+            free(h->value);
+            free(h);
+        }
+
+        if (error || version[0] == '\0' || weightUnit[0] == '\0') {
+            return parse_length(eml_string, length, result);
+        }
     }
-    
-    bool pv = false; // Toggle between parameter & value
 
-    int error = no_error;
+    if (threads > (length - body) / PARALLEL_MIN_CHUNK) {
+        threads = (length - body) / PARALLEL_MIN_CHUNK;
+    }
 
-    while (current_postition < emlstringlen) {
-        char current = emlString[current_postition];
+    if (threads < 2) {
+        return parse_length(eml_string, length, result);
+    }
 
-        switch (current) {
-            case (int)'}': // Release control
-                return no_error;
-            case (int)',': // Release control
-                return no_error;
-            case (int)':':
-                pv = true;
-                ++current_postition;
+    parse_chunk *chunks = calloc(threads, sizeof(parse_chunk));
+    if (chunks == NULL) {
+        return allocation_error;
+    }
+
+    // Chunk 0 keeps the header; each chunk ends past the first object to end past its share of the body
+    uint32_t count = 0, position = body, members;
+    uint32_t share = (length - body) / threads;
+    chunks[0].begin = 0;
+
+    while (position < length) {
+        switch (eml_string[position]) {
+            case (int)'s':
+            case (int)'c':
+                prescan_super_t(eml_string, length, &position, &members);
                 break;
             case (int)'\"':
-                if (pv == false) {
-                    if ((error = parse_string(&(*tht)->parameter))) {
-                        goto bail;
-                    }
-                }
-                else {
-                    if ((error = parse_string(&(*tht)->value))) {
-                        goto bail;
-                    }
-                }
+                prescan_single_t(eml_string, length, &position);
                 break;
-            default:
-                error = unexpected_error;
-                goto bail;
+            case (int)';':
+                ++position;
+                continue;
+            case (int)'{':
+                free(chunks);
+                return parse_length(eml_string, length, result);
+            default: // An error, found by whichever chunk holds it
+                position = length;
+                continue;
+        }
+
+        if (count + 1 < threads && position < length && position - chunks[count].begin >= share + (count ? 0 : body)) {
+            chunks[count].end = position;
+            chunks[++count].begin = position;
         }
     }
 
-    error = unexpected_error;
+    chunks[count++].end = length;
 
-    bail:
-        if (*tht != NULL) {
-            if ((*tht)->parameter != NULL) {
-                free((*tht)->parameter);
-            }
+    // Chunks past one that failed are split from an object boundary the prescan could not trust, so are not parsed
+    atomic_uint_fast32_t failed;
+    atomic_init(&failed, count);
 
-            if ((*tht)->value != NULL) {
-                free((*tht)->value);
-            }
+    for (uint32_t i = 0; i < count; i++) {
+        chunks[i].eml_string = eml_string;
+        chunks[i].index = i;
+        chunks[i].failed = &failed;
+        chunks[i].started = i > 0 && pthread_create(&chunks[i].thread, NULL, parse_chunk_run, &chunks[i]) == 0;
+    }
 
-            free(*tht);
+    // Chunks whose thread did not start are parsed here
+    for (uint32_t i = 0; i < count; i++) {
+        if (chunks[i].started) {
+            pthread_join(chunks[i].thread, NULL);
+        } else {
+            parse_chunk_run(&chunks[i]);
         }
+    }
 
-        return error;
-}
-
-/*
- * parse_super_t: Returns an eml_super_t or exits. Starts on 's', ends succeeding ')'.
-*/
-static int parse_super_t(eml_super_t **tsupt) {
-    *tsupt = malloc(sizeof(eml_super_t));
-    if (tsupt == NULL) {
-        return allocation_error;
-    } 
+    // The first chunk with an error (or, with none, chunk 0 & its header) decides the result; none after it was read
+    uint32_t objects = 0;
+    for (uint32_t i = 0; i < count && error == no_error; i++) {
+        if ((error = chunks[i].error)) {
+            current_postition = chunks[i].offset;
+        }
 
-    eml_single_t *tst = NULL;
-    eml_super_member_t *set_tail = NULL;
+        objects += chunks[i].error ? 0 : chunks[i].result->count;
+    }
 
-    int error = no_error;
+    *result = chunks[0].result;
+    if (error == no_error && objects > (*result)->capacity) {
+        eml_obj *objs = realloc((*result)->objs, sizeof(eml_obj) * objects);
 
-    while (current_postition < emlstringlen) {
-        char current = emlString[current_postition];
+        if (objs == NULL) {
+            error = allocation_error;
+        } else {
+            (*result)->objs = objs;
+            (*result)->capacity = objects;
+        }
+    }
 
-        switch (current) {
-            case (int)'(':
-                ++current_postition;
-                break;
-            case (int)'\"':
-                if ((error = parse_single_t(&tst))) {
-                    return error;
-                }
+    for (uint32_t i = 1; i < count; i++) {
+        eml_result *r = chunks[i].result;
 
-                eml_super_member_t *temp = malloc(sizeof(eml_super_member_t));
-                temp->single = tst;
-                temp->next = NULL;
+        if (error == no_error) {
+            // eml_objs are moved whole; their singles & work stay where the chunk's parse put them
+            memcpy(&(*result)->objs[(*result)->count], r->objs, sizeof(eml_obj) * r->count);
+            (*result)->count += r->count;
+            r->count = 0;
+        }
 
-                if ((*tsupt)->sets == NULL) {
-                    (*tsupt)->sets = temp;
-                } else {
-                    set_tail->next = temp;
-                }
+        free_result(r);
+    }
 
-                (*tsupt)->count++;
-                set_tail = temp;
+    if (error) {
+        free_result(*result);
+        *result = NULL;
+    } else {
+        current_postition = length;
+    }
+
+    free(chunks);
+    return error;
+}
+
+/*
+ * parse_chunk_run: Parses a parse_chunk on the calling thread, unless a chunk before it has failed.
+ */
+static void *parse_chunk_run(void *arg) {
+    parse_chunk *c = arg;
+
+    if (atomic_load_explicit(c->failed, memory_order_relaxed) < c->index) {
+        return NULL;
+    }
+
+    c->error = parse_length(c->eml_string + c->begin, c->end - c->begin, &c->result);
+    c->offset = c->begin + parse_error_offset();
+
+    // Lower `failed` to this chunk, unless a chunk before it already failed
+    uint_fast32_t failed = atomic_load_explicit(c->failed, memory_order_relaxed);
+    while (c->error && c->index < failed
+        && !atomic_compare_exchange_weak_explicit(c->failed, &failed, c->index, memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    return NULL;
+}
+
+/*
+ * parse_error_offset: Returns the offset in the document at which this thread's last parse stopped; for a failed parse,
+ *                     where the error was found.
+ */
+uint32_t parse_error_offset(void) {
+    return current_postition;
+}
+
+/*
+ * parse_alloc: Allocates for the parser, from the parse_exact() block when there is one.
+ */
+static void *parse_alloc(uint64_t size) {
+    if (arena.base == NULL) {
+        return malloc(size);
+    }
+
+    size = arena_size(size);
+    if (size > arena.size - arena.used) {
+        return NULL;
+    }
+
+    void *p = arena.base + arena.used;
+    arena.used += size;
+    return p;
+}
+
+/*
+ * parse_release: Frees a parse_alloc() allocation. Memory in a parse_exact() block is freed with the block.
+ */
+static void parse_release(void *p) {
+    if (arena.base == NULL) {
+        free(p);
+    }
+}
+
+/*
+ * arena_size: Rounds `size` up to ARENA_ALIGNMENT.
+ */
+static uint64_t arena_size(uint64_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(uint64_t)(ARENA_ALIGNMENT - 1);
+}
+
+/*
+ * prescan_string: Returns the block bytes of the string starting on '"' at `position`, leaving `position` past it.
+ */
+static uint64_t prescan_string(const char *s, uint32_t length, uint32_t *position) {
+    uint32_t start = ++*position;
+
+    while (*position < length && s[*position] != '\"') {
+        ++*position;
+    }
+
+    uint32_t n = *position - start;
+    if (*position < length) {
+        ++*position;
+    }
+
+    return arena_size(n < MAX_WEIGHT_UNIT_STRING_LENGTH ? MAX_WEIGHT_UNIT_STRING_LENGTH + 1 : n + 1);
+}
+
+/*
+ * prescan_single_t: Returns the block bytes of the single starting on '"' at `position` (its name & the work each
+ *                   side allocates), leaving `position` past its ';'.
+ */
+static uint64_t prescan_single_t(const char *s, uint32_t length, uint32_t *position) {
+    uint64_t bytes = prescan_string(s, length, position);
+    uint64_t sets = 0;  // Digits before an 'x', as the parser's buffer_int
+    bool work = false;  // Whether the current side has standard(_varied) work
+
+    if (*position < length && s[*position] == (int)':') { // NAME:WORK separator
+        ++*position;
+    }
+
+    while (*position < length) {
+        char current = s[(*position)++];
+
+        switch (current) {
+            case (int)'x':
+                if (*position < length && s[*position] == (int)'(') {
+                    bytes += arena_size(sizeof(eml_standard_varied_k) + sizeof(eml_reps) * sets);
+                } else {
+                    bytes += arena_size(sizeof(eml_standard_k));
+                }
+
+                work = true;
+                sets = 0;
+                break;
+            case (int)':':
+                bytes += (work ? 0 : arena_size(sizeof(eml_none_k))) + arena_size(sizeof(eml_asymmetric_k));
+                work = false;
+                sets = 0;
+                break;
+            case (int)';':
+                return bytes + (work ? 0 : arena_size(sizeof(eml_none_k)));
+            default:
+                if (current >= '0' && current <= '9') {
+                    // Bounded like the parser's integral part, which errors past it
+                    sets = sets > 21474836U ? sets : sets * 10 + (current - '0');
+                } else {
+                    sets = 0;
+                }
+                break;
+        }
+    }
+
+    return bytes;
+}
+
+/*
+ * prescan_super_t: Returns the block bytes of the super/circuit starting at `position` (members array & members) &
+ *                  its member count, leaving `position` past its ')'.
+ */
+static uint64_t prescan_super_t(const char *s, uint32_t length, uint32_t *position, uint32_t *members) {
+    uint64_t bytes = 0;
+    *members = 0;
+
+    while (*position < length) {
+        switch (s[*position]) {
+            case (int)'\"':
+                bytes += prescan_single_t(s, length, position);
+                ++*members;
+                break;
+            case (int)')':
+                ++*position;
+                return bytes + arena_size(sizeof(eml_single_t) * *members);
+            default:
+                ++*position;
+                break;
+        }
+    }
+
+    return bytes + arena_size(sizeof(eml_single_t) * *members);
+}
+
+/*
+ * prescan: Walks a document like parse_length() without allocating. Returns the block bytes of its result & counts
+ *          its top level `objects`.
+ */
+static uint64_t prescan(const char *s, uint32_t length, uint32_t *objects) {
+    uint64_t bytes = arena_size(sizeof(eml_result));
+    uint32_t position = 0, members;
+    bool entry;  // Whether the next header string begins an eml_header_t
+
+    *objects = 0;
+
+    while (position < length) {
+        switch (s[position]) {
+            case (int)'{':
+                entry = true;
+                ++position;
+
+                while (position < length && s[position] != (int)'}') {
+                    if (s[position] == (int)'\"') {
+                        bytes += prescan_string(s, length, &position) + (entry ? arena_size(sizeof(eml_header_t)) : 0);
+                        entry = false;
+                    } else {
+                        entry = entry || s[position] == (int)',';
+                        ++position;
+                    }
+                }
+                break;
+            case (int)'s':
+            case (int)'c':
+                bytes += prescan_super_t(s, length, &position, &members);
+                ++*objects;
+                break;
+            case (int)'\"':
+                bytes += prescan_single_t(s, length, &position);
+                ++*objects;
+                break;
+            default:
+                ++position;
+                break;
+        }
+    }
+
+    return bytes + arena_size(sizeof(eml_obj) * *objects);
+}
+
+/*
+ * grow_result: Ensures result->objs has room for one more object, doubling capacity when full.
+ */
+static int grow_result(eml_result *result) {
+    if (result->count < result->capacity) {
+        return no_error;
+    }
+
+    uint32_t capacity;
+    eml_obj *objs;
+
+    if (arena.base != NULL) {
+        // Sized once by the prescan; needing more means it & the parse disagree
+        if (result->capacity != 0 || arena.objects == 0) {
+            return allocation_error;
+        }
+
+        capacity = arena.objects;
+        objs = parse_alloc(sizeof(eml_obj) * capacity);
+    } else {
+        capacity = result->capacity ? result->capacity * 2 : 8;
+        objs = realloc(result->objs, sizeof(eml_obj) * capacity);
+    }
+
+    if (objs == NULL) {
+        return allocation_error;
+    }
+
+    result->objs = objs;
+    result->capacity = capacity;
+    return no_error;
+}
+
+/*
+ * parse_header: Parses header section or exits. Starts on "{" of header, ends on char succeeding "}"
+*/
+static int parse_header(eml_result *result) {
+    eml_header_t *tht = NULL;
+    int error = no_error;
+
+    if (emlString[current_postition++] != (int)'{') {
+        error = missing_header_start_char;
+        return error;
+    }
+
+    while (current_postition < emlstringlen) {
+        char current = emlString[current_postition];
+
+        switch (current){
+        case (int)'}': // Release control & inc
+            ++current_postition;
+            return no_error;
+        case (int)',':
+            ++current_postition;
+            break;
+        case (int)'\"':
+            if ((error = parse_header_t(&tht))) {
+                return error;
+            }
+            validate_header_t(tht);
+            tht->next = result->header;
+            result->header = tht;
+            break;
+        default:
+            return unexpected_error;
+        }
+    }
+
+    error = unexpected_error;
+
+    return error;
+}
+
+/*
+ * parse_header_t: Returns an eml_header_t or exits. Starts on '"', ends on ',' or '}'.
+*/
+static int parse_header_t(eml_header_t **tht) {
+    *tht = parse_alloc(sizeof(eml_header_t));
+    if (*tht == NULL) {
+        return allocation_error;
+    }
+
+    (*tht)->parameter = NULL;
+    (*tht)->value = NULL;
+    
+    bool pv = false; // Toggle between parameter & value
+
+    int error = no_error;
+
+    while (current_postition < emlstringlen) {
+        char current = emlString[current_postition];
+
+        switch (current) {
+            case (int)'}': // Release control
+            case (int)',': // Release control
+                // A token is a parameter, ':' & its value; either missing would reach validate_header_t() as NULL
+                if ((*tht)->parameter == NULL || (*tht)->value == NULL) {
+                    error = unexpected_error;
+                    goto bail;
+                }
+                return no_error;
+            case (int)':':
+                pv = true;
+                ++current_postition;
+                break;
+            case (int)'\"': {
+                char **str = pv ? &(*tht)->value : &(*tht)->parameter;
+
+                // A second string where one was already read is a missing ':' or ','
+                if (*str != NULL) {
+                    error = unexpected_error;
+                    goto bail;
+                }
+
+                if ((error = parse_string(str))) {
+                    goto bail;
+                }
+                break;
+            }
+            default:
+                error = unexpected_error;
+                goto bail;
+        }
+    }
+
+    error = unexpected_error;
+
+    bail:
+        if (*tht != NULL) {
+            if ((*tht)->parameter != NULL) {
+                parse_release((*tht)->parameter);
+            }
+
+            if ((*tht)->value != NULL) {
+                parse_release((*tht)->value);
+            }
+
+            parse_release(*tht);
+        }
+
+        return error;
+}
+
+/*
+ * parse_super_t: Fills the caller-owned `tsupt` or exits. Starts on 's', ends succeeding ')'.
+*/
+static int parse_super_t(eml_super_t *tsupt) {
+    tsupt->count = 0;
+    tsupt->capacity = 0;
+    tsupt->members = NULL;
+
+    eml_single_t *tst = NULL;
+
+    int error = no_error;
+
+    if (arena.base != NULL) {
+        uint32_t position = current_postition;
+        prescan_super_t(emlString, emlstringlen, &position, &tsupt->capacity);
+
+        if (tsupt->capacity != 0 && (tsupt->members = parse_alloc(sizeof(eml_single_t) * tsupt->capacity)) == NULL) {
+            return allocation_error;
+        }
+    }
+
+    while (current_postition < emlstringlen) {
+        char current = emlString[current_postition];
+
+        switch (current) {
+            case (int)'(':
+                ++current_postition;
+                break;
+            case (int)'\"':
+                if ((error = grow_super_t(tsupt))) {
+                    return error;
+                }
+
+                // Counted before parsing so a partially parsed member is freed with the super
+                tst = &tsupt->members[tsupt->count++];
+                if ((error = parse_single_t(tst))) {
+                    return error;
+                }
                 break;
             case (int)')':
                 ++current_postition;
@@ -361,25 +1376,45 @@ static int parse_super_t(eml_super_t **tsupt) {
 }
 
 /*
- * parse_single_t: Returns an eml_single_t or exits. Starts on '"', ends succeeding ';'
-*/
-static int parse_single_t(eml_single_t **tst) {
-    *tst = malloc(sizeof(eml_single_t));
-    if (tst == NULL) {
+ * grow_super_t: Ensures s->members has room for one more member, doubling capacity when full.
+ */
+static int grow_super_t(eml_super_t *s) {
+    if (s->count < s->capacity) {
+        return no_error;
+    }
+
+    if (arena.base != NULL) { // Sized by parse_super_t()'s prescan
         return allocation_error;
-    } 
+    }
+
+    uint32_t capacity = s->capacity ? s->capacity * 2 : 4;
+    eml_single_t *members = realloc(s->members, sizeof(eml_single_t) * capacity);
+    if (members == NULL) {
+        return allocation_error;
+    }
+
+    s->members = members;
+    s->capacity = capacity;
+    return no_error;
+}
+
+/*
+ * parse_single_t: Fills the caller-owned `tst` or exits. Starts on '"', ends succeeding ';'
+*/
+static int parse_single_t(eml_single_t *tst) {
+    STAT(singles, 1);
 
     // Initialize eml_single_t
-    (*tst)->name = NULL;
-    (*tst)->no_work = NULL;
-    (*tst)->standard_work = NULL;
-    (*tst)->standard_varied_work = NULL;
-    (*tst)->asymmetric_work = NULL;
+    tst->name = NULL;
+    tst->no_work = NULL;
+    tst->standard_work = NULL;
+    tst->standard_varied_work = NULL;
+    tst->asymmetric_work = NULL;
 
     int error = no_error;
     // #define BAIL(e) { error = e; goto bail;}
 
-    if ((error = parse_string(&(*tst)->name))) {
+    if ((error = parse_string(&tst->name))) {
         goto bail;
     }
 
@@ -392,7 +1427,7 @@ static int parse_single_t(eml_single_t **tst) {
 
     uint32_t temp;              // Used for building eml_number in `default`
 
-    if (emlString[current_postition++] != (int)':') {
+    if (current_postition >= emlstringlen || emlString[current_postition++] != (int)':') {
         error = name_work_separator_error;
         goto bail;
     }
@@ -405,9 +1440,20 @@ static int parse_single_t(eml_single_t **tst) {
             ++current_postition;
             break;
         case (int)':':
+            // Only one ':' divides the sides; another would allocate over the first's asymmetric work
+            if (tst->asymmetric_work != NULL) {
+                error = unexpected_error;
+                goto bail;
+            }
+
+            if (kind == standard_varied && vcount < tst->standard_varied_work->sets) {
+                error = missing_variable_reps_error;
+                goto bail;
+            }
+
             // Upgrade to asymetric_k
             // Write value/modifier. If kind == standard_varied_work, write as macro.
-            if ((error = flush(*tst, NULL, kind, modifier, &buffer_int, &dcount))) {
+            if ((error = flush(tst, NULL, kind, modifier, &buffer_int, &dcount))) {
                 goto bail;
             } 
 
@@ -415,18 +1461,31 @@ static int parse_single_t(eml_single_t **tst) {
             kind = none;
 
             // Upgrade existing eml_single_t to asymmetric
-            if ((error = upgrade_to_asymmetric(*tst))) {
+            if ((error = upgrade_to_asymmetric(tst))) {
                 goto bail;
             }
             
             ++current_postition;
             break;
         case (int)'x':
-            // Allocate standard_work & set sets.
-            if ((error = upgrade_to_standard(*tst))) {
+            // Only a side's sets come before 'x'; a second 'x' would take reps or a modifier for sets
+            if (kind != none) {
+                error = unexpected_error;
                 goto bail;
             }
-            (*tst)->standard_work->sets = buffer_int;
+
+            // "Nx(" goes straight to standard_varied_work rather than allocating a standard_work to replace
+            if (current_postition + 1 < emlstringlen && emlString[current_postition + 1] == (int)'(') {
+                if ((error = upgrade_to_standard_varied(tst, buffer_int))) {
+                    goto bail;
+                }
+            } else {
+                // Allocate standard_work & set sets.
+                if ((error = upgrade_to_standard(tst))) {
+                    goto bail;
+                }
+                tst->standard_work->sets = buffer_int;
+            }
 
             buffer_int = 0;
             kind = standard;
@@ -434,9 +1493,16 @@ static int parse_single_t(eml_single_t **tst) {
             ++current_postition;
             break;
         case (int)'(':
-            // Allocate standard_varied_work & dealloc/transition standard_work
-            if ((error = upgrade_to_standard_varied(*tst))) {
-                goto bail;
+            // Allocate standard_varied_work & dealloc/transition standard_work (unless 'x' already did)
+            if (tst->standard_varied_work == NULL) {
+                if (tst->standard_work == NULL) {
+                    error = unexpected_error;
+                    goto bail;
+                }
+
+                if ((error = upgrade_to_standard_varied(tst, tst->standard_work->sets))) {
+                    goto bail;
+                }
             }
 
             vcount = 0;
@@ -445,13 +1511,19 @@ static int parse_single_t(eml_single_t **tst) {
             ++current_postition;
             break;
         case (int)',':
-            if (vcount > (*tst)->standard_varied_work->sets) {
+            // Separates reps only inside a varied work's parentheses, each rep within its sets
+            if (kind != standard_varied || tst->standard_varied_work == NULL) {
+                error = unexpected_error;
+                goto bail;
+            }
+
+            if (vcount >= tst->standard_varied_work->sets) {
                 error = extra_variable_reps_error;
                 goto bail;
             }
 
             // Write reps/(internal)modifiers
-            if ((error = flush(*tst, &vcount, kind, modifier, &buffer_int, &dcount))) {
+            if ((error = flush(tst, &vcount, kind, modifier, &buffer_int, &dcount))) {
                 goto bail;
             }
 
@@ -461,20 +1533,25 @@ static int parse_single_t(eml_single_t **tst) {
             ++current_postition;
             break;
         case (int)')':
-            if (vcount > (*tst)->standard_varied_work->sets) {
+            if (kind != standard_varied || tst->standard_varied_work == NULL) {
+                error = unexpected_error;
+                goto bail;
+            }
+
+            if (vcount >= tst->standard_varied_work->sets) {
                 error = extra_variable_reps_error;
                 goto bail;
             }
 
             // Write reps/(internal)modifiers
-            if ((error = flush(*tst, &vcount, kind, modifier, &buffer_int, &dcount))) {
+            if ((error = flush(tst, &vcount, kind, modifier, &buffer_int, &dcount))) {
                 goto bail;
             }
 
             vcount++;
             modifier = no_mod;
 
-            if (vcount < (*tst)->standard_varied_work->sets) {
+            if (vcount < tst->standard_varied_work->sets) {
                 error = missing_variable_reps_error;
                 goto bail;
             }
@@ -486,14 +1563,14 @@ static int parse_single_t(eml_single_t **tst) {
                     error = none_work_to_failure_error;
                     goto bail;
                 case standard:
-                    if ((error = applying_reps_type(&(*tst)->standard_work->reps, unmodifiedFailure))) {
+                    if ((error = applying_reps_type(&tst->standard_work->reps, unmodifiedFailure))) {
                         goto bail;
                     }
                     break;
                 case standard_varied:
                     // Apply 'toFailure' to internal Reps
-                    if (vcount < (*tst)->standard_varied_work->sets) {
-                        if ((error = applying_reps_type(&(*tst)->standard_varied_work->vReps[vcount], unmodifiedFailure))) {
+                    if (vcount < tst->standard_varied_work->sets) {
+                        if ((error = applying_reps_type(&tst->standard_varied_work->vReps[vcount], unmodifiedFailure))) {
                             goto bail;
                         }
                     }
@@ -512,14 +1589,14 @@ static int parse_single_t(eml_single_t **tst) {
                     error = modifier_on_none_work_error;
                     goto bail;
                 case standard:
-                    if ((error = applying_reps_type(&(*tst)->standard_work->reps, unmodifiedTime))) {
+                    if ((error = applying_reps_type(&tst->standard_work->reps, unmodifiedTime))) {
                         goto bail;
                     }
                     break;
                 case standard_varied:
                     // Apply 'isTime' to internal Reps
-                    if (vcount < (*tst)->standard_varied_work->sets) {
-                        if ((error = applying_reps_type(&(*tst)->standard_varied_work->vReps[vcount], unmodifiedTime))) {
+                    if (vcount < tst->standard_varied_work->sets) {
+                        if ((error = applying_reps_type(&tst->standard_varied_work->vReps[vcount], unmodifiedTime))) {
                             goto bail;
                         }
                     }
@@ -538,12 +1615,12 @@ static int parse_single_t(eml_single_t **tst) {
                     error = modifier_on_none_work_error;
                     goto bail;
                 case standard:
-                    (*tst)->standard_work->reps.value = buffer_int;
+                    tst->standard_work->reps.value = buffer_int;
                     break;
                 case standard_varied:
                     // Apply weight modifier to internal Reps (EX: 3x(5@120,...,...))
-                    if (vcount < (*tst)->standard_varied_work->sets) {
-                        (*tst)->standard_varied_work->vReps[vcount].value = buffer_int;
+                    if (vcount < tst->standard_varied_work->sets) {
+                        tst->standard_varied_work->vReps[vcount].value = buffer_int;
                     }
                     break;
             }
@@ -560,12 +1637,12 @@ static int parse_single_t(eml_single_t **tst) {
                     error = modifier_on_none_work_error;
                     goto bail;
                 case standard:
-                    (*tst)->standard_work->reps.value = buffer_int;
+                    tst->standard_work->reps.value = buffer_int;
                     break;
                 case standard_varied:
                     // Apply weight modifier to internal Reps (EX: 3x(5%120,...,...))
-                    if (vcount < (*tst)->standard_varied_work->sets) {
-                        (*tst)->standard_varied_work->vReps[vcount].value = buffer_int;
+                    if (vcount < tst->standard_varied_work->sets) {
+                        tst->standard_varied_work->vReps[vcount].value = buffer_int;
                     }
                     break;
             }
@@ -599,13 +1676,19 @@ static int parse_single_t(eml_single_t **tst) {
             ++current_postition;
             break;
         case (int)';':
+            // A varied work's parentheses must close on all its reps before its single ends
+            if (kind == standard_varied && vcount < tst->standard_varied_work->sets) {
+                error = missing_variable_reps_error;
+                goto bail;
+            }
+
             // Write value/modifier. If kind == standard_varied_work, write as macro.
-            if ((error = flush(*tst, NULL, kind, modifier, &buffer_int, &dcount))) {
+            if ((error = flush(tst, NULL, kind, modifier, &buffer_int, &dcount))) {
                 goto bail;
             }
 
-            if ((*tst)->asymmetric_work != NULL) {
-                move_to_asymmetric(*tst, right);
+            if (tst->asymmetric_work != NULL) {
+                move_to_asymmetric(tst, right);
             }
 
             ++current_postition;
@@ -677,7 +1760,7 @@ static void validate_header_t(eml_header_t *h) {
  * parse_string: Returns a string (char*) or exits. Starts on '"', ends succeeding the next '"'
  */
 static int parse_string(char **result) {
-    static char strbuf[MAX_NAME_LENGTH + 1];
+    static _Thread_local char strbuf[MAX_NAME_LENGTH + 1];
     uint32_t strindex = 0;
 
     ++current_postition; // skip '"'
@@ -692,7 +1775,8 @@ static int parse_string(char **result) {
                     return empty_string_error;
                 }
 
-                *result = malloc(strindex + 1);
+                // A string in a parse_exact() block keeps room for a weight unit, so eml_convert_weight() can rewrite it in place
+                *result = parse_alloc(arena.base != NULL && strindex < MAX_WEIGHT_UNIT_STRING_LENGTH ? MAX_WEIGHT_UNIT_STRING_LENGTH + 1 : strindex + 1);
                 if (*result == NULL) {
                     return allocation_error;
                 }
@@ -704,7 +1788,7 @@ static int parse_string(char **result) {
                 return no_error;
             default:
                 if (strindex > 127) {
-                    free(*result);
+                    parse_release(*result);
                     return string_length_error;
                 }
 
@@ -714,7 +1798,8 @@ static int parse_string(char **result) {
         }
     }
 
-    return no_error;
+    // Ran out of input before the closing '"'
+    return unexpected_error;
 }
 
 /*
@@ -788,6 +1873,7 @@ static int applying_reps_type(eml_reps *r, uint32_t t) {
             return bad_reps_type_transition;
     }
 
+    STAT(reps_type_transitions, 1);
     return no_error;
 }
 
@@ -797,6 +1883,8 @@ static int applying_reps_type(eml_reps *r, uint32_t t) {
  */
 static int flush(eml_single_t *tst, uint32_t *vcount, eml_kind_flag kind, eml_modifier_flag mod, eml_number *buf, uint32_t *dcount) {
     int error = no_error;
+    STAT(flushes, 1);
+
     if (*dcount == 1) {
         return missing_digit_following_radix_error;
     }
@@ -805,7 +1893,7 @@ static int flush(eml_single_t *tst, uint32_t *vcount, eml_kind_flag kind, eml_mo
         case none:
             switch (mod) {
                 case no_mod:
-                    tst->no_work = malloc(sizeof(bool));
+                    tst->no_work = parse_alloc(sizeof(eml_none_k));
                     if (tst->no_work == NULL) {
                         return allocation_error;
                     }
@@ -934,251 +2022,5962 @@ static void move_to_asymmetric(eml_single_t *tst, bool side) {
             tst->asymmetric_work->left_standard_varied_k = tst->standard_varied_work;
         }
 
-        tst->standard_varied_work = NULL;
+        tst->standard_varied_work = NULL;
+    }
+}
+
+/*
+ * upgrade_to_asymmetric: Allocates tst->asymmetric_work & moves existing tst->(no_work | standard_work | standard_varied_work) kind to left side.
+ */
+static int upgrade_to_asymmetric(eml_single_t *tst) {
+    STAT(upgrades_to_asymmetric, 1);
+    tst->asymmetric_work = parse_alloc(sizeof(eml_asymmetric_k));
+    if (tst->asymmetric_work == NULL) {
+        return allocation_error;
+    }
+
+    tst->asymmetric_work->left_none_k = NULL;
+    tst->asymmetric_work->left_standard_k = NULL;
+    tst->asymmetric_work->left_standard_varied_k = NULL;
+    tst->asymmetric_work->right_none_k = NULL;
+    tst->asymmetric_work->right_standard_k = NULL;
+    tst->asymmetric_work->right_standard_varied_k = NULL;
+
+    move_to_asymmetric(tst, left);
+    return no_error;
+}
+
+/*
+ * upgrade_to_standard_varied: Allocates tst->standard_varied_work with `sets` reps & frees tst->standard_work, if any.
+ */
+static int upgrade_to_standard_varied(eml_single_t *tst, uint32_t sets) {
+    STAT(upgrades_to_standard_varied, 1);
+    tst->standard_varied_work = parse_alloc(sizeof(eml_standard_varied_k) + sizeof(eml_reps) * (uint64_t)sets);
+    if (tst->standard_varied_work == NULL) {
+        return allocation_error;
+    }
+    
+    tst->standard_varied_work->sets = sets;
+
+    // standard_varied_kind defaults
+    for (int i = 0; i < tst->standard_varied_work->sets; i++) {
+        tst->standard_varied_work->vReps[i].type = unmodified;
+    }
+
+    parse_release(tst->standard_work);
+    tst->standard_work = NULL;
+    return no_error;
+}
+
+/*
+ * upgrade_to_standard: Allocates tst->standard_work.
+ */
+static int upgrade_to_standard(eml_single_t *tst) {
+    STAT(upgrades_to_standard, 1);
+    tst->standard_work = parse_alloc(sizeof(eml_standard_k));
+    if (tst->standard_work == NULL) {
+        return allocation_error;
+    }
+
+    tst->standard_work->reps.type = unmodified;
+    return no_error;
+}
+
+/*
+ * format_eml_number: Returns a temporary formatted eml_number string which is valid until next call or exits.
+ */
+static void format_eml_number(eml_number *e, char *f) {
+    char digits[MAX_FORMATTED_EML_STRING_LENGTH];
+    bool scaled = (*e & eml_number_H) != 0;
+    uint32_t v = scaled ? (*e & eml_number_mask) : *e; // <= 21474836U check ignored
+    uint32_t n = 0;
+
+    // Least significant digit first; a scaled number has a radix point before its last two digits
+    do {
+        if (scaled && n == 2) {
+            digits[n++] = '.';
+        }
+        digits[n++] = '0' + v % 10U;
+        v /= 10U;
+    } while (v != 0 || (scaled && n < 4));
+
+    for (uint32_t i = 0; i < n; i++) {
+        f[i] = digits[n - 1 - i];
+    }
+    f[n] = '\0';
+}
+
+/*
+ * print_standard_k: Prints an eml_standard_k to stdout.
+ */
+static void print_standard_k(eml_standard_k *k, const char *unit) {
+    char value[MAX_FORMATTED_EML_STRING_LENGTH];
+    char modifier[MAX_FORMATTED_EML_STRING_LENGTH];
+
+    format_eml_number((eml_number *)&(k->reps.value), value);
+    format_eml_number((eml_number *)&(k->reps.modifier), modifier);
+
+    switch (k->reps.type) {
+        case unmodified:
+            printf("%i sets of %s reps", k->sets, value);
+            break;
+        case unmodifiedFailure:
+            printf("%i sets to failure", k->sets);
+            break;
+        case unmodifiedTime:
+            printf("%i time sets of %s seconds", k->sets, value);
+            break;
+        case unmodifiedTimeFailure:
+            printf("%i time sets to failure", k->sets);
+            break;
+        case weight:
+            printf("%i sets of %s reps with %s %s", k->sets, value, modifier, unit);
+            break;
+        case weightFailure:
+            printf("%i sets to failure with %s %s", k->sets, modifier, unit);
+            break;
+        case timeWeight:
+            printf("%i time sets of %s seconds with %s %s", k->sets, value, modifier, unit);
+            break;
+        case timeWeightFaliure:
+            printf("%i time sets to failure with %s %s", k->sets, modifier, unit);
+            break;
+        case rpe:
+            printf("%i sets of %s reps with RPE of %s", k->sets, value, modifier);
+            break;
+        case timeRPE:
+            printf("%i time sets of %s seconds with RPE of %s", k->sets, value, modifier);
+            break;
+    }
+
+    printf("\n");
+}
+
+/*
+ * print_standard_varied_k: Prints an eml_standard_varied_k to stdout.
+ */
+static void print_standard_varied_k(eml_standard_varied_k *k, const char *unit) {
+    int count = k->sets;
+    printf("%i sets\n", count);
+    for (int i = 0; i < count; i++) {
+        printf(" - ");
+
+        // standard_varied_k emulates standard_k for printing
+        eml_standard_k shim;
+        shim.sets = k->sets;
+        shim.reps = k->vReps[i];
+        print_standard_k(&shim, unit); // FIXME: Prints X sets of ... on every line
+    }
+}
+
+/*
+ * print_single_t: Prints a eml_single_t to stdout.
+ */
+static void print_single_t(eml_single_t *s, const char *unit) {
+    printf("--- single_t ---\n");
+    printf("Name: %s\n", s->name);
+
+    if (s->no_work != NULL) {
+        printf("No work\n");
+    } else if (s->standard_work != NULL) {
+        printf("Standard work\n");
+        print_standard_k(s->standard_work, unit);
+    } else if (s->standard_varied_work != NULL) {
+        printf("Standard varied work\n");
+        print_standard_varied_k(s->standard_varied_work, unit);
+    } else if (s->asymmetric_work != NULL) {
+        printf("Asymetric work\n");
+
+        if (s->asymmetric_work->left_none_k != NULL) {
+            printf("LEFT: No work\n");
+        } else if (s->asymmetric_work->left_standard_k != NULL) {
+            printf("LEFT: Standard work ");
+            print_standard_k(s->asymmetric_work->left_standard_k, unit);
+        } else if (s->asymmetric_work->left_standard_varied_k != NULL) {
+            printf("LEFT: Standard varied work ");
+            print_standard_varied_k(s->asymmetric_work->left_standard_varied_k, unit);
+        }
+
+        if (s->asymmetric_work->right_none_k != NULL) {
+            printf("RIGHT: No work\n");
+        } else if (s->asymmetric_work->right_standard_k != NULL) {
+            printf("RIGHT: Standard work ");
+            print_standard_k(s->asymmetric_work->right_standard_k, unit);
+        } else if (s->asymmetric_work->right_standard_varied_k != NULL) {
+            printf("RIGHT: Standard varied work ");
+            print_standard_varied_k(s->asymmetric_work->right_standard_varied_k, unit);
+        }
+    }
+}
+
+/*
+ * print_super_t: Prints a eml_super_t to stdout.
+ */
+static void print_super_t(eml_super_t *s, const char *unit) {
+    printf("----- SUPER -----\n");
+    for (uint32_t i = 0; i < s->count; i++) {
+        print_single_t(&s->members[i], unit);
+    }
+    printf("--- SUPER END ---\n");
+    return;
+}
+
+/*
+ * print_circuit_t: Prints a eml_circuit_t to stdout.
+ */
+static void print_circuit_t(eml_circuit_t *c, const char *unit) {
+    printf("----- CIRCUIT -----\n");
+    for (uint32_t i = 0; i < c->count; i++) {
+        print_single_t(&c->members[i], unit);
+    }
+    printf("--- CIRCUIT END ---\n");
+    return;
+}
+
+/*
+ * print_emlobj: Prints an eml_obj to stdout.
+ */
+static void print_emlobj(eml_obj *e, const char *unit) {
+    switch (e->type) {
+        case single:
+            print_single_t(&e->data.single, unit);
+            break;
+        case super:
+            print_super_t(&e->data.super, unit);
+            break;
+        case circuit:
+            print_circuit_t(&e->data.circuit, unit);
+            break;
+    }
+}
+
+void print_result(eml_result *result) {
+    if (result == NULL) {
+        return;
+    }
+
+    // Results may outlive the parse (or be converted), so print with their own unit
+    eml_header_t *unit = find_header_t(result, "weight");
+
+    printf("--- Parsed EML ---\n");
+    printf("Header:\n");
+
+    eml_header_t *h = result->header;
+    while (h != NULL) {
+        printf(" - Parameter: %s, Value: %s\n", h->parameter, h->value);
+        h = h->next;
+    }
+
+    printf("Body:\n");
+    for (uint32_t i = 0; i < result->count; i++) {
+        print_emlobj(&result->objs[i], unit != NULL ? unit->value : "");
+    }
+}
+
+/*
+ * size_single_t: Adds the number of eml_reps and string bytes a frozen eml_single_t needs to `reps` and `strings`.
+ */
+static void size_single_t(eml_single_t *s, uint32_t *reps, uint32_t *strings) {
+    *strings += strlen(s->name) + 1;
+
+    if (s->standard_work != NULL) {
+        *reps += 1;
+    } else if (s->standard_varied_work != NULL) {
+        *reps += s->standard_varied_work->sets;
+    } else if (s->asymmetric_work != NULL) {
+        if (s->asymmetric_work->left_standard_k != NULL) {
+            *reps += 1;
+        } else if (s->asymmetric_work->left_standard_varied_k != NULL) {
+            *reps += s->asymmetric_work->left_standard_varied_k->sets;
+        }
+
+        if (s->asymmetric_work->right_standard_k != NULL) {
+            *reps += 1;
+        } else if (s->asymmetric_work->right_standard_varied_k != NULL) {
+            *reps += s->asymmetric_work->right_standard_varied_k->sets;
+        }
+    }
+}
+
+/*
+ * freeze_string: Copies `str` to base + *cursor, advances the cursor & returns the string's offset.
+ */
+static eml_offset freeze_string(char *base, eml_offset *cursor, char *str) {
+    eml_offset offset = *cursor;
+    uint32_t length = strlen(str) + 1;
+
+    memcpy(base + offset, str, length);
+    *cursor += length;
+    return offset;
+}
+
+/*
+ * freeze_work: Writes one kind of work to `w`, copying its reps to base + *reps. Modifiers of unmodified reps are zeroed.
+ */
+static void freeze_work(char *base, eml_offset *reps, eml_frozen_work *w, eml_none_k *n, eml_standard_k *k, eml_standard_varied_k *v) {
+    eml_reps *dst = (eml_reps *)(base + *reps);
+
+    if (n != NULL) {
+        w->kind = frozen_none;
+        return;
+    } else if (k != NULL) {
+        w->kind = frozen_standard;
+        w->sets = k->sets;
+        w->count = 1;
+        dst[0] = k->reps;
+    } else if (v != NULL) {
+        w->kind = frozen_standard_varied;
+        w->sets = v->sets;
+        w->count = v->sets;
+        memcpy(dst, v->vReps, sizeof(eml_reps) * v->sets);
+    } else {
+        w->kind = frozen_absent;
+        return;
+    }
+
+    for (uint32_t i = 0; i < w->count; i++) {
+        switch (dst[i].type) {
+            case unmodified:
+            case unmodifiedFailure:
+            case unmodifiedTime:
+            case unmodifiedTimeFailure:
+                dst[i].modifier.weight = 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    w->reps = *reps;
+    *reps += sizeof(eml_reps) * w->count;
+}
+
+/*
+ * freeze_single_t: Writes `s` to `fs`, appending its reps & name at base + *reps and base + *strings.
+ */
+static void freeze_single_t(char *base, eml_offset *reps, eml_offset *strings, eml_frozen_single *fs, eml_single_t *s) {
+    fs->name = freeze_string(base, strings, s->name);
+
+    if (s->asymmetric_work != NULL) {
+        eml_asymmetric_k *a = s->asymmetric_work;
+
+        fs->asymmetric = true;
+        freeze_work(base, reps, &fs->left_work, a->left_none_k, a->left_standard_k, a->left_standard_varied_k);
+        freeze_work(base, reps, &fs->right_work, a->right_none_k, a->right_standard_k, a->right_standard_varied_k);
+    } else {
+        fs->asymmetric = false;
+        freeze_work(base, reps, &fs->left_work, s->no_work, s->standard_work, s->standard_varied_work);
+        fs->right_work.kind = frozen_absent;
+    }
+}
+
+/*
+ * eml_freeze: Copies `result` into a newly allocated, relocatable eml_frozen block. Free the block with free().
+ */
+int eml_freeze(eml_result *result, eml_frozen **frozen) {
+    uint32_t header_count = 0;
+    uint32_t singles = 0;
+    uint32_t reps = 0;
+    uint32_t strings = 0;
+
+    for (eml_header_t *h = result->header; h != NULL; h = h->next) {
+        header_count++;
+        strings += strlen(h->parameter) + strlen(h->value) + 2;
+    }
+
+    for (uint32_t i = 0; i < result->count; i++) {
+        eml_obj *o = &result->objs[i];
+
+        if (o->type == single) {
+            singles++;
+            size_single_t(&o->data.single, &reps, &strings);
+        } else {
+            singles += o->data.super.count;
+            for (uint32_t j = 0; j < o->data.super.count; j++) {
+                size_single_t(&o->data.super.members[j], &reps, &strings);
+            }
+        }
+    }
+
+    eml_offset header_offset = sizeof(eml_frozen);
+    eml_offset objs_offset = header_offset + sizeof(eml_frozen_header) * header_count;
+    eml_offset singles_offset = objs_offset + sizeof(eml_frozen_obj) * result->count;
+    eml_offset reps_offset = singles_offset + sizeof(eml_frozen_single) * singles;
+    eml_offset strings_offset = reps_offset + sizeof(eml_reps) * reps;
+    uint64_t size = (uint64_t)strings_offset + strings;
+
+    if (size > UINT32_MAX) {
+        return allocation_error;
+    }
+
+    char *base = calloc(1, size);
+    if (base == NULL) {
+        return allocation_error;
+    }
+
+    *frozen = (eml_frozen *)base;
+    (*frozen)->magic = EML_FROZEN_MAGIC;
+    (*frozen)->size = size;
+    (*frozen)->header_count = header_count;
+    (*frozen)->header = header_count ? header_offset : 0;
+    (*frozen)->count = result->count;
+    (*frozen)->objs = result->count ? objs_offset : 0;
+
+    eml_frozen_header *fh = (eml_frozen_header *)(base + header_offset);
+    for (eml_header_t *h = result->header; h != NULL; h = h->next, fh++) {
+        fh->parameter = freeze_string(base, &strings_offset, h->parameter);
+        fh->value = freeze_string(base, &strings_offset, h->value);
+    }
+
+    eml_frozen_obj *fo = (eml_frozen_obj *)(base + objs_offset);
+    eml_frozen_single *fs = (eml_frozen_single *)(base + singles_offset);
+    for (uint32_t i = 0; i < result->count; i++, fo++) {
+        eml_obj *o = &result->objs[i];
+
+        fo->type = o->type;
+        fo->singles = (char *)fs - base;
+
+        if (o->type == single) {
+            fo->count = 1;
+            freeze_single_t(base, &reps_offset, &strings_offset, fs++, &o->data.single);
+        } else {
+            fo->count = o->data.super.count;
+            for (uint32_t j = 0; j < o->data.super.count; j++) {
+                freeze_single_t(base, &reps_offset, &strings_offset, fs++, &o->data.super.members[j]);
+            }
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * eml_frozen_clone: Copies an eml_frozen block with a single memcpy. Free the clone with free().
+ */
+int eml_frozen_clone(const eml_frozen *frozen, eml_frozen **clone) {
+    *clone = malloc(frozen->size);
+    if (*clone == NULL) {
+        return allocation_error;
+    }
+
+    memcpy(*clone, frozen, frozen->size);
+    return no_error;
+}
+
+/*
+ * eml_frozen_at: Returns a pointer to `offset` within `frozen`, or NULL for the absent offset 0.
+ */
+const void *eml_frozen_at(const eml_frozen *frozen, eml_offset offset) {
+    if (offset == 0) {
+        return NULL;
+    }
+
+    return (const char *)frozen + offset;
+}
+
+/*
+ * frozen_range_valid: Checks [offset, offset + length) is a non-absent, 4 byte aligned range within a block of `size` bytes.
+ */
+static bool frozen_range_valid(uint32_t size, eml_offset offset, uint64_t length) {
+    return offset != 0 && offset % 4 == 0 && offset <= size && length <= size - offset;
+}
+
+/*
+ * frozen_string_valid: Checks a string starts within the block and is terminated before the end of it.
+ */
+static bool frozen_string_valid(const char *base, uint32_t size, eml_offset offset) {
+    return offset != 0 && offset < size && memchr(base + offset, '\0', size - offset) != NULL;
+}
+
+/*
+ * frozen_work_valid: Checks an eml_frozen_work has a known kind & its reps are within the block.
+ */
+static bool frozen_work_valid(uint32_t size, eml_frozen_work *w) {
+    switch (w->kind) {
+        case frozen_absent:
+        case frozen_none:
+            return true;
+        case frozen_standard:
+            return w->count == 1 && frozen_range_valid(size, w->reps, sizeof(eml_reps));
+        case frozen_standard_varied:
+            return w->count == w->sets && frozen_range_valid(size, w->reps, (uint64_t)sizeof(eml_reps) * w->count);
+        default:
+            return false;
+    }
+}
+
+/*
+ * eml_frozen_validate: Checks an eml_frozen block of `size` bytes received from a file or another process
+ *                      before it is read. Every offset is bounds checked, nothing is written.
+ */
+int eml_frozen_validate(const void *block, uint32_t size) {
+    const char *base = block;
+    const eml_frozen *f = block;
+
+    if (size < sizeof(eml_frozen) || f->magic != EML_FROZEN_MAGIC || f->size != size) {
+        return frozen_layout_error;
+    }
+
+    if (f->header_count && !frozen_range_valid(size, f->header, (uint64_t)sizeof(eml_frozen_header) * f->header_count)) {
+        return frozen_layout_error;
+    }
+
+    for (uint32_t i = 0; i < f->header_count; i++) {
+        const eml_frozen_header *fh = (const eml_frozen_header *)(base + f->header) + i;
+
+        if (!frozen_string_valid(base, size, fh->parameter) || !frozen_string_valid(base, size, fh->value)) {
+            return frozen_layout_error;
+        }
+    }
+
+    if (f->count && !frozen_range_valid(size, f->objs, (uint64_t)sizeof(eml_frozen_obj) * f->count)) {
+        return frozen_layout_error;
+    }
+
+    for (uint32_t i = 0; i < f->count; i++) {
+        const eml_frozen_obj *fo = (const eml_frozen_obj *)(base + f->objs) + i;
+
+        if (fo->type > circuit || (fo->type == single && fo->count != 1)) {
+            return frozen_layout_error;
+        }
+
+        if (fo->count && !frozen_range_valid(size, fo->singles, (uint64_t)sizeof(eml_frozen_single) * fo->count)) {
+            return frozen_layout_error;
+        }
+
+        for (uint32_t j = 0; j < fo->count; j++) {
+            eml_frozen_single fs = ((const eml_frozen_single *)(base + fo->singles))[j];
+
+            if (!frozen_string_valid(base, size, fs.name) || !frozen_work_valid(size, &fs.left_work) || !frozen_work_valid(size, &fs.right_work)) {
+                return frozen_layout_error;
+            }
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * find_header_t: Returns the first declared header with `parameter` (the one validate_header_t() configures the
+ *                parser from), or NULL. Headers are listed last declared first, so that is the last match.
+ */
+static eml_header_t *find_header_t(eml_result *result, const char *parameter) {
+    eml_header_t *found = NULL;
+
+    for (eml_header_t *h = result->header; h != NULL; h = h->next) {
+        if (strcmp(h->parameter, parameter) == 0) {
+            found = h;
+        }
+    }
+
+    return found;
+}
+
+/*
+ * work_reps: Returns the reps of one side of `s` & their count, or NULL for no work. Symmetric work is the left side.
+ */
+static eml_reps *work_reps(eml_single_t *s, bool side, uint32_t *count) {
+    eml_standard_k *k = NULL;
+    eml_standard_varied_k *v = NULL;
+
+    if (s->asymmetric_work != NULL) {
+        k = side ? s->asymmetric_work->right_standard_k : s->asymmetric_work->left_standard_k;
+        v = side ? s->asymmetric_work->right_standard_varied_k : s->asymmetric_work->left_standard_varied_k;
+    } else if (side == left) {
+        k = s->standard_work;
+        v = s->standard_varied_work;
+    }
+
+    if (k != NULL) {
+        *count = 1;
+        return &k->reps;
+    }
+
+    if (v != NULL) {
+        *count = v->sets;
+        return v->vReps;
+    }
+
+    *count = 0;
+    return NULL;
+}
+
+/*
+ * work_kind: Returns the frozen kind of work on one side of `s` & its sets. Symmetric work is the left side.
+ */
+static uint32_t work_kind(eml_single_t *s, bool side, uint32_t *sets) {
+    eml_none_k *n = NULL;
+    eml_standard_k *k = NULL;
+    eml_standard_varied_k *v = NULL;
+
+    if (s->asymmetric_work != NULL) {
+        n = side ? s->asymmetric_work->right_none_k : s->asymmetric_work->left_none_k;
+        k = side ? s->asymmetric_work->right_standard_k : s->asymmetric_work->left_standard_k;
+        v = side ? s->asymmetric_work->right_standard_varied_k : s->asymmetric_work->left_standard_varied_k;
+    } else if (side == left) {
+        n = s->no_work;
+        k = s->standard_work;
+        v = s->standard_varied_work;
+    }
+
+    *sets = 0;
+    if (n != NULL) {
+        return frozen_none;
+    } else if (k != NULL) {
+        *sets = k->sets;
+        return frozen_standard;
+    } else if (v != NULL) {
+        *sets = v->sets;
+        return frozen_standard_varied;
+    }
+
+    return frozen_absent;
+}
+
+/*
+ * reps_has_weight: Whether the reps' modifier is a weight.
+ */
+static bool reps_has_weight(eml_reps *r) {
+    switch (r->type) {
+        case weight:
+        case weightFailure:
+        case timeWeight:
+        case timeWeightFaliure:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * reps_has_modifier: Whether the reps carry a weight or RPE modifier. The modifier of other reps is undefined.
+ */
+static bool reps_has_modifier(eml_reps *r) {
+    return reps_has_weight(r) || r->type == rpe || r->type == timeRPE;
+}
+
+/*
+ * gather_weights: Appends a pointer to every weight modifier of `s` to `weights` (if not NULL) & returns how many there are.
+ */
+static uint32_t gather_weights(eml_single_t *s, eml_number **weights) {
+    uint32_t found = 0;
+
+    for (bool side = left; side <= right; side++) {
+        uint32_t count;
+        eml_reps *reps = work_reps(s, side, &count);
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (reps_has_weight(&reps[i])) {
+                if (weights != NULL) {
+                    weights[found] = &reps[i].modifier.weight;
+                }
+                found++;
+            }
+        }
+    }
+
+    return found;
+}
+
+/*
+ * lbs_to_kg: Converts `values` in place to kg in hundredths (H bit set), rounding half up. Branch free so the
+ *            compiler can vectorize it. Returns non-zero if any value overflowed, in which case `values` is garbage.
+ */
+static uint32_t lbs_to_kg(eml_number *values, uint32_t count) {
+    uint32_t overflow = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t fractional = values[i] >> 31;
+        uint64_t hundredths = (uint64_t)(values[i] & eml_number_mask) * (100 - 99 * fractional);
+        uint64_t converted = (hundredths * KG_PER_LBS_NUMERATOR + KG_PER_LBS_DENOMINATOR / 2) / KG_PER_LBS_DENOMINATOR;
+
+        overflow |= converted > eml_number_mask;
+        values[i] = (uint32_t)converted | eml_number_H;
+    }
+
+    return overflow;
+}
+
+/*
+ * kg_to_lbs: Converts `values` in place to lbs in hundredths (H bit set), rounding half up. Branch free so the
+ *            compiler can vectorize it. Returns non-zero if any value overflowed, in which case `values` is garbage.
+ */
+static uint32_t kg_to_lbs(eml_number *values, uint32_t count) {
+    uint32_t overflow = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t fractional = values[i] >> 31;
+        uint64_t hundredths = (uint64_t)(values[i] & eml_number_mask) * (100 - 99 * fractional);
+        uint64_t converted = (hundredths * KG_PER_LBS_DENOMINATOR + KG_PER_LBS_NUMERATOR / 2) / KG_PER_LBS_NUMERATOR;
+
+        overflow |= converted > eml_number_mask;
+        values[i] = (uint32_t)converted | eml_number_H;
+    }
+
+    return overflow;
+}
+
+/*
+ * eml_convert_weight: Converts every weight modifier of `result` to `unit` ("lbs" or "kg") & updates the header.
+ */
+int eml_convert_weight(eml_result *result, const char *unit) {
+    return eml_convert_weight_batch(&result, 1, unit);
+}
+
+/*
+ * eml_convert_weight_batch: Converts every weight modifier of `results` to `unit` ("lbs" or "kg") & updates their
+ *                           headers. Modifiers are gathered into one flat array, converted in a single pass and
+ *                           scattered back, so either every result is converted or (on error) none are.
+ */
+int eml_convert_weight_batch(eml_result **results, uint32_t count, const char *unit) {
+    bool to_kg;
+    if (strcmp(unit, "kg") == 0) {
+        to_kg = true;
+    } else if (strcmp(unit, "lbs") == 0) {
+        to_kg = false;
+    } else {
+        return unknown_weight_unit_error;
+    }
+
+    uint64_t total = 0;
+    uint32_t pending = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        eml_header_t *h = find_header_t(results[i], "weight");
+        if (h == NULL) {
+            return missing_weight_unit;
+        }
+
+        if (results[i]->works != NULL) {
+            return shared_work_error;
+        }
+
+        if (strcmp(h->value, "kg") != 0 && strcmp(h->value, "lbs") != 0) {
+            return unknown_weight_unit_error;
+        }
+
+        if (strcmp(h->value, unit) == 0) {
+            continue;
+        }
+
+        pending++;
+        for (uint32_t j = 0; j < results[i]->count; j++) {
+            eml_obj *o = &results[i]->objs[j];
+
+            if (o->type == single) {
+                total += gather_weights(&o->data.single, NULL);
+            } else {
+                for (uint32_t k = 0; k < o->data.super.count; k++) {
+                    total += gather_weights(&o->data.super.members[k], NULL);
+                }
+            }
+        }
+    }
+
+    // Every result is in `unit` already
+    if (pending == 0) {
+        return no_error;
+    }
+
+    if (total > UINT32_MAX) {
+        return allocation_error;
+    }
+
+    // Every header owns its value, so each converted result gets its own copy of `unit`
+    int error = no_error;
+    uint32_t units_allocated = 0;
+    eml_number **weights = NULL;
+    eml_number *values = NULL;
+    char **units = malloc(sizeof(char *) * pending);
+    if (units == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    // Results without weights only have their headers updated
+    if (total > 0) {
+        weights = malloc(sizeof(eml_number *) * total);
+        values = malloc(sizeof(eml_number) * total);
+        if (weights == NULL || values == NULL) {
+            error = allocation_error;
+            goto bail;
+        }
+    }
+
+    for (; units_allocated < pending; units_allocated++) {
+        units[units_allocated] = malloc(strlen(unit) + 1);
+        if (units[units_allocated] == NULL) {
+            error = allocation_error;
+            goto bail;
+        }
+        strcpy(units[units_allocated], unit);
+    }
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(find_header_t(results[i], "weight")->value, unit) == 0) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < results[i]->count; j++) {
+            eml_obj *o = &results[i]->objs[j];
+
+            if (o->type == single) {
+                found += gather_weights(&o->data.single, weights + found);
+            } else {
+                for (uint32_t k = 0; k < o->data.super.count; k++) {
+                    found += gather_weights(&o->data.super.members[k], weights + found);
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < found; i++) {
+        values[i] = *weights[i];
+    }
+
+    if (to_kg ? lbs_to_kg(values, found) : kg_to_lbs(values, found)) {
+        error = weight_conversion_overflow_error;
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < found; i++) {
+        *weights[i] = values[i];
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        eml_header_t *h = find_header_t(results[i], "weight");
+        if (strcmp(h->value, unit) == 0) {
+            continue;
+        }
+
+        // A parse_exact() block holds its strings, which keep room for a weight unit
+        if (results[i]->block != NULL) {
+            strcpy(h->value, unit);
+            continue;
+        }
+
+        free(h->value);
+        h->value = units[--units_allocated];
+    }
+
+    bail:
+        if (units != NULL) {
+            while (units_allocated > 0) {
+                free(units[--units_allocated]);
+            }
+        }
+
+        free(units);
+        free(weights);
+        free(values);
+        return error;
+}
+
+/*
+ * hash_u32: Feeds `v` to an FNV-1a hash in little endian byte order, so hashes are stable across processes & hosts.
+ */
+static uint64_t hash_u32(uint64_t h, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        h ^= (v >> (i * 8)) & 0xFF;
+        h *= FNV_PRIME;
+    }
+
+    return h;
+}
+
+/*
+ * hash_string: Feeds `str` & its sentinel to an FNV-1a hash.
+ */
+static uint64_t hash_string(uint64_t h, const char *str) {
+    do {
+        h ^= (unsigned char)*str;
+        h *= FNV_PRIME;
+    } while (*str++ != '\0');
+
+    return h;
+}
+
+/*
+ * hash_mix: Finalizes a hash (splitmix64) so hashes combined with + do not cancel out.
+ */
+static uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/*
+ * hash_single_t: Feeds the name & work of `s` to an FNV-1a hash.
+ */
+static uint64_t hash_single_t(uint64_t h, eml_single_t *s) {
+    h = hash_string(h, s->name);
+    h = hash_u32(h, s->asymmetric_work != NULL);
+
+    for (bool side = left; side <= right; side++) {
+        uint32_t sets, count;
+        eml_reps *reps = work_reps(s, side, &count);
+
+        h = hash_u32(h, work_kind(s, side, &sets));
+        h = hash_u32(h, sets);
+
+        for (uint32_t i = 0; i < count; i++) {
+            h = hash_u32(h, reps[i].type);
+            h = hash_u32(h, reps[i].value);
+            h = hash_u32(h, reps_has_modifier(&reps[i]) ? reps[i].modifier.weight : 0);
+        }
+    }
+
+    return h;
+}
+
+/*
+ * eml_hash: Returns a structural hash of `result`, stable across processes. Header pairs are hashed independent of
+ *           their order, objects in order. eml_equal results always have equal hashes.
+ */
+uint64_t eml_hash(eml_result *result) {
+    uint64_t header = 0;
+    for (eml_header_t *h = result->header; h != NULL; h = h->next) {
+        header += hash_mix(hash_string(hash_string(FNV_OFFSET_BASIS, h->parameter), h->value));
+    }
+
+    uint64_t h = hash_u32(FNV_OFFSET_BASIS, result->count);
+    for (uint32_t i = 0; i < result->count; i++) {
+        eml_obj *o = &result->objs[i];
+
+        h = hash_u32(h, o->type);
+        if (o->type == single) {
+            h = hash_single_t(h, &o->data.single);
+        } else {
+            h = hash_u32(h, o->data.super.count);
+            for (uint32_t j = 0; j < o->data.super.count; j++) {
+                h = hash_single_t(h, &o->data.super.members[j]);
+            }
+        }
+    }
+
+    return hash_mix(h ^ header);
+}
+
+/*
+ * equal_reps: Whether two reps have the same type, value & (if any) modifier.
+ */
+static bool equal_reps(eml_reps *a, eml_reps *b) {
+    if (a->type != b->type || a->value != b->value) {
+        return false;
+    }
+
+    return !reps_has_modifier(a) || a->modifier.weight == b->modifier.weight;
+}
+
+/*
+ * equal_single_t: Whether two singles have the same name & work.
+ */
+static bool equal_single_t(eml_single_t *a, eml_single_t *b) {
+    if ((a->asymmetric_work == NULL) != (b->asymmetric_work == NULL) || strcmp(a->name, b->name) != 0) {
+        return false;
+    }
+
+    for (bool side = left; side <= right; side++) {
+        uint32_t a_sets, b_sets, a_count, b_count;
+
+        if (work_kind(a, side, &a_sets) != work_kind(b, side, &b_sets) || a_sets != b_sets) {
+            return false;
+        }
+
+        eml_reps *a_reps = work_reps(a, side, &a_count);
+        eml_reps *b_reps = work_reps(b, side, &b_count);
+        for (uint32_t i = 0; i < a_count; i++) {
+            if (!equal_reps(&a_reps[i], &b_reps[i])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * count_header_t: Returns how many headers of `result` have the same parameter & value as `h`.
+ */
+static uint32_t count_header_t(eml_result *result, eml_header_t *h) {
+    uint32_t count = 0;
+
+    for (eml_header_t *o = result->header; o != NULL; o = o->next) {
+        if (strcmp(o->parameter, h->parameter) == 0 && strcmp(o->value, h->value) == 0) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * eml_equal: Whether two results are structurally equal. Header pairs are compared independent of their order,
+ *            objects in order. Returns at the first difference.
+ */
+bool eml_equal(eml_result *a, eml_result *b) {
+    if (a->count != b->count) {
+        return false;
+    }
+
+    uint32_t a_headers = 0;
+    uint32_t b_headers = 0;
+    for (eml_header_t *h = a->header; h != NULL; h = h->next) {
+        a_headers++;
+    }
+    for (eml_header_t *h = b->header; h != NULL; h = h->next) {
+        b_headers++;
+    }
+
+    if (a_headers != b_headers) {
+        return false;
+    }
+
+    for (eml_header_t *h = a->header; h != NULL; h = h->next) {
+        if (count_header_t(a, h) != count_header_t(b, h)) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < a->count; i++) {
+        eml_obj *x = &a->objs[i];
+        eml_obj *y = &b->objs[i];
+
+        if (x->type != y->type) {
+            return false;
+        }
+
+        if (x->type == single) {
+            if (!equal_single_t(&x->data.single, &y->data.single)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (x->data.super.count != y->data.super.count) {
+            return false;
+        }
+
+        for (uint32_t j = 0; j < x->data.super.count; j++) {
+            if (!equal_single_t(&x->data.super.members[j], &y->data.super.members[j])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+ * hash_work: Returns the content hash of a work node, consistent with equal_reps().
+ */
+static uint64_t hash_work(uint32_t kind, uint32_t sets, eml_reps *reps, uint32_t count) {
+    uint64_t h = hash_u32(hash_u32(FNV_OFFSET_BASIS, kind), sets);
+
+    for (uint32_t i = 0; i < count; i++) {
+        h = hash_u32(h, reps[i].type);
+        h = hash_u32(h, reps[i].value);
+        h = hash_u32(h, reps_has_modifier(&reps[i]) ? reps[i].modifier.weight : 0);
+    }
+
+    return hash_mix(h);
+}
+
+/*
+ * equal_work: Whether the node of `e` has the given content.
+ */
+static bool equal_work(work_entry *e, uint32_t kind, uint32_t sets, eml_reps *reps, uint32_t count) {
+    eml_reps *r;
+
+    switch (kind) {
+        case frozen_none:
+            return e->kind == frozen_none;
+        case frozen_standard:
+            if (e->kind != frozen_standard || ((eml_standard_k *)e->node)->sets != sets) {
+                return false;
+            }
+            r = &((eml_standard_k *)e->node)->reps;
+            break;
+        default:
+            if (e->kind != frozen_standard_varied || ((eml_standard_varied_k *)e->node)->sets != sets) {
+                return false;
+            }
+            r = ((eml_standard_varied_k *)e->node)->vReps;
+            break;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!equal_reps(&r[i], &reps[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * work_table_grow: Doubles the table until `extra` more entries fit under 3/4 load, & reinserts its entries.
+ */
+static int work_table_grow(eml_work_table *t, uint32_t extra) {
+    if (((uint64_t)t->count + extra) * 4 <= (uint64_t)t->capacity * 3) {
+        return no_error;
+    }
+
+    uint64_t capacity = t->capacity ? t->capacity * 2 : 64;
+    while (((uint64_t)t->count + extra) * 4 > capacity * 3) {
+        capacity *= 2;
+    }
+
+    if (capacity > UINT32_MAX) {
+        return allocation_error;
+    }
+
+    work_entry *entries = calloc(capacity, sizeof(work_entry));
+    if (entries == NULL) {
+        return allocation_error;
+    }
+
+    for (uint32_t i = 0; i < t->capacity; i++) {
+        if (t->entries[i].node == NULL) {
+            continue;
+        }
+
+        uint32_t slot = t->entries[i].hash & (capacity - 1);
+        while (entries[slot].node != NULL) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = t->entries[i];
+    }
+
+    free(t->entries);
+    t->entries = entries;
+    t->capacity = capacity;
+    return no_error;
+}
+
+/*
+ * intern_work: Points whichever of `n`, `k`, `v` is set at the table's node of equal content. A new node joins the
+ *              table: taken over if `owned` (malloc'd by the result), copied otherwise (in a parse_exact() block).
+ *              A duplicate that is `owned` is freed. The table must have room (work_table_grow()), so only a copy
+ *              can fail.
+ */
+static int intern_work(eml_work_table *t, bool owned, eml_none_k **n, eml_standard_k **k, eml_standard_varied_k **v) {
+    uint32_t kind, sets = 0, count = 0, size;
+    eml_reps *reps = NULL;
+    void **node;
+
+    if (*n != NULL) {
+        kind = frozen_none;
+        size = sizeof(eml_none_k);
+        node = (void **)n;
+    } else if (*k != NULL) {
+        kind = frozen_standard;
+        sets = (*k)->sets;
+        reps = &(*k)->reps;
+        count = 1;
+        size = sizeof(eml_standard_k);
+        node = (void **)k;
+    } else if (*v != NULL) {
+        kind = frozen_standard_varied;
+        sets = count = (*v)->sets;
+        reps = (*v)->vReps;
+        size = sizeof(eml_standard_varied_k) + sizeof(eml_reps) * count;
+        node = (void **)v;
+    } else {
+        return no_error;
+    }
+
+    uint64_t h = hash_work(kind, sets, reps, count);
+    uint32_t slot = h & (t->capacity - 1);
+    for (; t->entries[slot].node != NULL; slot = (slot + 1) & (t->capacity - 1)) {
+        work_entry *e = &t->entries[slot];
+
+        if (e->hash == h && equal_work(e, kind, sets, reps, count)) {
+            if (owned && e->node != *node) {
+                free(*node);
+                t->bytes_saved += size;
+            }
+
+            *node = e->node;
+            t->references++;
+            return no_error;
+        }
+    }
+
+    if (!owned) {
+        void *copy = malloc(size);
+        if (copy == NULL) {
+            return allocation_error;
+        }
+
+        memcpy(copy, *node, size);
+        *node = copy;
+    }
+
+    t->entries[slot].hash = h;
+    t->entries[slot].node = *node;
+    t->entries[slot].kind = kind;
+    t->entries[slot].size = size;
+    t->count++;
+    t->references++;
+    return no_error;
+}
+
+/*
+ * intern_single_t: Interns the work of both sides of `s`.
+ */
+static int intern_single_t(eml_work_table *t, bool owned, eml_single_t *s) {
+    int error = no_error;
+
+    if (s->asymmetric_work == NULL) {
+        return intern_work(t, owned, &s->no_work, &s->standard_work, &s->standard_varied_work);
+    }
+
+    eml_asymmetric_k *a = s->asymmetric_work;
+    if ((error = intern_work(t, owned, &a->left_none_k, &a->left_standard_k, &a->left_standard_varied_k))) {
+        return error;
+    }
+
+    return intern_work(t, owned, &a->right_none_k, &a->right_standard_k, &a->right_standard_varied_k);
+}
+
+/*
+ * detach_work: Forgets the (interned) work of `s` so clear_single_t() leaves it to its table.
+ */
+static void detach_work(eml_single_t *s) {
+    s->no_work = NULL;
+    s->standard_work = NULL;
+    s->standard_varied_work = NULL;
+
+    if (s->asymmetric_work != NULL) {
+        s->asymmetric_work->left_none_k = NULL;
+        s->asymmetric_work->left_standard_k = NULL;
+        s->asymmetric_work->left_standard_varied_k = NULL;
+        s->asymmetric_work->right_none_k = NULL;
+        s->asymmetric_work->right_standard_k = NULL;
+        s->asymmetric_work->right_standard_varied_k = NULL;
+    }
+}
+
+/*
+ * eml_work_table_create: Creates an empty work table. It may be shared by threads.
+ */
+int eml_work_table_create(eml_work_table **table) {
+    *table = calloc(1, sizeof(eml_work_table));
+    if (*table == NULL) {
+        return allocation_error;
+    }
+
+    pthread_mutex_init(&(*table)->lock, NULL);
+    if (work_table_grow(*table, 1)) {
+        eml_work_table_free(*table);
+        *table = NULL;
+        return allocation_error;
+    }
+
+    return no_error;
+}
+
+/*
+ * eml_work_intern: Replaces the work of `result` with the table's canonical nodes, so equal work is one node (&
+ *                  comparing work within a table is comparing pointers). The table then owns the work, which becomes
+ *                  read-only (eml_convert_weight() returns shared_work_error), & must outlive the result.
+ */
+int eml_work_intern(eml_work_table *table, eml_result *result) {
+    int error = no_error;
+
+    if (result->works != NULL) {
+        return result->works == table ? no_error : shared_work_error;
+    }
+
+    // Every single has at most two work nodes
+    uint64_t nodes = 0;
+    for (uint32_t i = 0; i < result->count; i++) {
+        eml_obj *o = &result->objs[i];
+
+        if (o->type == single) {
+            nodes += o->data.single.asymmetric_work ? 2 : 1;
+        } else {
+            for (uint32_t j = 0; j < o->data.super.count; j++) {
+                nodes += o->data.super.members[j].asymmetric_work ? 2 : 1;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    // Room for every node up front, so owned work is interned whole or not at all. (Only the copies of a parse_exact()
+    // block can fail part way, & its work is freed with the block whichever nodes were interned.)
+    if (nodes > UINT32_MAX || (error = work_table_grow(table, nodes))) {
+        pthread_mutex_unlock(&table->lock);
+        return allocation_error;
+    }
+
+    result->works = table;
+
+    for (uint32_t i = 0; i < result->count && error == no_error; i++) {
+        eml_obj *o = &result->objs[i];
+
+        if (o->type == single) {
+            error = intern_single_t(table, result->block == NULL, &o->data.single);
+        } else {
+            for (uint32_t j = 0; j < o->data.super.count && error == no_error; j++) {
+                error = intern_single_t(table, result->block == NULL, &o->data.super.members[j]);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&table->lock);
+    return error;
+}
+
+/*
+ * eml_work_table_stats: Reports how much the table shares.
+ */
+void eml_work_table_stats(eml_work_table *table, eml_work_stats *stats) {
+    pthread_mutex_lock(&table->lock);
+    stats->unique = table->count;
+    stats->references = table->references;
+    stats->bytes_saved = table->bytes_saved;
+    pthread_mutex_unlock(&table->lock);
+}
+
+/*
+ * eml_work_table_free: Frees a work table & its nodes. Results interned into it must be freed first.
+ */
+void eml_work_table_free(eml_work_table *table) {
+    if (table == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        free(table->entries[i].node);
+    }
+
+    pthread_mutex_destroy(&table->lock);
+    free(table->entries);
+    free(table);
+}
+
+/*
+ * template_scan: Records the placeholders of the template's text & how many slots they number. Placeholders stand alone
+ *                outside strings: a digit or radix point next to one, or an 'x' after one (sets), is a template_error.
+ */
+static int template_scan(eml_template *t) {
+    bool quoted = false;
+
+    for (uint32_t i = 0; i < t->length; i++) {
+        if (t->text[i] == '\"') {
+            quoted = !quoted;
+        }
+
+        if (quoted || t->text[i] != '$') {
+            continue;
+        }
+
+        uint32_t begin = i;
+        uint32_t slot = 0;
+        while (i + 1 < t->length && t->text[i + 1] >= '0' && t->text[i + 1] <= '9') {
+            slot = slot * 10 + (t->text[++i] - '0');
+
+            if (slot >= TEMPLATE_MAX_SLOTS) {
+                return template_error;
+            }
+        }
+
+        char before = begin > 0 ? t->text[begin - 1] : '\0';
+        char after = i + 1 < t->length ? t->text[i + 1] : '\0';
+        if (i == begin || (before >= '0' && before <= '9') || before == '.' || after == '.' || after == 'x') {
+            return template_error;
+        }
+
+        t->placeholders[t->placeholder_count].begin = begin;
+        t->placeholders[t->placeholder_count].end = i + 1;
+        t->placeholders[t->placeholder_count].slot = slot;
+        t->placeholder_count++;
+
+        if (slot >= t->slots) {
+            t->slots = slot + 1;
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * template_splice: Writes the template's text with each placeholder replaced by its formatted value to `buffer`, as far
+ *                  as `capacity` allows, & its `length`. Returns out_of_range_error unless it (& a sentinel) fit.
+ */
+static int template_splice(eml_template *t, const eml_number *values, char *buffer, uint32_t capacity, uint32_t *length) {
+    char formatted[MAX_FORMATTED_EML_STRING_LENGTH];
+    uint64_t written = 0;
+    uint32_t from = 0;
+
+    for (uint32_t i = 0; i <= t->placeholder_count; i++) {
+        uint32_t to = i < t->placeholder_count ? t->placeholders[i].begin : t->length;
+
+        if (written + (to - from) < capacity) {
+            memcpy(buffer + written, t->text + from, to - from);
+        }
+        written += to - from;
+
+        if (i == t->placeholder_count) {
+            break;
+        }
+
+        eml_number value = values[t->placeholders[i].slot];
+        format_eml_number(&value, formatted);
+
+        uint32_t n = strlen(formatted);
+        if (written + n < capacity) {
+            memcpy(buffer + written, formatted, n);
+        }
+        written += n;
+        from = t->placeholders[i].end;
+    }
+
+    *length = written;
+    if (written >= capacity) {
+        return out_of_range_error;
+    }
+
+    buffer[written] = '\0';
+    return no_error;
+}
+
+/*
+ * template_target_add: Records `marked` as a target if it holds a marker (it then differs from `probed`, the same
+ *                      eml_number parsed with probes), & checks it is a placeholder's.
+ */
+static int template_target_add(eml_template *t, eml_number *marked, eml_number *probed, bool reps) {
+    if (*marked == *probed) {
+        return no_error;
+    }
+
+    uint32_t slot = *marked - TEMPLATE_MARKER;
+    if (*marked < TEMPLATE_MARKER || slot >= t->slots || *probed != TEMPLATE_PROBE + slot) {
+        return template_error;
+    }
+
+    if (t->target_count == t->target_capacity) {
+        uint32_t capacity = t->target_capacity ? t->target_capacity * 2 : 16;
+        template_target *targets = realloc(t->targets, sizeof(template_target) * capacity);
+        if (targets == NULL) {
+            return allocation_error;
+        }
+
+        t->targets = targets;
+        t->target_capacity = capacity;
+    }
+
+    t->targets[t->target_count].offset = (char *)marked - t->block;
+    t->targets[t->target_count].slot = slot;
+    t->targets[t->target_count].reps = reps;
+    t->target_count++;
+    return no_error;
+}
+
+/*
+ * template_targets: Finds every reps value & modifier where the template was parsed to a marker by comparing the
+ *                   `marked` parse with the `probed` one, member by member. Both have the same shape.
+ */
+static int template_targets(eml_template *t, eml_result *marked, eml_result *probed) {
+    int error = no_error;
+
+    for (uint32_t i = 0; i < marked->count; i++) {
+        eml_obj *a = &marked->objs[i];
+        eml_obj *b = &probed->objs[i];
+
+        uint32_t members = a->type == single ? 1 : a->data.super.count;
+        eml_single_t *ma = a->type == single ? &a->data.single : a->data.super.members;
+        eml_single_t *mb = b->type == single ? &b->data.single : b->data.super.members;
+
+        for (uint32_t j = 0; j < members; j++) {
+            for (bool side = left; side <= right; side++) {
+                uint32_t count;
+                eml_reps *ra = work_reps(&ma[j], side, &count);
+                eml_reps *rb = work_reps(&mb[j], side, &count);
+
+                for (uint32_t k = 0; k < count; k++) {
+                    if ((error = template_target_add(t, &ra[k].value, &rb[k].value, true))) {
+                        return error;
+                    }
+
+                    if (reps_has_modifier(&ra[k]) && (error = template_target_add(t, &ra[k].modifier.weight, &rb[k].modifier.weight, false))) {
+                        return error;
+                    }
+                }
+            }
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * template_check: Checks `values` fills the template's slots with what the parser would accept in their positions.
+ */
+static int template_check(eml_template *t, const eml_number *values, uint32_t count) {
+    if (count != t->slots) {
+        return template_error;
+    }
+
+    for (uint32_t i = 0; i < t->target_count; i++) {
+        eml_number value = values[t->targets[i].slot];
+
+        if (t->targets[i].reps && (value & eml_number_H)) {
+            return fractional_none_modifier_value_error;
+        }
+
+        if (!(value & eml_number_H) && value > 21474836U) {
+            return integral_overflow_error;
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * rebase_single_t: Moves the pointers of `s` from a block at `from` to its copy at `to`.
+ */
+static void rebase_single_t(eml_single_t *s, char *from, char *to) {
+    #define REBASE(p) ((p) = (p) == NULL ? NULL : (void *)((char *)(p) - from + to))
+
+    REBASE(s->name);
+    REBASE(s->no_work);
+    REBASE(s->standard_work);
+    REBASE(s->standard_varied_work);
+    REBASE(s->asymmetric_work);
+
+    if (s->asymmetric_work != NULL) {
+        REBASE(s->asymmetric_work->left_none_k);
+        REBASE(s->asymmetric_work->left_standard_k);
+        REBASE(s->asymmetric_work->left_standard_varied_k);
+        REBASE(s->asymmetric_work->right_none_k);
+        REBASE(s->asymmetric_work->right_standard_k);
+        REBASE(s->asymmetric_work->right_standard_varied_k);
+    }
+}
+
+/*
+ * rebase_result: Moves the pointers of a parse_exact() result from its block at `from` to the block's copy at `to`.
+ */
+static void rebase_result(eml_result *r, char *from, char *to) {
+    REBASE(r->header);
+    REBASE(r->objs);
+    REBASE(r->block);
+
+    for (eml_header_t *h = r->header; h != NULL; h = h->next) {
+        REBASE(h->next);
+        REBASE(h->parameter);
+        REBASE(h->value);
+    }
+
+    for (uint32_t i = 0; i < r->count; i++) {
+        eml_obj *o = &r->objs[i];
+
+        if (o->type == single) {
+            rebase_single_t(&o->data.single, from, to);
+            continue;
+        }
+
+        REBASE(o->data.super.members);
+        for (uint32_t j = 0; j < o->data.super.count; j++) {
+            rebase_single_t(&o->data.super.members[j], from, to);
+        }
+    }
+
+    #undef REBASE
+}
+
+/*
+ * eml_template_compile: Compiles the first `length` bytes of `text`, EML with "$N" placeholders (see eml_template).
+ *                       The template is parsed (& so validated) here, once with a marker in place of each placeholder
+ *                       & once with a probe; where the two parses differ is where the placeholders' values go.
+ */
+int eml_template_compile(const char *text, uint32_t length, eml_template **tmpl) {
+    int error = no_error;
+    eml_result *marked = NULL;
+    eml_result *probed = NULL;
+    eml_number *markers = NULL;
+    char *buffer = NULL;
+    uint32_t buffer_length;
+    uint32_t objects;
+
+    eml_template *t = calloc(1, sizeof(eml_template));
+    if (t == NULL) {
+        return allocation_error;
+    }
+
+    // A placeholder is at least 2 bytes ("$0") & a marker 8, so a marked text is at most 4 times as long
+    t->text = malloc((uint64_t)length + 1);
+    t->placeholders = malloc(sizeof(template_placeholder) * ((uint64_t)length / 2 + 1));
+    buffer = malloc((uint64_t)length * 4 + 1);
+    if (t->text == NULL || t->placeholders == NULL || buffer == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    memcpy(t->text, text, length);
+    t->text[length] = '\0';
+    t->length = length;
+
+    if ((error = template_scan(t))) {
+        goto bail;
+    }
+
+    markers = malloc(sizeof(eml_number) * ((uint64_t)t->slots + 1));
+    if (markers == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < t->slots; i++) {
+        markers[i] = TEMPLATE_MARKER + i;
+    }
+
+    template_splice(t, markers, buffer, length * 4 + 1, &buffer_length);
+    if ((error = parse_exact(buffer, buffer_length, &marked))) {
+        goto bail;
+    }
+
+    // Only copyable as one block (should the prescan have been off, parse_exact() fell back to malloc)
+    if (marked->block == NULL) {
+        error = unexpected_error;
+        goto bail;
+    }
+
+    t->block = marked->block;
+    t->size = prescan(buffer, buffer_length, &objects); // The size parse_exact() allocated
+    t->result_offset = (char *)marked - t->block;
+    marked = NULL;
+
+    for (uint32_t i = 0; i < t->slots; i++) {
+        markers[i] = TEMPLATE_PROBE + i;
+    }
+
+    template_splice(t, markers, buffer, length * 4 + 1, &buffer_length);
+    if ((error = parse_exact(buffer, buffer_length, &probed))) {
+        goto bail;
+    }
+
+    if ((error = template_targets(t, (eml_result *)(t->block + t->result_offset), probed))) {
+        goto bail;
+    }
+
+    // Every placeholder must have landed in a value (not, say, in a none work's ignored digits)
+    for (uint32_t i = 0; i < t->placeholder_count; i++) {
+        uint32_t j = 0;
+        while (j < t->target_count && t->targets[j].slot != t->placeholders[i].slot) {
+            j++;
+        }
+
+        if (j == t->target_count) {
+            error = template_error;
+            goto bail;
+        }
+    }
+
+    bail:
+        free_result(marked);
+        free_result(probed);
+        free(markers);
+        free(buffer);
+
+        if (error) {
+            eml_template_free(t);
+            t = NULL;
+        }
+
+        *tmpl = t;
+        return error;
+}
+
+/*
+ * eml_template_slots: Returns how many values instantiating the template takes (the highest placeholder N + 1).
+ */
+uint32_t eml_template_slots(eml_template *tmpl) {
+    return tmpl->slots;
+}
+
+/*
+ * eml_template_instantiate: Makes the template's result with values[N] for each "$N": a copy of the compiled block,
+ *                           rebased & patched, so it is a parse_exact() result (one allocation) freed by free_result().
+ */
+int eml_template_instantiate(eml_template *tmpl, const eml_number *values, uint32_t count, eml_result **result) {
+    int error = no_error;
+    *result = NULL;
+
+    if ((error = template_check(tmpl, values, count))) {
+        return error;
+    }
+
+    char *block = malloc(tmpl->size);
+    if (block == NULL) {
+        return allocation_error;
+    }
+
+    memcpy(block, tmpl->block, tmpl->size);
+    rebase_result((eml_result *)(block + tmpl->result_offset), tmpl->block, block);
+
+    for (uint32_t i = 0; i < tmpl->target_count; i++) {
+        *(eml_number *)(block + tmpl->targets[i].offset) = values[tmpl->targets[i].slot];
+    }
+
+    *result = (eml_result *)(block + tmpl->result_offset);
+    return no_error;
+}
+
+/*
+ * eml_template_write: Writes the template's EML text with values[N] for each "$N" to `buffer` & its `length`
+ *                     (excluding the sentinel). Should it not fit in `capacity`, returns out_of_range_error with the
+ *                     `length` needed.
+ */
+int eml_template_write(eml_template *tmpl, const eml_number *values, uint32_t count, char *buffer, uint32_t capacity, uint32_t *length) {
+    int error = no_error;
+
+    if ((error = template_check(tmpl, values, count))) {
+        return error;
+    }
+
+    return template_splice(tmpl, values, buffer, capacity, length);
+}
+
+/*
+ * eml_template_free: Frees a template. Results instantiated from it are independent of it.
+ */
+void eml_template_free(eml_template *tmpl) {
+    if (tmpl == NULL) {
+        return;
+    }
+
+    free(tmpl->text);
+    free(tmpl->placeholders);
+    free(tmpl->block);
+    free(tmpl->targets);
+    free(tmpl);
+}
+
+/*
+ * diff_index_build: Collects the singles of `performed` (members of supers & circuits included) & chains each name's
+ *                   in document order.
+ */
+static int diff_index_build(eml_result *performed, diff_index *index) {
+    for (uint32_t i = 0; i < performed->count; i++) {
+        index->count += performed->objs[i].type == single ? 1 : performed->objs[i].data.super.count;
+    }
+
+    if (index->count == 0) {
+        return no_error;
+    }
+
+    // Keep the load factor at or under 1/2
+    index->capacity = 16;
+    while (index->capacity < index->count * 2) {
+        index->capacity *= 2;
+    }
+
+    index->entries = malloc(sizeof(diff_entry) * index->count);
+    index->slots = calloc(index->capacity, sizeof(diff_slot));
+    if (index->entries == NULL || index->slots == NULL) {
+        return allocation_error;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < performed->count; i++) {
+        eml_obj *o = &performed->objs[i];
+        uint32_t members = o->type == single ? 1 : o->data.super.count;
+
+        for (uint32_t j = 0; j < members; j++, n++) {
+            diff_entry *e = &index->entries[n];
+            e->single = o->type == single ? &o->data.single : &o->data.super.members[j];
+            e->hash = hash_string(FNV_OFFSET_BASIS, e->single->name);
+            e->obj = i;
+            e->member = j;
+            e->next = 0;
+            e->matched = false;
+
+            uint32_t slot = e->hash & (index->capacity - 1);
+            while (index->slots[slot].key != 0) {
+                diff_entry *k = &index->entries[index->slots[slot].key - 1];
+                if (k->hash == e->hash && strcmp(k->single->name, e->single->name) == 0) {
+                    break;
+                }
+                slot = (slot + 1) & (index->capacity - 1);
+            }
+
+            diff_slot *s = &index->slots[slot];
+            if (s->key == 0) {
+                s->key = s->head = n + 1;
+            } else {
+                index->entries[s->tail - 1].next = n + 1;
+            }
+            s->tail = n + 1;
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * diff_index_match: Marks & returns (index + 1) the first unmatched entry named `name`, or 0 if there is none.
+ */
+static uint32_t diff_index_match(diff_index *index, const char *name) {
+    if (index->capacity == 0) {
+        return 0;
+    }
+
+    uint64_t hash = hash_string(FNV_OFFSET_BASIS, name);
+    uint32_t slot = hash & (index->capacity - 1);
+
+    while (index->slots[slot].key != 0) {
+        diff_slot *s = &index->slots[slot];
+        diff_entry *k = &index->entries[s->key - 1];
+
+        if (k->hash == hash && strcmp(k->single->name, name) == 0) {
+            uint32_t match = s->head;
+            if (match != 0) {
+                index->entries[match - 1].matched = true;
+                s->head = index->entries[match - 1].next;
+            }
+            return match;
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+
+    return 0;
+}
+
+/*
+ * diff_emit: Completes `d` as a difference of `kind` & writes it to `differences` while there is room.
+ */
+static void diff_emit(eml_difference *d, uint32_t kind, uint32_t set, uint32_t planned, uint32_t performed, eml_difference *differences, uint32_t capacity, uint32_t *found) {
+    d->kind = kind;
+    d->set = set;
+    d->planned = planned;
+    d->performed = performed;
+
+    if (*found < capacity) {
+        differences[*found] = *d;
+    }
+    (*found)++;
+}
+
+/*
+ * diff_convert: Sets how `performed`'s weights are converted to `planned`'s unit (see query_weight()). Weights in the
+ *               same unit are compared as written; those in different units must be in "lbs" & "kg".
+ */
+static int diff_convert(eml_result *planned, eml_result *performed, uint32_t *convert) {
+    eml_header_t *a = find_header_t(planned, "weight");
+    eml_header_t *b = find_header_t(performed, "weight");
+
+    *convert = 0;
+    if (a == NULL || b == NULL) {
+        return missing_weight_unit;
+    }
+
+    if (strcmp(a->value, b->value) == 0) {
+        return no_error;
+    }
+
+    if (strcmp(a->value, "kg") == 0 && strcmp(b->value, "lbs") == 0) {
+        *convert = 1;
+    } else if (strcmp(a->value, "lbs") == 0 && strcmp(b->value, "kg") == 0) {
+        *convert = 2;
+    } else {
+        return unknown_weight_unit_error;
+    }
+
+    return no_error;
+}
+
+/*
+ * diff_reps: Emits how the performed reps `b` of a set differ from the planned `a`. Values & modifiers are compared
+ *            whatever their eml_number form; modifiers only when both are weights or both RPEs, a performed weight
+ *            first converted as diff_convert() decided.
+ */
+static void diff_reps(eml_difference *d, uint32_t set, eml_reps *a, eml_reps *b, uint32_t convert, eml_difference *differences, uint32_t capacity, uint32_t *found) {
+    if (eml_number_compare(a->value, b->value) != 0) {
+        diff_emit(d, reps_value_change, set, a->value, b->value, differences, capacity, found);
+    }
+
+    if (a->type != b->type) {
+        diff_emit(d, reps_type_change, set, a->type, b->type, differences, capacity, found);
+    }
+
+    if (!reps_has_modifier(a) || !reps_has_modifier(b) || reps_has_weight(a) != reps_has_weight(b)) {
+        return;
+    }
+
+    if (convert == 0 || !reps_has_weight(a)) {
+        if (eml_number_compare(a->modifier.weight, b->modifier.weight) != 0) {
+            diff_emit(d, reps_modifier_change, set, a->modifier.weight, b->modifier.weight, differences, capacity, found);
+        }
+        return;
+    }
+
+    // A converted weight is reported in hundredths of the planned unit, the largest eml_number if it is larger
+    uint64_t performed = query_weight(b->modifier.weight, convert);
+    if (eml_number_hundredths(a->modifier.weight) != performed) {
+        performed = performed > eml_number_mask ? eml_number_mask : performed;
+        diff_emit(d, reps_modifier_change, set, a->modifier.weight, (uint32_t)performed | eml_number_H, differences, capacity, found);
+    }
+}
+
+/*
+ * diff_side: Emits how side `b_side` of `b` differs from side `a_side` of `a`. Sets are compared up to the fewer of the
+ *            two; standard work repeats its reps for each, so 3x5 & 3x(5,5,5) do not differ.
+ */
+static void diff_side(eml_difference *d, eml_single_t *a, bool a_side, eml_single_t *b, bool b_side, uint32_t convert, eml_difference *differences, uint32_t capacity, uint32_t *found) {
+    uint32_t a_sets, b_sets, a_count, b_count;
+    uint32_t a_kind = work_kind(a, a_side, &a_sets);
+    uint32_t b_kind = work_kind(b, b_side, &b_sets);
+    eml_reps *a_reps = work_reps(a, a_side, &a_count);
+    eml_reps *b_reps = work_reps(b, b_side, &b_count);
+
+    if (a_sets != b_sets) {
+        diff_emit(d, set_count_change, EML_DIFF_EVERY_SET, a_sets, b_sets, differences, capacity, found);
+    }
+
+    if (a_kind == frozen_standard && b_kind == frozen_standard) {
+        diff_reps(d, EML_DIFF_EVERY_SET, a_reps, b_reps, convert, differences, capacity, found);
+        return;
+    }
+
+    uint32_t sets = a_sets < b_sets ? a_sets : b_sets;
+    for (uint32_t i = 0; i < sets; i++) {
+        eml_reps *x = a_kind == frozen_standard ? a_reps : &a_reps[i];
+        eml_reps *y = b_kind == frozen_standard ? b_reps : &b_reps[i];
+
+        diff_reps(d, i, x, y, convert, differences, capacity, found);
+    }
+}
+
+/*
+ * diff_single_t: Emits how the performed single `b` differs from the planned `a`. When either is asymmetric both
+ *                sides are compared, the work of a symmetric single standing for each of its sides.
+ */
+static void diff_single_t(eml_difference *d, eml_single_t *a, eml_single_t *b, uint32_t convert, eml_difference *differences, uint32_t capacity, uint32_t *found) {
+    if (a->asymmetric_work == NULL && b->asymmetric_work == NULL) {
+        d->side = both_sides;
+        diff_side(d, a, left, b, left, convert, differences, capacity, found);
+        return;
+    }
+
+    for (bool side = left; side <= right; side++) {
+        d->side = side == left ? left_side : right_side;
+        diff_side(d, a, a->asymmetric_work != NULL && side, b, b->asymmetric_work != NULL && side, convert, differences, capacity, found);
+    }
+}
+
+/*
+ * eml_diff: Writes up to `capacity` differences of `performed` from `planned` to `differences` & sets `found` to the
+ *           total number, which may exceed `capacity`. The nth single of a name in `planned` is matched with the nth
+ *           of that name in `performed` (supers & circuits are looked through); differences follow `planned` order,
+ *           with extra exercises last in `performed` order. Weights are compared in `planned`'s unit. Linear in the
+ *           number of singles & sets, through a hash table of performed names; the one allocation is that table.
+ */
+int eml_diff(eml_result *planned, eml_result *performed, eml_difference *differences, uint32_t capacity, uint32_t *found) {
+    int error = no_error;
+    diff_index index = {NULL, 0, NULL, 0};
+    uint32_t convert;
+
+    *found = 0;
+    if ((error = diff_convert(planned, performed, &convert))) {
+        return error;
+    }
+
+    if ((error = diff_index_build(performed, &index))) {
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < planned->count; i++) {
+        eml_obj *o = &planned->objs[i];
+        uint32_t members = o->type == single ? 1 : o->data.super.count;
+
+        for (uint32_t j = 0; j < members; j++) {
+            eml_single_t *s = o->type == single ? &o->data.single : &o->data.super.members[j];
+            eml_difference d = {missing_exercise, both_sides, i, j, EML_DIFF_ABSENT, EML_DIFF_ABSENT, 0, 0, 0};
+            uint32_t match = diff_index_match(&index, s->name);
+
+            if (match == 0) {
+                diff_emit(&d, missing_exercise, 0, 0, 0, differences, capacity, found);
+                continue;
+            }
+
+            d.performed_obj = index.entries[match - 1].obj;
+            d.performed_member = index.entries[match - 1].member;
+            diff_single_t(&d, s, index.entries[match - 1].single, convert, differences, capacity, found);
+        }
+    }
+
+    for (uint32_t i = 0; i < index.count; i++) {
+        diff_entry *e = &index.entries[i];
+
+        if (!e->matched) {
+            eml_difference d = {extra_exercise, both_sides, EML_DIFF_ABSENT, EML_DIFF_ABSENT, e->obj, e->member, 0, 0, 0};
+            diff_emit(&d, extra_exercise, 0, 0, 0, differences, capacity, found);
+        }
+    }
+
+bail:
+    free(index.entries);
+    free(index.slots);
+    return error;
+}
+
+/*
+ * csv_flush: Hands the buffered CSV to the sink.
+ */
+static int csv_flush(eml_csv_writer *csv) {
+    if (csv->out.length == 0) {
+        return no_error;
+    }
+
+    int error = csv->sink((char *)csv->out.data, csv->out.length, csv->context) ? io_error : no_error;
+    csv->out.length = 0;
+    return error;
+}
+
+/*
+ * csv_text: Appends `text` as a field (quoted if it holds ',', '"' or a line break) followed by `end`.
+ */
+static int csv_text(byte_buffer *b, const char *text, char end) {
+    uint32_t length = strlen(text);
+    int error;
+
+    // At worst every byte is a doubled quote
+    if ((error = buffer_reserve(b, 2 * (uint64_t)length + 3))) {
+        return error;
+    }
+
+    if (strpbrk(text, ",\"\r\n") == NULL) {
+        memcpy(b->data + b->length, text, length);
+        b->length += length;
+        b->data[b->length++] = end;
+        return no_error;
+    }
+
+    b->data[b->length++] = '\"';
+    for (const char *c = text; *c != '\0'; c++) {
+        if (*c == '\"') {
+            b->data[b->length++] = '\"';
+        }
+        b->data[b->length++] = *c;
+    }
+    b->data[b->length++] = '\"';
+    b->data[b->length++] = end;
+    return no_error;
+}
+
+/*
+ * csv_u32: Appends `v` in decimal followed by `end`.
+ */
+static int csv_u32(byte_buffer *b, uint32_t v, char end) {
+    char digits[11];
+    uint32_t i = sizeof(digits);
+
+    digits[--i] = end;
+    do {
+        digits[--i] = '0' + v % 10U;
+        v /= 10U;
+    } while (v != 0);
+
+    return buffer_bytes(b, digits + i, sizeof(digits) - i);
+}
+
+/*
+ * csv_eml_number: Appends `e` as the parser formats it, followed by `end`.
+ */
+static int csv_eml_number(byte_buffer *b, eml_number e, char end) {
+    char formatted[MAX_FORMATTED_EML_STRING_LENGTH + 1];
+    uint32_t length;
+
+    format_eml_number(&e, formatted);
+    length = strlen(formatted);
+    formatted[length++] = end;
+
+    return buffer_bytes(b, formatted, length);
+}
+
+/*
+ * csv_header: Sets the fields leading each row to the values of the chosen parameters in the header of `result`
+ *             (empty for a NULL result).
+ */
+static int csv_header(eml_csv_writer *csv, eml_result *result) {
+    int error = no_error;
+
+    csv->prefix.length = 0;
+
+    for (uint32_t i = 0; i < csv->column_count && !error; i++) {
+        eml_header_t *h = result != NULL ? find_header_t(result, csv->columns[i]) : NULL;
+        error = csv_text(&csv->prefix, h != NULL && h->value != NULL ? h->value : "", ',');
+    }
+
+    return error;
+}
+
+/*
+ * csv_row: Appends the row of `sets` sets (set `set`, or CSV_NO_SET) of reps `r` (NULL for no work) of the current
+ *          single & side, handing the CSV to the sink once CSV_BUFFER_SIZE bytes are buffered.
+ */
+static int csv_row(eml_csv_writer *csv, uint32_t set, uint32_t sets, eml_reps *r) {
+    byte_buffer *b = &csv->out;
+    int error;
+
+    if ((csv->prefix.length > 0 && (error = buffer_bytes(b, csv->prefix.data, csv->prefix.length)))
+        || (error = buffer_bytes(b, csv->lead.data, csv->lead.length))
+        || (error = set == CSV_NO_SET ? buffer_bytes(b, ",", 1) : csv_u32(b, set, ','))
+        || (error = csv_u32(b, sets, ','))) {
+        return error;
+    }
+
+    if (r == NULL) {
+        error = buffer_bytes(b, ",,,,\n", 5);
+    } else {
+        bool failure = r->type == unmodifiedFailure || r->type == unmodifiedTimeFailure
+            || r->type == weightFailure || r->type == timeWeightFaliure;
+        bool time = r->type == unmodifiedTime || r->type == unmodifiedTimeFailure
+            || r->type == timeWeight || r->type == timeWeightFaliure || r->type == timeRPE;
+
+        if ((error = failure ? buffer_bytes(b, ",", 1) : csv_eml_number(b, r->value, ','))
+            || (error = buffer_bytes(b, failure ? "1," : "0,", 2))
+            || (error = buffer_bytes(b, time ? "1," : "0,", 2))) {
+            return error;
+        }
+
+        // The weight & RPE fields, one of which may hold the modifier
+        if (reps_has_weight(r)) {
+            error = csv_eml_number(b, r->modifier.weight, ',');
+            error = error ? error : buffer_bytes(b, "\n", 1);
+        } else if (reps_has_modifier(r)) {
+            error = buffer_bytes(b, ",", 1);
+            error = error ? error : csv_eml_number(b, r->modifier.rpe, '\n');
+        } else {
+            error = buffer_bytes(b, ",\n", 2);
+        }
+    }
+
+    if (error == no_error && b->length >= CSV_BUFFER_SIZE) {
+        error = csv_flush(csv);
+    }
+
+    return error;
+}
+
+/*
+ * csv_single_t: Appends the rows of `s`, member `member` of a top level object of `type`.
+ */
+static int csv_single_t(eml_csv_writer *csv, eml_objtype type, uint32_t member, eml_single_t *s) {
+    static const char *types[] = {"single,", "super,", "circuit,"};
+    static const char *sides[] = {"both,", "left,", "right,"};
+    int error = no_error;
+
+    csv->lead.length = 0;
+    if ((error = csv_u32(&csv->lead, csv->documents ? csv->documents - 1 : 0, ','))
+        || (error = csv_u32(&csv->lead, csv->objects, ','))
+        || (error = buffer_bytes(&csv->lead, types[type], strlen(types[type])))
+        || (error = csv_u32(&csv->lead, member, ','))
+        || (error = csv_text(&csv->lead, s->name, ','))) {
+        return error;
+    }
+
+    uint64_t named = csv->lead.length;
+
+    for (bool side = left; side <= right && !error; side++) {
+        uint32_t sets, count;
+
+        if (s->asymmetric_work == NULL && side == right) {
+            break;
+        }
+
+        uint32_t kind = work_kind(s, side, &sets);
+        eml_reps *r = work_reps(s, side, &count);
+        const char *name = sides[s->asymmetric_work == NULL ? both_sides : side == left ? left_side : right_side];
+
+        csv->lead.length = named;
+        if ((error = buffer_bytes(&csv->lead, name, strlen(name)))) {
+            return error;
+        }
+
+        if (kind == frozen_standard && csv->rows == csv_set_groups) {
+            error = csv_row(csv, CSV_NO_SET, sets, r);
+        } else if (kind == frozen_standard || kind == frozen_standard_varied) {
+            for (uint32_t i = 0; i < sets && !error; i++) {
+                error = csv_row(csv, i, 1, kind == frozen_standard ? r : &r[i]);
+            }
+        } else {
+            error = csv_row(csv, CSV_NO_SET, 0, NULL);
+        }
+    }
+
+    return error;
+}
+
+/*
+ * csv_unit_end: Returns the offset past the end of the header ('}'), single (';') or super/circuit (the ')' outside its
+ *               members, as prescan_super_t()) starting at `position`, or 0 if it does not end in the `length` bytes
+ *               of `s`, in which case the search resumes from where it stopped on the next call. Names are skipped.
+ */
+static uint32_t csv_unit_end(eml_csv_writer *csv, const char *s, uint32_t length, uint32_t position) {
+    char end = s[position] == (int)'{' ? '}' : s[position] == (int)'\"' ? ';' : ')';
+
+    for (uint32_t i = position + csv->scanned; i < length; i++) {
+        if (s[i] == (int)'\"') {
+            csv->quoted = !csv->quoted;
+            csv->member = csv->member || end == ')';
+        } else if (csv->quoted) {
+            continue;
+        } else if (csv->member) {
+            csv->member = s[i] != (int)';';
+        } else if (s[i] == end) {
+            csv->scanned = 0;
+            return i + 1;
+        }
+    }
+
+    csv->scanned = length - position;
+    return 0;
+}
+
+/*
+ * csv_unit: Parses a header or top level object into the writer's block & buffers its rows, or the header's values.
+ *           Like parse_exact(), a unit the prescan & parse disagree on, or with an error, is parsed again by
+ *           parse_length().
+ */
+static int csv_unit(eml_csv_writer *csv, const char *s, uint32_t length) {
+    uint32_t objects;
+    uint64_t size = prescan(s, length, &objects);
+    eml_result *result;
+    bool owned = false;
+    int error;
+
+    if (size > csv->scratch_size) {
+        uint8_t *scratch = realloc(csv->scratch, size);
+        if (scratch == NULL) {
+            return allocation_error;
+        }
+
+        csv->scratch = scratch;
+        csv->scratch_size = size;
+    }
+
+    arena.base = csv->scratch;
+    arena.used = 0;
+    arena.size = size;
+    arena.objects = objects;
+
+    error = parse_length((char *)s, length, &result);
+    arena.base = NULL;
+
+    if (error) {
+        if ((error = parse_length((char *)s, length, &result))) {
+            return error;
+        }
+        owned = true;
+    }
+
+    if (result->header != NULL) {
+        csv->documents++;
+        csv->objects = 0;
+        error = csv_header(csv, result);
+    }
+
+    for (uint32_t i = 0; i < result->count && !error; i++, csv->objects++) {
+        eml_obj *o = &result->objs[i];
+
+        if (o->type == single) {
+            error = csv_single_t(csv, single, 0, &o->data.single);
+            continue;
+        }
+
+        for (uint32_t j = 0; j < o->data.super.count && !error; j++) {
+            error = csv_single_t(csv, o->type, j, &o->data.super.members[j]);
+        }
+    }
+
+    if (owned) {
+        free_result(result);
+    }
+
+    return error;
+}
+
+/*
+ * csv_transcode: Transcodes the units `s` holds in full, or with `last`, all of it, setting `consumed` to the bytes
+ *                transcoded. On an error, parse_error_offset() is where in the input it was found.
+ */
+static int csv_transcode(eml_csv_writer *csv, const char *s, uint32_t length, bool last, uint32_t *consumed) {
+    uint32_t position = 0, end;
+    int error = no_error;
+
+    while (position < length) {
+        switch (s[position]) {
+            case (int)';':
+                ++position;
+                continue;
+            case (int)'{':
+            case (int)'\"':
+            case (int)'s':
+            case (int)'c':
+                break;
+            default:
+                current_postition = 0;
+                error = unexpected_error;
+                goto bail;
+        }
+
+        if ((end = csv_unit_end(csv, s, length, position)) == 0) {
+            if (!last) {
+                break;
+            }
+            end = length;
+        }
+
+        if ((error = csv_unit(csv, s + position, end - position))) {
+            goto bail;
+        }
+        position = end;
+    }
+
+    *consumed = position;
+    return no_error;
+
+    bail:
+        *consumed = position;
+        current_postition = (uint32_t)(csv->offset + position + current_postition);
+        return error;
+}
+
+/*
+ * eml_csv_open: Starts a writer of `rows` whose rows lead with the `count` header parameters `columns` (which must
+ *               outlive it), & buffers the header row. CSV goes to `sink` with `context`.
+ */
+int eml_csv_open(const char **columns, uint32_t count, eml_csv_rows rows, eml_csv_sink sink, void *context, eml_csv_writer **csv) {
+    static const char *fields = "document,object,type,member,exercise,side,set,sets,reps,failure,time,weight_value,rpe_value\n";
+    int error = no_error;
+
+    *csv = calloc(1, sizeof(eml_csv_writer));
+    if (*csv == NULL) {
+        return allocation_error;
+    }
+
+    (*csv)->sink = sink;
+    (*csv)->context = context;
+    (*csv)->rows = rows;
+    (*csv)->columns = columns;
+    (*csv)->column_count = count;
+
+    for (uint32_t i = 0; i < count && !error; i++) {
+        error = csv_text(&(*csv)->out, columns[i], ',');
+    }
+
+    if (error
+        || (error = buffer_bytes(&(*csv)->out, fields, strlen(fields)))
+        || (error = buffer_reserve(&(*csv)->out, CSV_BUFFER_SIZE))
+        || (error = csv_header(*csv, NULL))) {
+        free((*csv)->out.data);
+        free((*csv)->prefix.data);
+        free(*csv);
+        *csv = NULL;
+    }
+
+    return error;
+}
+
+/*
+ * eml_csv_write: Transcodes the next `length` bytes of input. Whole objects are transcoded in place; only an object
+ *                split across writes is copied (up to each terminator it may end at) until it is whole. After an
+ *                error the writer is stopped & returns it again.
+ */
+int eml_csv_write(eml_csv_writer *csv, const char *data, uint32_t length) {
+    uint32_t consumed;
+    int error;
+
+    if (csv->error) {
+        return csv->error;
+    }
+
+    while (csv->pending.length > 0 && length > 0) {
+        uint32_t n = 0;
+        while (n < length && data[n] != ';' && data[n] != ')' && data[n] != '}') {
+            n++;
+        }
+        n += n < length;
+
+        if ((error = buffer_bytes(&csv->pending, data, n))) {
+            goto bail;
+        }
+        data += n;
+        length -= n;
+
+        error = csv_transcode(csv, (char *)csv->pending.data, csv->pending.length, false, &consumed);
+        csv->offset += consumed;
+        csv->pending.length -= consumed;
+        memmove(csv->pending.data, csv->pending.data + consumed, csv->pending.length);
+
+        if (error) {
+            goto bail;
+        }
+    }
+
+    if (length > 0) {
+        error = csv_transcode(csv, data, length, false, &consumed);
+        csv->offset += consumed;
+
+        if (error || (consumed < length && (error = buffer_bytes(&csv->pending, data + consumed, length - consumed)))) {
+            goto bail;
+        }
+    }
+
+    return no_error;
+
+    bail:
+        csv->error = error;
+        return error;
+}
+
+/*
+ * eml_csv_close: Transcodes what is left of the input (as parse_length() would the end of a document), hands the
+ *                buffered CSV to the sink & frees the writer. Returns the writer's first error.
+ */
+int eml_csv_close(eml_csv_writer *csv) {
+    uint32_t consumed;
+    int error = csv->error;
+
+    if (error == no_error && csv->pending.length > 0) {
+        error = csv_transcode(csv, (char *)csv->pending.data, csv->pending.length, true, &consumed);
+    }
+
+    if (error == no_error) {
+        error = csv_flush(csv);
+    }
+
+    free(csv->prefix.data);
+    free(csv->lead.data);
+    free(csv->out.data);
+    free(csv->pending.data);
+    free(csv->scratch);
+    free(csv);
+    return error;
+}
+
+/*
+ * lazy_add: Records the top level object in [begin, end) of the document, & the name of a single.
+ */
+static int lazy_add(eml_lazy *lazy, uint32_t begin, uint32_t end) {
+    if (lazy->count == lazy->capacity) {
+        uint32_t capacity = lazy->capacity ? lazy->capacity * 2 : 16;
+        eml_lazy_entry *entries = realloc(lazy->entries, sizeof(eml_lazy_entry) * capacity);
+        if (entries == NULL) {
+            return allocation_error;
+        }
+
+        lazy->entries = entries;
+        lazy->capacity = capacity;
+    }
+
+    const char *s = lazy->document;
+    eml_lazy_entry *e = &lazy->entries[lazy->count++];
+    e->begin = begin;
+    e->end = end;
+    e->name_begin = 0;
+    e->name_length = 0;
+
+    switch (s[begin]) {
+        case (int)'s':
+            e->type = super;
+            break;
+        case (int)'c':
+            e->type = circuit;
+            break;
+        default:
+            e->type = single;
+            e->name_begin = begin + 1;
+
+            uint32_t position = e->name_begin;
+            while (position < end && s[position] != (int)'\"') {
+                ++position;
+            }
+
+            e->name_length = position - e->name_begin;
+            break;
+    }
+
+    return no_error;
+}
+
+/*
+ * lazy_has_name: Whether the object `e` is, or (a super/circuit) has as a member, a single named `name`. Members are
+ *                found as prescan_super_t() finds them, without parsing.
+ */
+static bool lazy_has_name(eml_lazy *lazy, eml_lazy_entry *e, const char *name, uint32_t length) {
+    const char *s = lazy->document;
+
+    if (e->type == single) {
+        return e->name_length == length && memcmp(s + e->name_begin, name, length) == 0;
+    }
+
+    bool member = false;  // Inside a member, whose ';' ends it
+    for (uint32_t position = e->begin; position < e->end; position++) {
+        if (member) {
+            member = s[position] != (int)';';
+        } else if (s[position] == (int)'\"') {
+            uint32_t begin = position + 1;
+
+            do {
+                ++position;
+            } while (position < e->end && s[position] != (int)'\"');
+
+            if (position - begin == length && memcmp(s + begin, name, length) == 0) {
+                return true;
+            }
+
+            member = true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * eml_lazy_open: Opens `eml_string` lazily. Its header is parsed now; its objects are only walked (as by prescan()) to
+ *                record their types, extents & names, each parsed on its first eml_lazy_object(). A malformed object
+ *                is found then (parsed within its extent, so its error may differ from parse_length()'s), a character
+ *                no object can start with now. parse_error_offset() tells where.
+ */
+int eml_lazy_open(char *eml_string, uint32_t length, eml_lazy **lazy) {
+    int error = no_error;
+    uint32_t position = 0, members;
+
+    *lazy = calloc(1, sizeof(eml_lazy));
+    if (*lazy == NULL) {
+        return allocation_error;
+    }
+
+    (*lazy)->document = eml_string;
+    (*lazy)->length = length;
+
+    (*lazy)->head = calloc(1, sizeof(eml_result));
+    if ((*lazy)->head == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    emlString = eml_string;
+    emlstringlen = length;
+    version[0] = 0;
+    weightUnit[0] = 0;
+
+    while (position < length) {
+        uint32_t begin = position;
+
+        switch (eml_string[position]) {
+            case (int)'{':
+                current_postition = position;
+                if ((error = parse_header((*lazy)->head))) {
+                    goto bail;
+                }
+
+                if (version[0] == '\0') {
+                    error = missing_version;
+                    goto bail;
+                }
+
+                if (weightUnit[0] == '\0') {
+                    error = missing_weight_unit;
+                    goto bail;
+                }
+
+                position = current_postition;
+                continue;
+            case (int)'s':
+            case (int)'c':
+                prescan_super_t(eml_string, length, &position, &members);
+                break;
+            case (int)'\"':
+                prescan_single_t(eml_string, length, &position);
+                break;
+            case (int)';':
+                ++position;
+                continue;
+            default:
+                current_postition = position;
+                error = unexpected_error;
+                goto bail;
+        }
+
+        if ((error = lazy_add(*lazy, begin, position))) {
+            goto bail;
+        }
+    }
+
+    (*lazy)->results = calloc((*lazy)->count ? (*lazy)->count : 1, sizeof(eml_result *));
+    if ((*lazy)->results == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    current_postition = length;
+    return no_error;
+
+    bail:
+        eml_lazy_free(*lazy);
+        *lazy = NULL;
+        return error;
+}
+
+/*
+ * eml_lazy_header: Returns the document's header list (NULL without one).
+ */
+eml_header_t *eml_lazy_header(eml_lazy *lazy) {
+    return lazy->head->header;
+}
+
+/*
+ * eml_lazy_count: Returns the number of top level objects.
+ */
+uint32_t eml_lazy_count(eml_lazy *lazy) {
+    return lazy->count;
+}
+
+/*
+ * eml_lazy_at: Returns what was recorded of top level object `i`, or NULL past the last.
+ */
+const eml_lazy_entry *eml_lazy_at(eml_lazy *lazy, uint32_t i) {
+    return i < lazy->count ? &lazy->entries[i] : NULL;
+}
+
+/*
+ * eml_lazy_object: Sets `obj` to top level object `i`, parsing it (by parse_exact() on its extent) if it has not been
+ *                  already. It belongs to `lazy`. On a parse error parse_error_offset() is that in the document.
+ */
+int eml_lazy_object(eml_lazy *lazy, uint32_t i, eml_obj **obj) {
+    if (i >= lazy->count) {
+        return out_of_range_error;
+    }
+
+    if (lazy->results[i] == NULL) {
+        eml_lazy_entry *e = &lazy->entries[i];
+        eml_result *result;
+
+        int error = parse_exact(lazy->document + e->begin, e->end - e->begin, &result);
+        current_postition += e->begin;
+
+        if (error) {
+            return error;
+        }
+
+        // The extent holds one object, as walked by the parser
+        if (result->count != 1) {
+            free_result(result);
+            current_postition = e->begin;
+            return unexpected_error;
+        }
+
+        lazy->results[i] = result;
+    }
+
+    *obj = &lazy->results[i]->objs[0];
+    return no_error;
+}
+
+/*
+ * eml_lazy_find: Finds the first top level object from `from` on that is, or has as a member, a single named `name`,
+ *                setting `i` to it. Names are compared in the document; nothing is parsed.
+ */
+bool eml_lazy_find(eml_lazy *lazy, const char *name, uint32_t from, uint32_t *i) {
+    uint32_t length = strlen(name);
+
+    for (uint32_t k = from; k < lazy->count; k++) {
+        if (lazy_has_name(lazy, &lazy->entries[k], name, length)) {
+            *i = k;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * eml_lazy_free: Frees `lazy` & every object parsed from it.
+ */
+void eml_lazy_free(eml_lazy *lazy) {
+    if (lazy == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < lazy->count && lazy->results != NULL; i++) {
+        free_result(lazy->results[i]);
+    }
+
+    free_result(lazy->head);
+    free(lazy->results);
+    free(lazy->entries);
+    free(lazy);
+}
+
+/*
+ * aggregates_entry: Sets `entry` to the aggregate of (name, side), adding an empty one if it is new.
+ */
+static int aggregates_entry(eml_aggregates *a, const char *name, uint32_t side, eml_aggregate **entry) {
+    int error = no_error;
+    uint32_t id;
+
+    // Keys cover every id the name table has room for before a name is interned, so no id is left without its keys
+    if ((error = name_table_reserve(&a->names, 1))) {
+        return error;
+    }
+
+    if ((uint64_t)a->names.capacity * 3 > a->key_capacity) {
+        uint32_t capacity = a->names.capacity * 3;
+        uint32_t *keys = realloc(a->keys, sizeof(uint32_t) * capacity);
+        if (keys == NULL) {
+            return allocation_error;
+        }
+
+        memset(keys + a->key_capacity, 0, sizeof(uint32_t) * (capacity - a->key_capacity));
+        a->keys = keys;
+        a->key_capacity = capacity;
+    }
+
+    if ((error = name_table_intern(&a->names, name, &id))) {
+        return error;
+    }
+
+    uint32_t *key = &a->keys[id * 3 + side];
+    if (*key == 0) {
+        if (a->count == a->capacity) {
+            uint32_t capacity = a->capacity ? a->capacity * 2 : 64;
+            eml_aggregate *entries = realloc(a->entries, sizeof(eml_aggregate) * capacity);
+            if (entries == NULL) {
+                return allocation_error;
+            }
+
+            a->entries = entries;
+            a->capacity = capacity;
+        }
+
+        eml_aggregate *e = &a->entries[a->count];
+        memset(e, 0, sizeof(eml_aggregate));
+        e->name = a->names.names[id];
+        e->side = side;
+        e->last = INT64_MIN;
+        *key = ++a->count;
+    }
+
+    *entry = &a->entries[*key - 1];
+    return no_error;
+}
+
+/*
+ * aggregate_best: Raises the best weight at `reps` reps to `weight`, adding the rep count if it is new.
+ */
+static int aggregate_best(eml_aggregate *e, uint32_t reps, uint32_t weight) {
+    uint32_t lo = 0;
+    uint32_t hi = e->best_count;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (e->bests[mid].reps < reps) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo < e->best_count && e->bests[lo].reps == reps) {
+        if (weight > e->bests[lo].weight) {
+            e->bests[lo].weight = weight;
+        }
+        return no_error;
+    }
+
+    // New rep counts are rare after an exercise's first sessions, so the array grows one at a time
+    eml_aggregate_best *bests = realloc(e->bests, sizeof(eml_aggregate_best) * (e->best_count + 1));
+    if (bests == NULL) {
+        return allocation_error;
+    }
+
+    memmove(bests + lo + 1, bests + lo, sizeof(eml_aggregate_best) * (e->best_count - lo));
+    bests[lo].reps = reps;
+    bests[lo].weight = weight;
+    e->bests = bests;
+    e->best_count++;
+    return no_error;
+}
+
+/*
+ * aggregate_reps: Adds `sets` sets of the reps `r` to an aggregate. Weights count as rollup_reps() counts them.
+ */
+static int aggregate_reps(eml_aggregate *e, uint32_t sets, eml_reps *r) {
+    uint64_t reps = eml_number_hundredths(r->value) / 100;
+
+    e->sets += sets;
+
+    switch (r->type) {
+        case unmodified:
+        case unmodifiedFailure:
+        case rpe:
+            e->reps += sets * reps;
+            return no_error;
+        case weight:
+        case weightFailure:
+            break;
+        default: // Timed
+            return no_error;
+    }
+
+    uint64_t w = eml_number_hundredths(r->modifier.weight);
+
+    e->reps += sets * reps;
+    e->tonnage += sets * reps * w;
+
+    if (reps == 0) {
+        return no_error;
+    }
+
+    return aggregate_best(e, reps > UINT32_MAX ? UINT32_MAX : reps, w > UINT32_MAX ? UINT32_MAX : w);
+}
+
+/*
+ * aggregate_single_t: Adds the work of `s` to its aggregates, each side of asymmetric work separately.
+ */
+static int aggregate_single_t(eml_aggregates *a, eml_single_t *s, int64_t timestamp) {
+    int error = no_error;
+
+    for (bool side = left; side <= right; side++) {
+        uint32_t sets, count;
+        uint32_t kind = work_kind(s, side, &sets);
+        eml_reps *reps = work_reps(s, side, &count);
+        eml_aggregate *e;
+
+        if (count == 0) {
+            continue;
+        }
+
+        uint32_t aggregate_side = s->asymmetric_work == NULL ? both_sides : side ? right_side : left_side;
+        if ((error = aggregates_entry(a, s->name, aggregate_side, &e))) {
+            return error;
+        }
+
+        for (uint32_t i = 0; i < count && error == no_error; i++) {
+            error = aggregate_reps(e, kind == frozen_standard ? sets : 1, &reps[i]);
+        }
+
+        if (timestamp > e->last) {
+            e->last = timestamp;
+        }
+    }
+
+    return error;
+}
+
+/*
+ * aggregates_decode: Adds the aggregates of an aggregates file payload (see eml_aggregates_save()).
+ */
+static int aggregates_decode(eml_aggregates *a, const uint8_t *p, const uint8_t *end) {
+    uint64_t count, length, last;
+    char name[MAX_NAME_LENGTH + 1];
+    int error = no_error;
+
+    if (!read_varint(&p, end, &count)) {
+        return aggregate_format_error;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint32_t side, best_count, reps = 0;
+        eml_aggregate *e;
+
+        if (!read_varint(&p, end, &length) || length > MAX_NAME_LENGTH || length > (uint64_t)(end - p)
+            || memchr(p, '\0', length) != NULL) {
+            return aggregate_format_error;
+        }
+
+        memcpy(name, p, length);
+        name[length] = '\0';
+        p += length;
+
+        if (!read_varint32(&p, end, &side) || side > right_side) {
+            return aggregate_format_error;
+        }
+
+        // Each exercise side is saved once
+        uint32_t before = a->count;
+        if ((error = aggregates_entry(a, name, side, &e))) {
+            return error;
+        }
+
+        if (a->count == before) {
+            return aggregate_format_error;
+        }
+
+        if (!read_varint(&p, end, &e->sets) || !read_varint(&p, end, &e->reps) || !read_varint(&p, end, &e->tonnage)
+            || !read_varint(&p, end, &last) || !read_varint32(&p, end, &best_count)) {
+            return aggregate_format_error;
+        }
+
+        e->last = (int64_t)(last >> 1) ^ -(int64_t)(last & 1);
+
+        // Bests are saved in rep order, each rep count as the difference from the last
+        for (uint32_t j = 0; j < best_count; j++) {
+            uint32_t delta, weight;
+
+            if (!read_varint32(&p, end, &delta) || !read_varint32(&p, end, &weight) || (j > 0 && delta == 0)
+                || delta > UINT32_MAX - reps) {
+                return aggregate_format_error;
+            }
+
+            reps += delta;
+            if ((error = aggregate_best(e, reps, weight))) {
+                return error;
+            }
+        }
+    }
+
+    return p == end ? no_error : aggregate_format_error;
+}
+
+/*
+ * eml_aggregates_create: Creates empty aggregates. Free them with eml_aggregates_free().
+ */
+int eml_aggregates_create(eml_aggregates **aggregates) {
+    *aggregates = calloc(1, sizeof(eml_aggregates));
+    return *aggregates == NULL ? allocation_error : no_error;
+}
+
+/*
+ * eml_aggregates_add: Adds a session to the aggregates of the exercises it has work for, in time linear in its size.
+ *                     Sessions may be added in any order. On an allocation error the session may be partly added.
+ *                     Pointers from eml_aggregates_at() & eml_aggregates_find() do not survive it.
+ */
+int eml_aggregates_add(eml_aggregates *aggregates, eml_session *session) {
+    eml_result *result = session->result;
+    int error = no_error;
+
+    for (uint32_t i = 0; i < result->count && error == no_error; i++) {
+        eml_obj *o = &result->objs[i];
+
+        if (o->type == single) {
+            error = aggregate_single_t(aggregates, &o->data.single, session->timestamp);
+        } else {
+            for (uint32_t j = 0; j < o->data.super.count && error == no_error; j++) {
+                error = aggregate_single_t(aggregates, &o->data.super.members[j], session->timestamp);
+            }
+        }
+    }
+
+    return error;
+}
+
+/*
+ * eml_aggregates_count: Returns the number of exercise sides with aggregates.
+ */
+uint32_t eml_aggregates_count(eml_aggregates *aggregates) {
+    return aggregates->count;
+}
+
+/*
+ * eml_aggregates_at: Returns aggregate `i`, in the order exercise sides were first seen, or NULL past the last.
+ */
+const eml_aggregate *eml_aggregates_at(eml_aggregates *aggregates, uint32_t i) {
+    return i < aggregates->count ? &aggregates->entries[i] : NULL;
+}
+
+/*
+ * eml_aggregates_find: Returns the aggregate of (name, side), or NULL if no session had work for it.
+ */
+const eml_aggregate *eml_aggregates_find(eml_aggregates *aggregates, const char *name, eml_rollup_side side) {
+    uint32_t id;
+
+    if (side > right_side || !name_table_find(&aggregates->names, name, &id) || aggregates->keys[id * 3 + side] == 0) {
+        return NULL;
+    }
+
+    return &aggregates->entries[aggregates->keys[id * 3 + side] - 1];
+}
+
+/*
+ * eml_aggregates_save: Writes the aggregates to `path`: a header of magic, format version, payload length & CRC-32,
+ *                      then each aggregate as varints. The file is written beside `path` & renamed over it, so a
+ *                      crash leaves the last snapshot whole.
+ */
+int eml_aggregates_save(eml_aggregates *aggregates, const char *path) {
+    byte_buffer b = {NULL, 0, 0};
+    char *temporary = malloc(strlen(path) + 5);
+    FILE *file = NULL;
+    int error = no_error;
+
+    if (temporary == NULL || (error = buffer_reserve(&b, AGGREGATE_HEADER_LENGTH))) {
+        error = error ? error : allocation_error;
+        goto bail;
+    }
+
+    b.length = AGGREGATE_HEADER_LENGTH;
+    if ((error = buffer_varint(&b, aggregates->count))) {
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < aggregates->count; i++) {
+        eml_aggregate *e = &aggregates->entries[i];
+        uint64_t length = strlen(e->name);
+        uint64_t last = ((uint64_t)e->last << 1) ^ (uint64_t)(e->last >> 63);
+
+        if ((error = buffer_varint(&b, length)) || (error = buffer_bytes(&b, e->name, length))
+            || (error = buffer_varint(&b, e->side)) || (error = buffer_varint(&b, e->sets))
+            || (error = buffer_varint(&b, e->reps)) || (error = buffer_varint(&b, e->tonnage))
+            || (error = buffer_varint(&b, last)) || (error = buffer_varint(&b, e->best_count))) {
+            goto bail;
+        }
+
+        for (uint32_t j = 0; j < e->best_count; j++) {
+            if ((error = buffer_varint(&b, e->bests[j].reps - (j ? e->bests[j - 1].reps : 0)))
+                || (error = buffer_varint(&b, e->bests[j].weight))) {
+                goto bail;
+            }
+        }
+    }
+
+    uint64_t payload = b.length - AGGREGATE_HEADER_LENGTH;
+    if (payload > UINT32_MAX) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    uint32_t header[4] = {EML_AGGREGATE_MAGIC, 1, payload, crc32(b.data + AGGREGATE_HEADER_LENGTH, payload)};
+    memcpy(b.data, header, AGGREGATE_HEADER_LENGTH);
+
+    strcpy(temporary, path);
+    strcat(temporary, ".tmp");
+
+    file = fopen(temporary, "wb");
+    if (file == NULL) {
+        error = io_error;
+        goto bail;
+    }
+
+    bool written = fwrite(b.data, 1, b.length, file) == b.length && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written || rename(temporary, path) != 0) {
+        remove(temporary);
+        error = io_error;
+        goto bail;
+    }
+
+    // The rename is only durable once the directory holding both names is
+    error = sync_directory(path);
+
+    bail:
+        free(temporary);
+        free(b.data);
+        return error;
+}
+
+/*
+ * eml_aggregates_load: Reads aggregates written by eml_aggregates_save(), to be added to as if never saved. Free them
+ *                      with eml_aggregates_free(). On an error `aggregates` is NULL.
+ */
+int eml_aggregates_load(const char *path, eml_aggregates **aggregates) {
+    const char *base;
+    uint64_t size;
+    uint32_t header[4];
+    int error = no_error;
+
+    *aggregates = NULL;
+    if ((error = map_file(path, AGGREGATE_HEADER_LENGTH, aggregate_format_error, &base, &size))) {
+        return error;
+    }
+
+    memcpy(header, base, AGGREGATE_HEADER_LENGTH);
+    const uint8_t *payload = (const uint8_t *)base + AGGREGATE_HEADER_LENGTH;
+
+    if (header[0] != EML_AGGREGATE_MAGIC || header[1] != 1 || header[2] != size - AGGREGATE_HEADER_LENGTH
+        || crc32(payload, header[2]) != header[3]) {
+        error = aggregate_format_error;
+        goto bail;
+    }
+
+    if ((error = eml_aggregates_create(aggregates))) {
+        goto bail;
+    }
+
+    if ((error = aggregates_decode(*aggregates, payload, payload + header[2]))) {
+        eml_aggregates_free(*aggregates);
+        *aggregates = NULL;
+    }
+
+    bail:
+        munmap((void *)base, size);
+        return error;
+}
+
+/*
+ * eml_aggregates_free: Frees eml_aggregates.
+ */
+void eml_aggregates_free(eml_aggregates *aggregates) {
+    if (aggregates == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < aggregates->count; i++) {
+        free(aggregates->entries[i].bests);
+    }
+
+    name_table_free(&aggregates->names);
+    free(aggregates->entries);
+    free(aggregates->keys);
+    free(aggregates);
+}
+
+/*
+ * eml_number_hundredths: Returns an eml_number in hundredths.
+ */
+uint32_t eml_number_hundredths(eml_number e) {
+    return (e & eml_number_H) ? (e & eml_number_mask) : e * 100U;
+}
+
+/*
+ * eml_number_normalize: Returns the scaled form of an eml_number (H set, in hundredths), so equal values have equal
+ *                       bits: 120 & 120.00 both normalize to eml_number_H | 12000. Every integer eml_number fits.
+ */
+eml_number eml_number_normalize(eml_number e) {
+    return eml_number_hundredths(e) | eml_number_H;
+}
+
+/*
+ * eml_number_compare: Returns <0, 0 or >0 as `a` is less than, equal to or greater than `b`, whatever their forms.
+ */
+int eml_number_compare(eml_number a, eml_number b) {
+    uint32_t x = eml_number_hundredths(a), y = eml_number_hundredths(b);
+    return (x > y) - (x < y);
+}
+
+/*
+ * eml_number_add: Stores the normalized `a` + `b` in `sum`. fp_overflow_error if it exceeds the eml_number range.
+ */
+int eml_number_add(eml_number a, eml_number b, eml_number *sum) {
+    uint64_t hundredths = (uint64_t)eml_number_hundredths(a) + eml_number_hundredths(b);
+    if (hundredths > eml_number_mask) {
+        return fp_overflow_error;
+    }
+
+    *sum = (uint32_t)hundredths | eml_number_H;
+    return no_error;
+}
+
+/*
+ * eml_number_multiply: Stores the normalized `a` * `b`, rounded half up to hundredths, in `product`.
+ *                      fp_overflow_error if it exceeds the eml_number range.
+ */
+int eml_number_multiply(eml_number a, eml_number b, eml_number *product) {
+    uint64_t hundredths = ((uint64_t)eml_number_hundredths(a) * eml_number_hundredths(b) + 50) / 100;
+    if (hundredths > eml_number_mask) {
+        return fp_overflow_error;
+    }
+
+    *product = (uint32_t)hundredths | eml_number_H;
+    return no_error;
+}
+
+/*
+ * eml_number_to_double: Returns the value of an eml_number.
+ */
+double eml_number_to_double(eml_number e) {
+    return eml_number_hundredths(e) / 100.0;
+}
+
+/*
+ * eml_number_from_double: Stores `d` rounded half up to hundredths (as d * 100 computes in double) in `e`, normalized.
+ *                         out_of_range_error for NaN, negatives & values past the eml_number range.
+ */
+int eml_number_from_double(double d, eml_number *e) {
+    double hundredths = d * 100.0 + 0.5;
+
+    // Written so NaN fails too
+    if (!(d >= 0.0 && hundredths < (double)eml_number_mask + 1.0)) {
+        return out_of_range_error;
+    }
+
+    *e = (uint32_t)hundredths | eml_number_H;
+    return no_error;
+}
+
+/*
+ * eml_number_normalize_batch: Normalizes `count` values into `normalized` (which may be `values`).
+ *                             The batch kernels are branch free so compilers vectorize them.
+ */
+void eml_number_normalize_batch(const eml_number *values, eml_number *normalized, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t fractional = values[i] >> 31;
+        normalized[i] = (values[i] & eml_number_mask) * (100 - 99 * fractional) | eml_number_H;
+    }
+}
+
+/*
+ * eml_number_add_batch: Stores the normalized a[i] + b[i] in sums[i]. fp_overflow_error if any sum overflowed (its
+ *                       value is then unspecified).
+ */
+int eml_number_add_batch(const eml_number *a, const eml_number *b, eml_number *sums, uint32_t count) {
+    uint32_t overflow = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t x = (a[i] & eml_number_mask) * (100 - 99 * (a[i] >> 31));
+        uint32_t y = (b[i] & eml_number_mask) * (100 - 99 * (b[i] >> 31));
+        uint32_t sum = x + y; // Both are < 2^31, so this cannot wrap
+
+        overflow |= sum >> 31;
+        sums[i] = sum | eml_number_H;
+    }
+
+    return overflow ? fp_overflow_error : no_error;
+}
+
+/*
+ * eml_number_multiply_batch: Stores the normalized a[i] * b[i], rounded half up, in products[i]. fp_overflow_error if
+ *                            any product overflowed (its value is then unspecified).
+ */
+int eml_number_multiply_batch(const eml_number *a, const eml_number *b, eml_number *products, uint32_t count) {
+    uint32_t overflow = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t x = (a[i] & eml_number_mask) * (uint64_t)(100 - 99 * (a[i] >> 31));
+        uint64_t y = (b[i] & eml_number_mask) * (uint64_t)(100 - 99 * (b[i] >> 31));
+        uint64_t product = (x * y + 50) / 100;
+
+        overflow |= product > eml_number_mask;
+        products[i] = (uint32_t)product | eml_number_H;
+    }
+
+    return overflow ? fp_overflow_error : no_error;
+}
+
+/*
+ * eml_number_compare_batch: Stores the eml_number_compare() of a[i] & b[i] (-1, 0 or 1) in order[i].
+ */
+void eml_number_compare_batch(const eml_number *a, const eml_number *b, int32_t *order, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t x = (a[i] & eml_number_mask) * (100 - 99 * (a[i] >> 31));
+        uint32_t y = (b[i] & eml_number_mask) * (100 - 99 * (b[i] >> 31));
+        order[i] = (int32_t)(x > y) - (int32_t)(x < y);
+    }
+}
+
+/*
+ * eml_number_sum_batch: Returns the sum of `count` values in hundredths, which cannot overflow 64 bits.
+ */
+uint64_t eml_number_sum_batch(const eml_number *values, uint32_t count) {
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        sum += (values[i] & eml_number_mask) * (uint64_t)(100 - 99 * (values[i] >> 31));
+    }
+
+    return sum;
+}
+/*
+ * range_contains: Whether `v` lies in the inclusive range `r`.
+ */
+static bool range_contains(eml_range *r, uint32_t v) {
+    return v >= r->min && v <= r->max;
+}
+
+/*
+ * eml_query_init: Resets a query to match every single.
+ */
+void eml_query_init(eml_query *query) {
+    query->name = NULL;
+    query->name_mode = any_name;
+    query->sides = any_sides;
+    query->objtypes = 0;
+    query->kinds = 0;
+    query->reps_types = 0;
+    query->sets.min = query->reps.min = query->modifier.min = 0;
+    query->sets.max = query->reps.max = query->modifier.max = UINT32_MAX;
+    query->modifier_kind = any_modifier;
+    query->unit = NULL;
+}
+
+/*
+ * eml_query_compile: Validates `query` & prepares it for eml_query_run. The query's name must outlive `compiled`.
+ */
+int eml_query_compile(eml_query *query, eml_compiled_query *compiled) {
+    if (query->name_mode > prefix_name || query->sides > asymmetric_sides || query->modifier_kind > rpe_modifier) {
+        return bad_query_error;
+    }
+
+    if (query->unit != NULL && strcmp(query->unit, "kg") != 0 && strcmp(query->unit, "lbs") != 0) {
+        return unknown_weight_unit_error;
+    }
+
+    if (query->name_mode != any_name && query->name == NULL) {
+        return bad_query_error;
+    }
+
+    if (query->sets.min > query->sets.max || query->reps.min > query->reps.max || query->modifier.min > query->modifier.max) {
+        return bad_query_error;
+    }
+
+    compiled->query = *query;
+    compiled->name_length = query->name_mode == any_name ? 0 : strlen(query->name);
+
+    // Rep-level predicates need a matching rep, otherwise the side's work alone decides
+    compiled->match_modifier = query->modifier_kind != any_modifier
+        || query->modifier.min != 0 || query->modifier.max != UINT32_MAX;
+    compiled->match_reps = compiled->match_modifier || query->reps_types != 0
+        || query->reps.min != 0 || query->reps.max != UINT32_MAX;
+
+    // Only weights a modifier range reads are converted
+    compiled->convert_weights = query->unit != NULL && compiled->match_modifier && query->modifier_kind != rpe_modifier;
+    compiled->to_kg = query->unit != NULL && strcmp(query->unit, "kg") == 0;
+
+    return no_error;
+}
+
+/*
+ * query_weight: Returns a weight in hundredths, converted as query_convert() decided (0 as written, 1 lbs to kg,
+ *               2 kg to lbs) & rounded half up as eml_convert_weight() rounds.
+ */
+static uint64_t query_weight(eml_number w, uint32_t convert) {
+    uint64_t hundredths = eml_number_hundredths(w);
+
+    switch (convert) {
+        case 1:
+            return (hundredths * KG_PER_LBS_NUMERATOR + KG_PER_LBS_DENOMINATOR / 2) / KG_PER_LBS_DENOMINATOR;
+        case 2:
+            return (hundredths * KG_PER_LBS_DENOMINATOR + KG_PER_LBS_NUMERATOR / 2) / KG_PER_LBS_NUMERATOR;
+        default:
+            return hundredths;
+    }
+}
+
+/*
+ * query_convert: Returns how the weights of `result` are converted to the query's unit (see query_weight()), or
+ *                UINT32_MAX if its unit is missing or unknown.
+ */
+static uint32_t query_convert(eml_compiled_query *q, eml_result *result) {
+    if (!q->convert_weights) {
+        return 0;
+    }
+
+    eml_header_t *h = find_header_t(result, "weight");
+    if (h == NULL) {
+        return UINT32_MAX;
+    }
+
+    if (strcmp(h->value, "kg") == 0) {
+        return q->to_kg ? 0 : 2;
+    }
+
+    if (strcmp(h->value, "lbs") == 0) {
+        return q->to_kg ? 1 : 0;
+    }
+
+    return UINT32_MAX;
+}
+
+/*
+ * query_side: Whether one side of `s` satisfies the work & rep predicates.
+ */
+static bool query_side(eml_compiled_query *q, eml_single_t *s, bool side, uint32_t convert) {
+    uint32_t sets, count;
+    uint32_t kind = work_kind(s, side, &sets);
+
+    if (kind == frozen_absent) {
+        return false;
+    }
+
+    if ((q->query.kinds && !(q->query.kinds & (1U << kind))) || !range_contains(&q->query.sets, sets)) {
+        return false;
+    }
+
+    if (!q->match_reps) {
+        return true;
+    }
+
+    eml_reps *reps = work_reps(s, side, &count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (q->query.reps_types && !(q->query.reps_types & (1U << reps[i].type))) {
+            continue;
+        }
+
+        if (!range_contains(&q->query.reps, eml_number_hundredths(reps[i].value))) {
+            continue;
+        }
+
+        if (q->match_modifier) {
+            bool weighted = reps_has_weight(&reps[i]);
+
+            if (!reps_has_modifier(&reps[i]) || (q->query.modifier_kind == weight_modifier && !weighted)
+                || (q->query.modifier_kind == rpe_modifier && weighted)) {
+                continue;
+            }
+
+            uint64_t m = weighted ? query_weight(reps[i].modifier.weight, convert) : eml_number_hundredths(reps[i].modifier.rpe);
+            if (m < q->query.modifier.min || m > q->query.modifier.max) {
+                continue;
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * query_batch: Filters a batch of candidates one predicate at a time, compacting survivors in place, then copies
+ *              them to `matches` while there is room. Returns the number of survivors.
+ */
+static uint32_t query_batch(eml_compiled_query *q, eml_query_match *batch, uint32_t n, uint32_t convert, eml_query_match *matches, uint32_t capacity, uint32_t *found) {
+    uint32_t kept;
+
+    if (q->query.name_mode != any_name) {
+        kept = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            char *name = batch[i].single->name;
+            bool match = q->query.name_mode == exact_name
+                ? strcmp(name, q->query.name) == 0
+                : strncmp(name, q->query.name, q->name_length) == 0;
+
+            if (match) {
+                batch[kept++] = batch[i];
+            }
+        }
+        n = kept;
+    }
+
+    if (q->query.sides != any_sides) {
+        kept = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            bool asymmetric = batch[i].single->asymmetric_work != NULL;
+
+            if (asymmetric == (q->query.sides == asymmetric_sides)) {
+                batch[kept++] = batch[i];
+            }
+        }
+        n = kept;
+    }
+
+    kept = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (query_side(q, batch[i].single, left, convert) || query_side(q, batch[i].single, right, convert)) {
+            batch[kept++] = batch[i];
+        }
+    }
+    n = kept;
+
+    for (uint32_t i = 0; i < n; i++, (*found)++) {
+        if (*found < capacity) {
+            matches[*found] = batch[i];
+        }
+    }
+
+    return n;
+}
+
+/*
+ * eml_query_run: Writes up to `capacity` matching singles of `results` to `matches` in document order & sets `found`
+ *                to the total number of matches, which may exceed `capacity`. Nothing is allocated. With a query unit
+ *                every result's weight unit must be "lbs" or "kg", which is checked before anything is matched.
+ */
+int eml_query_run(eml_compiled_query *compiled, eml_result **results, uint32_t count, eml_query_match *matches, uint32_t capacity, uint32_t *found) {
+    eml_query_match batch[QUERY_BATCH_SIZE];
+    uint32_t n = 0;
+    uint32_t convert = 0;
+
+    *found = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (query_convert(compiled, results[i]) == UINT32_MAX) {
+            return unknown_weight_unit_error;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        // A batch holds candidates of results with the same conversion
+        uint32_t next = query_convert(compiled, results[i]);
+        if (next != convert) {
+            query_batch(compiled, batch, n, convert, matches, capacity, found);
+            n = 0;
+            convert = next;
+        }
+
+        for (uint32_t j = 0; j < results[i]->count; j++) {
+            eml_obj *o = &results[i]->objs[j];
+            uint32_t members = o->type == single ? 1 : o->data.super.count;
+
+            if (compiled->query.objtypes && !(compiled->query.objtypes & (1U << o->type))) {
+                continue;
+            }
+
+            for (uint32_t k = 0; k < members; k++) {
+                batch[n].result = i;
+                batch[n].obj = j;
+                batch[n].member = k;
+                batch[n].single = o->type == single ? &o->data.single : &o->data.super.members[k];
+
+                if (++n == QUERY_BATCH_SIZE) {
+                    query_batch(compiled, batch, n, convert, matches, capacity, found);
+                    n = 0;
+                }
+            }
+        }
+    }
+
+    query_batch(compiled, batch, n, convert, matches, capacity, found);
+    return no_error;
+}
+
+/*
+ * name_table_reserve: Grows the table (doubling, as often as needed) so `extra` more names can be added without
+ *                     growing it again.
+ */
+static int name_table_reserve(name_table *t, uint32_t extra) {
+    // Keep the load factor at or under 1/2
+    uint64_t needed = ((uint64_t)t->count + extra) * 2;
+    if (needed <= t->capacity) {
+        return no_error;
+    }
+
+    uint64_t capacity = t->capacity ? t->capacity : 64;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+
+    if (capacity > 0x80000000U) {
+        return allocation_error;
+    }
+
+    uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+    char **names = realloc(t->names, sizeof(char *) * (capacity / 2));
+    if (slots == NULL || names == NULL) {
+        free(slots);
+        if (names != NULL) {
+            t->names = names;
+        }
+        return allocation_error;
+    }
+
+    for (uint32_t i = 0; i < t->count; i++) {
+        uint32_t slot = hash_string(FNV_OFFSET_BASIS, names[i]) & (capacity - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = i + 1;
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->names = names;
+    t->capacity = capacity;
+    return no_error;
+}
+
+/*
+ * name_table_intern: Sets `id` to the id of `name`, copying & adding it to the table if it is new.
+ */
+static int name_table_intern(name_table *t, const char *name, uint32_t *id) {
+    int error = no_error;
+
+    if ((error = name_table_reserve(t, 1))) {
+        return error;
+    }
+
+    uint32_t slot = hash_string(FNV_OFFSET_BASIS, name) & (t->capacity - 1);
+    while (t->slots[slot] != 0) {
+        if (strcmp(t->names[t->slots[slot] - 1], name) == 0) {
+            *id = t->slots[slot] - 1;
+            return no_error;
+        }
+        slot = (slot + 1) & (t->capacity - 1);
+    }
+
+    t->names[t->count] = malloc(strlen(name) + 1);
+    if (t->names[t->count] == NULL) {
+        return allocation_error;
+    }
+    strcpy(t->names[t->count], name);
+
+    *id = t->count++;
+    t->slots[slot] = *id + 1;
+    return no_error;
+}
+
+/*
+ * name_table_adopt: Adds `name`, which must not be in the table, taking ownership of it (no copy). Cannot fail once
+ *                   name_table_reserve() made room for it.
+ */
+static void name_table_adopt(name_table *t, char *name) {
+    uint32_t slot = hash_string(FNV_OFFSET_BASIS, name) & (t->capacity - 1);
+    while (t->slots[slot] != 0) {
+        slot = (slot + 1) & (t->capacity - 1);
+    }
+
+    t->names[t->count] = name;
+    t->slots[slot] = ++t->count;
+}
+
+/*
+ * name_table_free: Frees the names & slots of a name_table, but not the name_table itself.
+ */
+static void name_table_free(name_table *t) {
+    for (uint32_t i = 0; i < t->count; i++) {
+        free(t->names[i]);
+    }
+
+    free(t->names);
+    free(t->slots);
+}
+
+/*
+ * write_varint: Writes `v` as a LEB128 varint to `buf` (at most 10 bytes) & returns its length.
+ */
+static uint32_t write_varint(uint8_t *buf, uint64_t v) {
+    uint32_t length = 0;
+
+    while (v >= 0x80) {
+        buf[length++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    buf[length++] = v;
+
+    return length;
+}
+
+/*
+ * read_varint: Reads a LEB128 varint at *p, advancing it. Returns false if the varint runs past `end`.
+ */
+static bool read_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+    uint64_t result = 0;
+
+    for (uint32_t shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * compare_index_order: qsort comparator ordering index_order by name.
+ */
+static int compare_index_order(const void *a, const void *b) {
+    return strcmp(((index_order *)a)->name, ((index_order *)b)->name);
+}
+
+/*
+ * collect_index_entries: Appends a posting for every single & super/circuit member of `result` to `entries`.
+ */
+static int collect_index_entries(eml_result *result, uint32_t doc, name_table *names, index_entry **entries, uint64_t *count, uint64_t *capacity) {
+    int error = no_error;
+
+    for (uint32_t i = 0; i < result->count; i++) {
+        eml_obj *o = &result->objs[i];
+        uint32_t members = o->type == single ? 1 : o->data.super.count;
+
+        for (uint32_t j = 0; j < members; j++) {
+            eml_single_t *s = o->type == single ? &o->data.single : &o->data.super.members[j];
+
+            if (*count == *capacity) {
+                uint64_t grown = *capacity ? *capacity * 2 : 256;
+                index_entry *e = realloc(*entries, sizeof(index_entry) * grown);
+                if (e == NULL) {
+                    return allocation_error;
+                }
+
+                *entries = e;
+                *capacity = grown;
+            }
+
+            index_entry *e = &(*entries)[(*count)++];
+            if ((error = name_table_intern(names, s->name, &e->term))) {
+                return error;
+            }
+
+            e->doc = doc;
+            e->obj = i;
+            e->flags = (o->type == super ? posting_super : 0)
+                | (o->type == circuit ? posting_circuit : 0)
+                | (s->asymmetric_work != NULL ? posting_asymmetric : 0);
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * write_index: Sorts `entries` by term name (stable, so each term stays in (doc, obj) order), encodes the postings
+ *              & writes the index file to `path`. Postings for the same (doc, obj) are merged.
+ */
+static int write_index(const char *path, name_table *names, index_entry *entries, uint64_t count) {
+    int error = no_error;
+    FILE *file = NULL;
+    index_order *order = NULL;
+    uint32_t *rank = NULL;
+    uint64_t *start = calloc(names->count + 1, sizeof(uint64_t)); // One past the last rank, for the prefix sums
+    index_entry *sorted = NULL;
+    eml_index_term *terms = NULL;
+    uint8_t *postings = NULL;
+
+    if (start == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    // Documents without exercises have no terms (& so no postings): their index is the header alone
+    if (names->count > 0) {
+        order = malloc(sizeof(index_order) * names->count);
+        rank = malloc(sizeof(uint32_t) * names->count);
+        sorted = malloc(sizeof(index_entry) * count);
+        terms = calloc(names->count, sizeof(eml_index_term));
+        postings = malloc(count * 3 * 10); // 3 varints of at most 10 bytes per posting
+
+        if (order == NULL || rank == NULL || sorted == NULL || terms == NULL || postings == NULL) {
+            error = allocation_error;
+            goto bail;
+        }
+    }
+
+    for (uint32_t i = 0; i < names->count; i++) {
+        order[i].name = names->names[i];
+        order[i].term = i;
+    }
+    if (names->count > 0) {
+        qsort(order, names->count, sizeof(index_order), compare_index_order);
+    }
+
+    for (uint32_t i = 0; i < names->count; i++) {
+        rank[order[i].term] = i;
+    }
+
+    // Counting sort by rank
+    for (uint64_t i = 0; i < count; i++) {
+        start[rank[entries[i].term] + 1]++;
+    }
+    for (uint32_t i = 0; i < names->count; i++) {
+        start[i + 1] += start[i];
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        sorted[start[rank[entries[i].term]]++] = entries[i];
+    }
+
+    uint64_t names_offset = sizeof(eml_index_file) + sizeof(eml_index_term) * names->count;
+    uint64_t names_length = 0;
+    for (uint32_t i = 0; i < names->count; i++) {
+        terms[i].name = names_offset + names_length;
+        names_length += strlen(order[i].name) + 1;
+    }
+
+    if (names_offset + names_length > UINT32_MAX) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    uint64_t postings_offset = names_offset + names_length;
+    uint64_t length = 0;
+    uint64_t e = 0;
+    for (uint32_t i = 0; i < names->count; i++) {
+        eml_posting last = {0, 0, 0};
+        bool first = true;
+
+        terms[i].postings = postings_offset + length;
+        for (; e < count && rank[sorted[e].term] == i; e++) {
+            eml_posting p = {sorted[e].doc, sorted[e].obj, sorted[e].flags};
+
+            while (e + 1 < count && sorted[e + 1].term == sorted[e].term && sorted[e + 1].doc == p.doc && sorted[e + 1].obj == p.obj) {
+                p.flags |= sorted[++e].flags;
+            }
+
+            bool same_doc = !first && p.doc == last.doc;
+            length += write_varint(postings + length, p.doc - last.doc);
+            length += write_varint(postings + length, same_doc ? p.obj - last.obj : p.obj);
+            length += write_varint(postings + length, p.flags);
+
+            terms[i].count++;
+            last = p;
+            first = false;
+        }
+        terms[i].length = postings_offset + length - terms[i].postings;
+    }
+
+    eml_index_file header = {EML_INDEX_MAGIC, names->count, postings_offset + length};
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        error = io_error;
+        goto bail;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && (names->count == 0 || fwrite(terms, sizeof(eml_index_term), names->count, file) == names->count);
+    for (uint32_t i = 0; written && i < names->count; i++) {
+        written = fwrite(order[i].name, strlen(order[i].name) + 1, 1, file) == 1;
+    }
+    written = written && (length == 0 || fwrite(postings, 1, length, file) == length);
+
+    if (fclose(file) != 0 || !written) {
+        error = io_error;
+    }
+
+    bail:
+        free(order);
+        free(rank);
+        free(start);
+        free(sorted);
+        free(terms);
+        free(postings);
+        return error;
+}
+
+/*
+ * eml_index_build: Parses every document once & writes an index file mapping each exercise name to the
+ *                  (document, object) pairs it occurs in. Documents are numbered by their position in `documents`.
+ */
+int eml_index_build(char **documents, uint32_t count, const char *path) {
+    name_table names = {NULL, NULL, 0, 0};
+    index_entry *entries = NULL;
+    uint64_t entry_count = 0;
+    uint64_t entry_capacity = 0;
+    int error = no_error;
+
+    for (uint32_t i = 0; i < count; i++) {
+        eml_result *result;
+        if ((error = parse(documents[i], &result))) {
+            goto bail;
+        }
+
+        error = collect_index_entries(result, i, &names, &entries, &entry_count, &entry_capacity);
+        free_result(result);
+        if (error) {
+            goto bail;
+        }
+    }
+
+    error = write_index(path, &names, entries, entry_count);
+
+    bail:
+        name_table_free(&names);
+        free(entries);
+        return error;
+}
+
+/*
+ * eml_index_open: Maps an index file read-only & checks its layout. Close with eml_index_close().
+ */
+int eml_index_open(const char *path, eml_index **index) {
+    const char *base;
+    uint64_t size;
+    int error = no_error;
+
+    if ((error = map_file(path, sizeof(eml_index_file), index_format_error, &base, &size))) {
+        return error;
+    }
+
+    const eml_index_file *header = (const eml_index_file *)base;
+    const eml_index_term *terms = (const eml_index_term *)(base + sizeof(eml_index_file));
+
+    bool valid = header->magic == EML_INDEX_MAGIC && header->size == size
+        && (uint64_t)header->term_count * sizeof(eml_index_term) <= size - sizeof(eml_index_file);
+    for (uint32_t i = 0; valid && i < header->term_count; i++) {
+        valid = terms[i].name < size && memchr(base + terms[i].name, '\0', size - terms[i].name) != NULL
+            && terms[i].postings <= size && terms[i].length <= size - terms[i].postings;
+    }
+
+    if (!valid) {
+        munmap((void *)base, size);
+        return index_format_error;
+    }
+
+    *index = malloc(sizeof(eml_index));
+    if (*index == NULL) {
+        munmap((void *)base, size);
+        return allocation_error;
+    }
+
+    (*index)->base = base;
+    (*index)->size = size;
+    (*index)->terms = terms;
+    (*index)->term_count = header->term_count;
+    return no_error;
+}
+
+/*
+ * find_index_term: Binary searches the term table for `name`. Returns NULL if it is not indexed.
+ */
+static const eml_index_term *find_index_term(eml_index *index, const char *name) {
+    uint32_t lo = 0;
+    uint32_t hi = index->term_count;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = strcmp(name, index->base + index->terms[mid].name);
+
+        if (c == 0) {
+            return &index->terms[mid];
+        } else if (c < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * open_postings: Starts decoding the postings list of `term`.
+ */
+static void open_postings(eml_index *index, const eml_index_term *term, postings_cursor *c) {
+    c->p = (const uint8_t *)index->base + term->postings;
+    c->end = c->p + term->length;
+    c->remaining = term->count;
+    c->first = true;
+    c->last.doc = c->last.obj = c->last.flags = 0;
+}
+
+/*
+ * next_posting: Decodes the next posting. Returns false at the end of the list (or if it is corrupt).
+ */
+static bool next_posting(postings_cursor *c, eml_posting *posting) {
+    uint64_t doc, obj, flags;
+
+    if (c->remaining == 0 || !read_varint(&c->p, c->end, &doc) || !read_varint(&c->p, c->end, &obj) || !read_varint(&c->p, c->end, &flags)) {
+        return false;
+    }
+
+    posting->doc = c->last.doc + doc;
+    posting->obj = (!c->first && doc == 0) ? c->last.obj + obj : obj;
+    posting->flags = flags;
+
+    c->remaining--;
+    c->first = false;
+    c->last = *posting;
+    return true;
+}
+
+/*
+ * eml_index_lookup: Writes up to `capacity` postings of `name` in (doc, obj) order to `postings` & sets `found` to
+ *                   the total number of postings, which may exceed `capacity`.
+ */
+int eml_index_lookup(eml_index *index, const char *name, eml_posting *postings, uint32_t capacity, uint32_t *found) {
+    const eml_index_term *term = find_index_term(index, name);
+    postings_cursor c;
+    eml_posting p;
+
+    *found = 0;
+    if (term == NULL) {
+        return no_error;
+    }
+
+    open_postings(index, term, &c);
+    while (next_posting(&c, &p)) {
+        if (*found < capacity) {
+            postings[*found] = p;
+        }
+        (*found)++;
+    }
+
+    return c.remaining == 0 ? no_error : index_format_error;
+}
+
+/*
+ * eml_index_intersect: Writes up to `capacity` ids of the documents containing every one of `names`, in ascending
+ *                      order, to `docs` & sets `found` to the total number of such documents.
+ */
+int eml_index_intersect(eml_index *index, const char **names, uint32_t count, uint32_t *docs, uint32_t capacity, uint32_t *found) {
+    const eml_index_term *smallest = NULL;
+    postings_cursor c;
+    eml_posting p;
+
+    *found = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const eml_index_term *term = find_index_term(index, names[i]);
+        if (term == NULL) {
+            return no_error;
+        }
+
+        if (smallest == NULL || term->count < smallest->count) {
+            smallest = term;
+        }
+    }
+
+    // No names, or a term without postings, match no documents
+    if (smallest == NULL || smallest->count == 0) {
+        return no_error;
+    }
+
+    // Start from the shortest list, then narrow it by merging against every other list
+    uint32_t *candidates = malloc(sizeof(uint32_t) * smallest->count);
+    uint32_t n = 0;
+    if (candidates == NULL) {
+        return allocation_error;
+    }
+
+    open_postings(index, smallest, &c);
+    while (next_posting(&c, &p)) {
+        if (n == 0 || candidates[n - 1] != p.doc) {
+            candidates[n++] = p.doc;
+        }
+    }
+
+    for (uint32_t i = 0; i < count && n > 0; i++) {
+        const eml_index_term *term = find_index_term(index, names[i]);
+        uint32_t kept = 0;
+        uint32_t j = 0;
+
+        if (term == smallest) {
+            continue;
+        }
+
+        open_postings(index, term, &c);
+        while (j < n && next_posting(&c, &p)) {
+            while (j < n && candidates[j] < p.doc) {
+                j++;
+            }
+
+            if (j < n && candidates[j] == p.doc) {
+                candidates[kept++] = candidates[j++];
+            }
+        }
+        n = kept;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (i < capacity) {
+            docs[i] = candidates[i];
+        }
+    }
+    *found = n;
+
+    free(candidates);
+    return no_error;
+}
+
+/*
+ * eml_index_close: Unmaps & frees an eml_index.
+ */
+void eml_index_close(eml_index *index) {
+    if (index == NULL) {
+        return;
+    }
+
+    munmap((void *)index->base, index->size);
+    free(index);
+}
+
+/*
+ * rollup_slot: Returns the slot of (name, side, week) in `t`, or of the empty slot it would be inserted at.
+ */
+static uint32_t rollup_slot(rollup_table *t, uint32_t name, uint32_t side, int64_t week) {
+    uint32_t slot = hash_mix(((uint64_t)name << 2 | side) * 0x9E3779B97F4A7C15ULL ^ (uint64_t)week) & (t->capacity - 1);
+
+    while (t->slots[slot] != 0) {
+        rollup_entry *e = &t->entries[t->slots[slot] - 1];
+        if (e->name == name && e->side == side && e->point.week == week) {
+            break;
+        }
+        slot = (slot + 1) & (t->capacity - 1);
+    }
+
+    return slot;
+}
+
+/*
+ * rollup_table_point: Sets `point` to the point of (name, side, week), adding an empty one if it is new.
+ */
+static int rollup_table_point(rollup_table *t, uint32_t name, uint32_t side, int64_t week, eml_rollup_point **point) {
+    // Keep the load factor at or under 1/2
+    if ((t->count + 1) * 2 > t->capacity) {
+        uint32_t capacity = t->capacity ? t->capacity * 2 : 64;
+        uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+        rollup_entry *entries = realloc(t->entries, sizeof(rollup_entry) * capacity / 2);
+        if (slots == NULL || entries == NULL) {
+            free(slots);
+            if (entries != NULL) {
+                t->entries = entries;
+            }
+            return allocation_error;
+        }
+
+        free(t->slots);
+        t->slots = slots;
+        t->entries = entries;
+        t->capacity = capacity;
+
+        for (uint32_t i = 0; i < t->count; i++) {
+            rollup_entry *e = &t->entries[i];
+            t->slots[rollup_slot(t, e->name, e->side, e->point.week)] = i + 1;
+        }
+    }
+
+    uint32_t slot = rollup_slot(t, name, side, week);
+    if (t->slots[slot] == 0) {
+        rollup_entry *e = &t->entries[t->count];
+
+        memset(e, 0, sizeof(rollup_entry));
+        e->name = name;
+        e->side = side;
+        e->point.week = week;
+        t->slots[slot] = ++t->count;
+    }
+
+    *point = &t->entries[t->slots[slot] - 1].point;
+    return no_error;
+}
+
+/*
+ * rollup_table_free: Frees the names, entries & slots of a rollup_table, but not the rollup_table itself.
+ */
+static void rollup_table_free(rollup_table *t) {
+    name_table_free(&t->names);
+    free(t->entries);
+    free(t->slots);
+}
+
+/*
+ * rollup_reps: Adds `sets` sets of the weighted reps `r` to a point. Other reps, and weighted failure sets
+ *              without a rep count, do not contribute.
+ */
+static void rollup_reps(eml_rollup_point *p, uint32_t sets, eml_reps *r) {
+    if (r->type != weight && r->type != weightFailure) {
+        return;
+    }
+
+    uint64_t w = eml_number_hundredths(r->modifier.weight);
+    uint64_t reps = eml_number_hundredths(r->value) / 100;
+    if (reps == 0) {
+        return;
+    }
+
+    uint64_t epley = reps == 1 ? w : (w * (30 + reps) + 15) / 30;
+    uint64_t brzycki = reps == 1 ? w : reps < 37 ? (w * 36 + (37 - reps) / 2) / (37 - reps) : 0;
+
+    epley = epley > UINT32_MAX ? UINT32_MAX : epley;
+    brzycki = brzycki > UINT32_MAX ? UINT32_MAX : brzycki;
+
+    if (epley > p->best_epley) {
+        p->best_epley = epley;
+    }
+
+    if (brzycki > p->best_brzycki) {
+        p->best_brzycki = brzycki;
+    }
+
+    if (w > p->top_weight || (w == p->top_weight && reps > p->top_reps)) {
+        p->top_weight = w;
+        p->top_reps = reps;
+    }
+
+    p->volume += sets * reps * w;
+}
+
+/*
+ * rollup_single_t: Adds the work of `s` to its points for `week`, each side of asymmetric work separately.
+ */
+static int rollup_single_t(rollup_table *t, eml_single_t *s, int64_t week) {
+    int error = no_error;
+    uint32_t name;
+
+    if ((error = name_table_intern(&t->names, s->name, &name))) {
+        return error;
+    }
+
+    for (bool side = left; side <= right; side++) {
+        uint32_t sets, count;
+        uint32_t kind = work_kind(s, side, &sets);
+        eml_reps *reps = work_reps(s, side, &count);
+        eml_rollup_point *p;
+
+        if (count == 0) {
+            continue;
+        }
+
+        uint32_t rollup_side = s->asymmetric_work == NULL ? both_sides : side ? right_side : left_side;
+        if ((error = rollup_table_point(t, name, rollup_side, week, &p))) {
+            return error;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            rollup_reps(p, kind == frozen_standard ? sets : 1, &reps[i]);
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * rollup_worker_run: Rolls up a worker's slice of sessions into its partial rollup_table.
+ */
+static void *rollup_worker_run(void *arg) {
+    rollup_worker *w = arg;
+
+    for (uint32_t i = 0; i < w->count && w->error == no_error; i++) {
+        eml_result *result = w->sessions[i].result;
+        int64_t timestamp = w->sessions[i].timestamp;
+        int64_t week = (timestamp >= 0 ? timestamp / ROLLUP_WEEK : -((-timestamp + ROLLUP_WEEK - 1) / ROLLUP_WEEK)) * ROLLUP_WEEK;
+
+        for (uint32_t j = 0; j < result->count && w->error == no_error; j++) {
+            eml_obj *o = &result->objs[j];
+
+            if (o->type == single) {
+                w->error = rollup_single_t(&w->table, &o->data.single, week);
+            } else {
+                for (uint32_t k = 0; k < o->data.super.count && w->error == no_error; k++) {
+                    w->error = rollup_single_t(&w->table, &o->data.super.members[k], week);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * merge_rollup_point: Merges a partial point of the same exercise side & week into `into`.
+ */
+static void merge_rollup_point(eml_rollup_point *into, eml_rollup_point *from) {
+    if (from->best_epley > into->best_epley) {
+        into->best_epley = from->best_epley;
+    }
+
+    if (from->best_brzycki > into->best_brzycki) {
+        into->best_brzycki = from->best_brzycki;
+    }
+
+    if (from->top_weight > into->top_weight || (from->top_weight == into->top_weight && from->top_reps > into->top_reps)) {
+        into->top_weight = from->top_weight;
+        into->top_reps = from->top_reps;
+    }
+
+    into->volume += from->volume;
+}
+
+/*
+ * compare_rollup_order: qsort comparator ordering rollup_order by name, side & week.
+ */
+static int compare_rollup_order(const void *a, const void *b) {
+    const rollup_order *x = a;
+    const rollup_order *y = b;
+    int c = strcmp(x->name, y->name);
+
+    if (c != 0) {
+        return c;
+    }
+
+    if (x->entry->side != y->entry->side) {
+        return x->entry->side < y->entry->side ? -1 : 1;
+    }
+
+    if (x->entry->point.week != y->entry->point.week) {
+        return x->entry->point.week < y->entry->point.week ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/*
+ * eml_rollup_build: Rolls up `sessions` into weekly per-exercise (& side) progression series. Sessions are split
+ *                   across `threads` workers (0 for one per core), each building a partial rollup that is merged
+ *                   once all of them finish. Free the rollup with eml_rollup_free().
+ */
+int eml_rollup_build(eml_session *sessions, uint32_t count, uint32_t threads, eml_rollup **rollup) {
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? cores : 1;
+    }
+
+    if (threads > count) {
+        threads = count ? count : 1;
+    }
+
+    int error = no_error;
+    uint32_t started = 0;
+    rollup_table merged;
+    rollup_order *order = NULL;
+    rollup_worker *workers = calloc(threads, sizeof(rollup_worker));
+    pthread_t *ids = calloc(threads, sizeof(pthread_t));
+
+    memset(&merged, 0, sizeof(merged));
+    *rollup = NULL;
+
+    if (workers == NULL || ids == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        uint32_t begin = (uint64_t)count * i / threads;
+        uint32_t end = (uint64_t)count * (i + 1) / threads;
+
+        workers[i].sessions = sessions + begin;
+        workers[i].count = end - begin;
+    }
+
+    // The calling thread takes the first slice
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&ids[started], NULL, rollup_worker_run, &workers[started]) != 0) {
+            error = thread_error;
+            break;
+        }
+    }
+
+    rollup_worker_run(&workers[0]);
+
+    for (uint32_t i = 1; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    for (uint32_t i = 0; i < threads && error == no_error; i++) {
+        error = workers[i].error;
+    }
+
+    for (uint32_t i = 0; i < threads && error == no_error; i++) {
+        rollup_table *t = &workers[i].table;
+
+        for (uint32_t j = 0; j < t->count && error == no_error; j++) {
+            rollup_entry *e = &t->entries[j];
+            eml_rollup_point *p;
+            uint32_t name;
+
+            if ((error = name_table_intern(&merged.names, t->names.names[e->name], &name))) {
+                break;
+            }
+
+            if ((error = rollup_table_point(&merged, name, e->side, e->point.week, &p))) {
+                break;
+            }
+
+            merge_rollup_point(p, &e->point);
+        }
+    }
+
+    if (error) {
+        goto bail;
+    }
+
+    *rollup = calloc(1, sizeof(eml_rollup));
+    if (*rollup == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    // Sessions without weighted work roll up to no series
+    if (merged.count == 0) {
+        goto bail;
+    }
+
+    order = malloc(sizeof(rollup_order) * merged.count);
+    if (order == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < merged.count; i++) {
+        order[i].name = merged.names.names[merged.entries[i].name];
+        order[i].entry = &merged.entries[i];
+    }
+    qsort(order, merged.count, sizeof(rollup_order), compare_rollup_order);
+
+    uint32_t series = 0;
+    for (uint32_t i = 0; i < merged.count; i++) {
+        if (i == 0 || order[i].entry->name != order[i - 1].entry->name || order[i].entry->side != order[i - 1].entry->side) {
+            series++;
+        }
+    }
+
+    (*rollup)->series = calloc(series, sizeof(eml_rollup_series));
+    eml_rollup_point *points = malloc(sizeof(eml_rollup_point) * merged.count);
+    if ((*rollup)->series == NULL || points == NULL) {
+        free(points);
+        error = allocation_error;
+        goto bail;
+    }
+
+    // All points live in one array owned by the first series (& freed with it by eml_rollup_free())
+    eml_rollup_series *current = NULL;
+    for (uint32_t i = 0; i < merged.count; i++) {
+        if (current == NULL || order[i].entry->name != order[i - 1].entry->name || order[i].entry->side != order[i - 1].entry->side) {
+            current = &(*rollup)->series[(*rollup)->count++];
+            current->side = order[i].entry->side;
+            current->points = points + i;
+            current->name = malloc(strlen(order[i].name) + 1);
+            if (current->name == NULL) {
+                error = allocation_error;
+                goto bail;
+            }
+            strcpy(current->name, order[i].name);
+        }
+
+        points[i] = order[i].entry->point;
+        current->count++;
+    }
+
+    bail:
+        if (error && *rollup != NULL) {
+            eml_rollup_free(*rollup);
+            *rollup = NULL;
+        }
+
+        for (uint32_t i = 0; workers != NULL && i < threads; i++) {
+            rollup_table_free(&workers[i].table);
+        }
+
+        rollup_table_free(&merged);
+        free(workers);
+        free(ids);
+        free(order);
+        return error;
+}
+
+/*
+ * eml_rollup_free: Frees an eml_rollup.
+ */
+void eml_rollup_free(eml_rollup *rollup) {
+    if (rollup == NULL) {
+        return;
+    }
+
+    if (rollup->series != NULL) {
+        for (uint32_t i = 0; i < rollup->count; i++) {
+            free(rollup->series[i].name);
+        }
+
+        if (rollup->count > 0) {
+            free(rollup->series[0].points);
+        }
+
+        free(rollup->series);
+    }
+
+    free(rollup);
+}
+
+/*
+ * map_file: Maps a file of at least `minimum` (> 0) bytes read-only. Unmap with munmap(base, size). A shorter file is
+ *           the format's error, `truncated`.
+ */
+static int map_file(const char *path, uint64_t minimum, int truncated, const char **base, uint64_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return io_error;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return io_error;
+    }
+
+    if ((uint64_t)st.st_size < minimum) {
+        close(fd);
+        return truncated;
+    }
+
+    *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (*base == MAP_FAILED) {
+        return io_error;
+    }
+
+    *size = st.st_size;
+    return no_error;
+}
+
+/*
+ * sync_directory: Flushes the directory holding file `path` to disk, so an entry renamed into it survives a crash.
+ */
+static int sync_directory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    uint64_t length = slash == NULL ? 1 : slash == path ? 1 : (uint64_t)(slash - path);
+    char *directory = malloc(length + 1);
+    if (directory == NULL) {
+        return allocation_error;
+    }
+
+    memcpy(directory, slash == NULL ? "." : path, length);
+    directory[length] = '\0';
+
+    int fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(directory);
+    if (fd < 0) {
+        return io_error;
+    }
+
+    int error = fsync(fd) == 0 ? no_error : io_error;
+    close(fd);
+    return error;
+}
+
+/*
+ * eml_corpus_writer_open: Creates (or truncates) a corpus file at `path` for appending documents.
+ */
+int eml_corpus_writer_open(const char *path, eml_corpus_writer **writer) {
+    *writer = calloc(1, sizeof(eml_corpus_writer));
+    if (*writer == NULL) {
+        return allocation_error;
+    }
+
+    eml_corpus_file header;
+    memset(&header, 0, sizeof(header));
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(&header, sizeof(header), 1, file) != 1) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        free(*writer);
+        *writer = NULL;
+        return io_error;
+    }
+
+    (*writer)->file = file;
+    (*writer)->offset = sizeof(header);
+    return no_error;
+}
+
+/*
+ * eml_corpus_writer_add: Appends the first `length` bytes of `document` with an optional `id` (0 if unused).
+ */
+int eml_corpus_writer_add(eml_corpus_writer *writer, const char *document, uint64_t length, uint64_t id) {
+    if (writer->count == writer->capacity) {
+        uint64_t capacity = writer->capacity ? writer->capacity * 2 : 256;
+        eml_corpus_entry *entries = realloc(writer->entries, sizeof(eml_corpus_entry) * capacity);
+        if (entries == NULL) {
+            return allocation_error;
+        }
+
+        writer->entries = entries;
+        writer->capacity = capacity;
+    }
+
+    // The sentinel lets parse() read documents straight out of the mapping
+    if (fwrite(document, 1, length, writer->file) != length || fputc('\0', writer->file) == EOF) {
+        return io_error;
+    }
+
+    eml_corpus_entry *e = &writer->entries[writer->count++];
+    e->offset = writer->offset;
+    e->length = length;
+    e->id = id;
+
+    writer->offset += length + 1;
+    return no_error;
+}
+
+/*
+ * eml_corpus_writer_close: Writes the offset table & header, closes the file & frees the writer.
+ */
+int eml_corpus_writer_close(eml_corpus_writer *writer) {
+    static const char padding[8];
+    FILE *file = writer->file;
+
+    eml_corpus_file header;
+    memset(&header, 0, sizeof(header));
+    header.magic = EML_CORPUS_MAGIC;
+    header.count = writer->count;
+    header.table = (writer->offset + 7) & ~7ULL;
+    header.size = header.table + sizeof(eml_corpus_entry) * writer->count;
+
+    bool written = fwrite(padding, 1, header.table - writer->offset, file) == header.table - writer->offset
+        && fwrite(writer->entries, sizeof(eml_corpus_entry), writer->count, file) == writer->count
+        && fseek(file, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    if (fclose(file) != 0) {
+        written = false;
+    }
+
+    free(writer->entries);
+    free(writer);
+    return written ? no_error : io_error;
+}
+
+/*
+ * eml_corpus_open: Maps a corpus file read-only & checks its offset table. Close with eml_corpus_close().
+ */
+int eml_corpus_open(const char *path, eml_corpus **corpus) {
+    const char *base;
+    uint64_t size;
+    int error = no_error;
+
+    if ((error = map_file(path, sizeof(eml_corpus_file), corpus_format_error, &base, &size))) {
+        return error;
+    }
+
+    const eml_corpus_file *header = (const eml_corpus_file *)base;
+    bool valid = header->magic == EML_CORPUS_MAGIC && header->size == size && header->table % 8 == 0
+        && header->table <= size && header->count <= (size - header->table) / sizeof(eml_corpus_entry);
+
+    const eml_corpus_entry *entries = (const eml_corpus_entry *)(base + (valid ? header->table : 0));
+    for (uint64_t i = 0; valid && i < header->count; i++) {
+        valid = entries[i].offset <= header->table && entries[i].length < header->table - entries[i].offset
+            && entries[i].length <= UINT32_MAX && base[entries[i].offset + entries[i].length] == '\0';
+    }
+
+    if (!valid) {
+        munmap((void *)base, size);
+        return corpus_format_error;
+    }
+
+    *corpus = malloc(sizeof(eml_corpus));
+    if (*corpus == NULL) {
+        munmap((void *)base, size);
+        return allocation_error;
+    }
+
+    (*corpus)->base = base;
+    (*corpus)->size = size;
+    (*corpus)->count = header->count;
+    (*corpus)->entries = entries;
+    return no_error;
+}
+
+/*
+ * eml_corpus_document: Points `document` at document `i` inside the mapping (terminated by a sentinel).
+ *                      `length` & `id` may be NULL.
+ */
+int eml_corpus_document(eml_corpus *corpus, uint64_t i, const char **document, uint64_t *length, uint64_t *id) {
+    if (i >= corpus->count) {
+        return out_of_range_error;
+    }
+
+    *document = corpus->base + corpus->entries[i].offset;
+    if (length != NULL) {
+        *length = corpus->entries[i].length;
+    }
+    if (id != NULL) {
+        *id = corpus->entries[i].id;
+    }
+
+    return no_error;
+}
+
+/*
+ * eml_corpus_parse: Parses document `i` in place, without copying it out of the mapping.
+ */
+int eml_corpus_parse(eml_corpus *corpus, uint64_t i, eml_result **result) {
+    if (i >= corpus->count) {
+        return out_of_range_error;
+    }
+
+    // parse_length only reads the document, so parsing straight from the read-only mapping is safe
+    return parse_length((char *)corpus->base + corpus->entries[i].offset, corpus->entries[i].length, result);
+}
+
+/*
+ * eml_corpus_split: Sets [begin, end) to the documents of part `part` of `parts` near-equal contiguous parts,
+ *                   so threads can divide the offset table between them. A part past the last (or of 0 parts) is
+ *                   empty.
+ */
+void eml_corpus_split(eml_corpus *corpus, uint32_t part, uint32_t parts, uint64_t *begin, uint64_t *end) {
+    if (part >= parts) {
+        *begin = *end = corpus->count;
+        return;
+    }
+
+    *begin = corpus->count * part / parts;
+    *end = corpus->count * (part + 1) / parts;
+}
+
+/*
+ * eml_corpus_close: Unmaps & frees an eml_corpus.
+ */
+void eml_corpus_close(eml_corpus *corpus) {
+    if (corpus == NULL) {
+        return;
+    }
+
+    munmap((void *)corpus->base, corpus->size);
+    free(corpus);
+}
+
+/*
+ * buffer_reserve: Ensures `b` has room for `length` more bytes.
+ */
+static int buffer_reserve(byte_buffer *b, uint64_t length) {
+    if (b->length + length <= b->capacity) {
+        return no_error;
+    }
+
+    uint64_t capacity = b->capacity ? b->capacity : 256;
+    while (capacity < b->length + length) {
+        capacity *= 2;
+    }
+
+    uint8_t *data = realloc(b->data, capacity);
+    if (data == NULL) {
+        return allocation_error;
+    }
+
+    b->data = data;
+    b->capacity = capacity;
+    return no_error;
+}
+
+/*
+ * buffer_varint: Appends `v` as a LEB128 varint.
+ */
+static int buffer_varint(byte_buffer *b, uint64_t v) {
+    int error = buffer_reserve(b, 10);
+    if (error) {
+        return error;
+    }
+
+    b->length += write_varint(b->data + b->length, v);
+    return no_error;
+}
+
+/*
+ * buffer_bytes: Appends `length` bytes of `data`.
+ */
+static int buffer_bytes(byte_buffer *b, const void *data, uint64_t length) {
+    int error = buffer_reserve(b, length);
+    if (error) {
+        return error;
+    }
+
+    memcpy(b->data + b->length, data, length);
+    b->length += length;
+    return no_error;
+}
+
+/*
+ * read_varint32: Reads a LEB128 varint that must fit in 32 bits.
+ */
+static bool read_varint32(const uint8_t **p, const uint8_t *end, uint32_t *v) {
+    uint64_t wide;
+
+    if (!read_varint(p, end, &wide) || wide > UINT32_MAX) {
+        return false;
+    }
+
+    *v = wide;
+    return true;
+}
+
+/*
+ * build_crc32_table: Fills crc32_table. Run once through pthread_once.
+ */
+static void build_crc32_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int j = 0; j < 8; j++) {
+            c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+        }
+        crc32_table[i] = c;
+    }
+}
+
+/*
+ * crc32: Returns the CRC-32 (IEEE) of `data`.
+ */
+static uint32_t crc32(const uint8_t *data, uint64_t length) {
+    pthread_once(&crc32_table_once, build_crc32_table);
+
+    uint32_t crc = 0xFFFFFFFFU;
+    for (uint64_t i = 0; i < length; i++) {
+        crc = crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFU;
+}
+
+/*
+ * name_table_find: Sets `id` to the id of `name` if it is in the table, without adding it.
+ */
+static bool name_table_find(name_table *t, const char *name, uint32_t *id) {
+    if (t->capacity == 0) {
+        return false;
+    }
+
+    uint32_t slot = hash_string(FNV_OFFSET_BASIS, name) & (t->capacity - 1);
+    while (t->slots[slot] != 0) {
+        if (strcmp(t->names[t->slots[slot] - 1], name) == 0) {
+            *id = t->slots[slot] - 1;
+            return true;
+        }
+        slot = (slot + 1) & (t->capacity - 1);
+    }
+
+    return false;
+}
+
+/*
+ * log_string: Appends the dictionary id of `str` to log->body. Names the log has not seen yet are collected in
+ *             `fresh` & numbered after the log's names, in the order they are first used.
+ */
+static int log_string(eml_log *log, name_table *fresh, const char *str) {
+    uint32_t id;
+    int error = no_error;
+
+    if (!name_table_find(&log->names, str, &id)) {
+        if ((error = name_table_intern(fresh, str, &id))) {
+            return error;
+        }
+        id += log->names.count;
+    }
+
+    return buffer_varint(&log->body, id);
+}
+
+/*
+ * log_single_t: Appends `s` to log->body: name, asymmetric flag, then each side's kind, sets & reps.
+ *               eml_numbers are stored as (value << 1 | H) so small fractional numbers stay short.
+ */
+static int log_single_t(eml_log *log, name_table *fresh, eml_single_t *s) {
+    int error = no_error;
+
+    if ((error = log_string(log, fresh, s->name)) || (error = buffer_varint(&log->body, s->asymmetric_work != NULL))) {
+        return error;
+    }
+
+    for (bool side = left; side <= (s->asymmetric_work != NULL); side++) {
+        uint32_t sets, count;
+        uint32_t kind = work_kind(s, side, &sets);
+        eml_reps *reps = work_reps(s, side, &count);
+
+        if ((error = buffer_varint(&log->body, kind))) {
+            return error;
+        }
+
+        if (kind != frozen_standard && kind != frozen_standard_varied) {
+            continue;
+        }
+
+        if ((error = buffer_varint(&log->body, sets))) {
+            return error;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            error = buffer_varint(&log->body, reps[i].type);
+            error = error ? error : buffer_varint(&log->body, (uint64_t)(reps[i].value & eml_number_mask) << 1 | reps[i].value >> 31);
+            if (!error && reps_has_modifier(&reps[i])) {
+                eml_number m = reps[i].modifier.weight;
+                error = buffer_varint(&log->body, (uint64_t)(m & eml_number_mask) << 1 | m >> 31);
+            }
+
+            if (error) {
+                return error;
+            }
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * log_encode: Encodes `result` as a complete record in log->record: length, CRC-32, the names it introduces, then
+ *             the headers & objects. Introduced names are collected in `fresh`, to be added to log->names only
+ *             once the record is on disk.
+ */
+static int log_encode(eml_log *log, name_table *fresh, eml_result *result) {
+    uint32_t header_count = 0;
+    int error = no_error;
+
+    log->body.length = 0;
+    log->record.length = 0;
+
+    for (eml_header_t *h = result->header; h != NULL; h = h->next) {
+        header_count++;
+    }
+
+    if ((error = buffer_varint(&log->body, header_count))) {
+        return error;
+    }
+
+    for (eml_header_t *h = result->header; h != NULL; h = h->next) {
+        if ((error = log_string(log, fresh, h->parameter)) || (error = log_string(log, fresh, h->value))) {
+            return error;
+        }
+    }
+
+    if ((error = buffer_varint(&log->body, result->count))) {
+        return error;
+    }
+
+    for (uint32_t i = 0; i < result->count; i++) {
+        eml_obj *o = &result->objs[i];
+
+        if ((error = buffer_varint(&log->body, o->type))) {
+            return error;
+        }
+
+        if (o->type == single) {
+            if ((error = log_single_t(log, fresh, &o->data.single))) {
+                return error;
+            }
+            continue;
+        }
+
+        if ((error = buffer_varint(&log->body, o->data.super.count))) {
+            return error;
+        }
+
+        for (uint32_t j = 0; j < o->data.super.count; j++) {
+            if ((error = log_single_t(log, fresh, &o->data.super.members[j]))) {
+                return error;
+            }
+        }
+    }
+
+    if ((error = buffer_reserve(&log->record, LOG_RECORD_HEADER_LENGTH))) {
+        return error;
+    }
+    log->record.length = LOG_RECORD_HEADER_LENGTH;
+
+    if ((error = buffer_varint(&log->record, fresh->count))) {
+        return error;
+    }
+
+    for (uint32_t i = 0; i < fresh->count; i++) {
+        uint32_t length = strlen(fresh->names[i]);
+        if ((error = buffer_varint(&log->record, length)) || (error = buffer_bytes(&log->record, fresh->names[i], length))) {
+            return error;
+        }
+    }
+
+    if ((error = buffer_bytes(&log->record, log->body.data, log->body.length))) {
+        return error;
+    }
+
+    uint64_t payload = log->record.length - LOG_RECORD_HEADER_LENGTH;
+    if (payload > UINT32_MAX) {
+        return allocation_error;
+    }
+
+    uint32_t header[2] = {payload, crc32(log->record.data + LOG_RECORD_HEADER_LENGTH, payload)};
+    memcpy(log->record.data, header, LOG_RECORD_HEADER_LENGTH);
+
+    return no_error;
+}
+
+/*
+ * log_dictionary_add: Adds a name (pointing into the mapped log) to a replay dictionary.
+ */
+static int log_dictionary_add(log_dictionary *d, const char *name, uint32_t length) {
+    if (d->count == d->capacity) {
+        uint32_t capacity = d->capacity ? d->capacity * 2 : 64;
+        log_name *names = realloc(d->names, sizeof(log_name) * capacity);
+        if (names == NULL) {
+            return allocation_error;
+        }
+
+        d->names = names;
+        d->capacity = capacity;
+    }
+
+    d->names[d->count].name = name;
+    d->names[d->count].length = length;
+    d->count++;
+    return no_error;
+}
+
+/*
+ * log_read_names: Adds the names a record introduces to `d`.
+ */
+static int log_read_names(const uint8_t **p, const uint8_t *end, log_dictionary *d) {
+    uint32_t count, length;
+    int error = no_error;
+
+    if (!read_varint32(p, end, &count)) {
+        return log_format_error;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!read_varint32(p, end, &length) || length > (uint64_t)(end - *p)) {
+            return log_format_error;
+        }
+
+        if ((error = log_dictionary_add(d, (const char *)*p, length))) {
+            return error;
+        }
+        *p += length;
+    }
+
+    return no_error;
+}
+
+/*
+ * log_read_string: Reads a dictionary id & returns a newly allocated copy of its name in `str`.
+ */
+static int log_read_string(const uint8_t **p, const uint8_t *end, log_dictionary *d, char **str) {
+    uint32_t id;
+
+    if (!read_varint32(p, end, &id) || id >= d->count) {
+        return log_format_error;
+    }
+
+    *str = malloc(d->names[id].length + 1);
+    if (*str == NULL) {
+        return allocation_error;
+    }
+
+    memcpy(*str, d->names[id].name, d->names[id].length);
+    (*str)[d->names[id].length] = '\0';
+    return no_error;
+}
+
+/*
+ * log_read_work: Reads one side's work, allocating it like the parser does.
+ */
+static int log_read_work(const uint8_t **p, const uint8_t *end, eml_none_k **n, eml_standard_k **k, eml_standard_varied_k **v) {
+    uint32_t kind, sets;
+    eml_reps *reps;
+
+    if (!read_varint32(p, end, &kind)) {
+        return log_format_error;
+    }
+
+    switch (kind) {
+        case frozen_absent:
+            return no_error;
+        case frozen_none:
+            *n = malloc(sizeof(eml_none_k));
+            return *n == NULL ? allocation_error : no_error;
+        case frozen_standard:
+        case frozen_standard_varied:
+            break;
+        default:
+            return log_format_error;
+    }
+
+    if (!read_varint32(p, end, &sets)) {
+        return log_format_error;
+    }
+
+    if (kind == frozen_standard) {
+        *k = malloc(sizeof(eml_standard_k));
+        if (*k == NULL) {
+            return allocation_error;
+        }
+
+        (*k)->sets = sets;
+        reps = &(*k)->reps;
+    } else {
+        // Every rep takes at least 2 bytes, which bounds `sets` before allocating
+        if (sets > (uint64_t)(end - *p) / 2) {
+            return log_format_error;
+        }
+
+        *v = malloc(sizeof(eml_standard_varied_k) + sizeof(eml_reps) * sets);
+        if (*v == NULL) {
+            return allocation_error;
+        }
+
+        (*v)->sets = sets;
+        reps = (*v)->vReps;
+    }
+
+    for (uint32_t i = 0; i < (kind == frozen_standard ? 1 : sets); i++) {
+        uint32_t type, value, modifier = 0;
+
+        if (!read_varint32(p, end, &type) || type > timeRPE || !read_varint32(p, end, &value)) {
+            return log_format_error;
+        }
+
+        reps[i].type = type;
+        reps[i].value = value >> 1 | value << 31;
+        reps[i].modifier.weight = 0;
+
+        if (reps_has_modifier(&reps[i])) {
+            if (!read_varint32(p, end, &modifier)) {
+                return log_format_error;
+            }
+            reps[i].modifier.weight = modifier >> 1 | modifier << 31;
+        }
+    }
+
+    return no_error;
+}
+
+/*
+ * log_read_single_t: Reads a single into caller-owned `s`. On error `s` holds what was read so far.
+ */
+static int log_read_single_t(const uint8_t **p, const uint8_t *end, log_dictionary *d, eml_single_t *s) {
+    uint32_t asymmetric;
+    int error = no_error;
+
+    s->name = NULL;
+    s->no_work = NULL;
+    s->standard_work = NULL;
+    s->standard_varied_work = NULL;
+    s->asymmetric_work = NULL;
+
+    if ((error = log_read_string(p, end, d, &s->name))) {
+        return error;
+    }
+
+    if (!read_varint32(p, end, &asymmetric) || asymmetric > 1) {
+        return log_format_error;
+    }
+
+    if (!asymmetric) {
+        return log_read_work(p, end, &s->no_work, &s->standard_work, &s->standard_varied_work);
+    }
+
+    s->asymmetric_work = calloc(1, sizeof(eml_asymmetric_k));
+    if (s->asymmetric_work == NULL) {
+        return allocation_error;
+    }
+
+    eml_asymmetric_k *a = s->asymmetric_work;
+    if ((error = log_read_work(p, end, &a->left_none_k, &a->left_standard_k, &a->left_standard_varied_k))) {
+        return error;
+    }
+
+    return log_read_work(p, end, &a->right_none_k, &a->right_standard_k, &a->right_standard_varied_k);
+}
+
+/*
+ * log_decode: Decodes the headers & objects of a record (after its names) into a new eml_result.
+ */
+static int log_decode(const uint8_t *p, const uint8_t *end, log_dictionary *d, eml_result **result) {
+    uint32_t header_count, count;
+    eml_header_t *tail = NULL;
+    int error = no_error;
+
+    *result = calloc(1, sizeof(eml_result));
+    if (*result == NULL) {
+        return allocation_error;
+    }
+
+    if (!read_varint32(&p, end, &header_count)) {
+        error = log_format_error;
+        goto bail;
+    }
+
+    for (uint32_t i = 0; i < header_count; i++) {
+        eml_header_t *h = calloc(1, sizeof(eml_header_t));
+        if (h == NULL) {
+            error = allocation_error;
+            goto bail;
+        }
+
+        if (tail == NULL) {
+            (*result)->header = h;
+        } else {
+            tail->next = h;
+        }
+        tail = h;
+
+        if ((error = log_read_string(&p, end, d, &h->parameter)) || (error = log_read_string(&p, end, d, &h->value))) {
+            goto bail;
+        }
+    }
+
+    // Every object takes at least 2 bytes, which bounds `count` before allocating
+    if (!read_varint32(&p, end, &count) || count > (uint64_t)(end - p) / 2) {
+        error = log_format_error;
+        goto bail;
+    }
+
+    // A record without objects leaves `objs` NULL, as parse() does for an empty body
+    if (count > 0 && ((*result)->objs = malloc(sizeof(eml_obj) * count)) == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+    (*result)->capacity = count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        eml_obj *o = &(*result)->objs[i];
+        uint32_t type, members;
+
+        if (!read_varint32(&p, end, &type) || type > circuit) {
+            error = log_format_error;
+            goto bail;
+        }
+
+        // Counted before reading so a partially read object is freed with the result
+        o->type = type;
+        (*result)->count++;
+
+        if (type == single) {
+            if ((error = log_read_single_t(&p, end, d, &o->data.single))) {
+                goto bail;
+            }
+            continue;
+        }
+
+        o->data.super.count = 0;
+        o->data.super.capacity = 0;
+        o->data.super.members = NULL;
+
+        if (!read_varint32(&p, end, &members) || members > (uint64_t)(end - p) / 2) {
+            error = log_format_error;
+            goto bail;
+        }
+
+        if (members > 0 && (o->data.super.members = malloc(sizeof(eml_single_t) * members)) == NULL) {
+            error = allocation_error;
+            goto bail;
+        }
+        o->data.super.capacity = members;
+
+        for (uint32_t j = 0; j < members; j++) {
+            o->data.super.count++;
+            if ((error = log_read_single_t(&p, end, d, &o->data.super.members[j]))) {
+                goto bail;
+            }
+        }
+    }
+
+    if (p != end) {
+        error = log_format_error;
+        goto bail;
+    }
+
+    return no_error;
+
+    bail:
+        free_result(*result);
+        *result = NULL;
+        return error;
+}
+
+/*
+ * log_record: Checks the record at `offset` is complete & its CRC-32 matches. Points `payload` at its payload.
+ */
+static bool log_record(const uint8_t *base, uint64_t size, uint64_t offset, const uint8_t **payload, uint32_t *length) {
+    uint32_t header[2];
+
+    if (size - offset < LOG_RECORD_HEADER_LENGTH) {
+        return false;
+    }
+
+    memcpy(header, base + offset, LOG_RECORD_HEADER_LENGTH);
+    if (header[0] > size - offset - LOG_RECORD_HEADER_LENGTH) {
+        return false;
+    }
+
+    *payload = base + offset + LOG_RECORD_HEADER_LENGTH;
+    *length = header[0];
+    return crc32(*payload, *length) == header[1];
+}
+
+/*
+ * log_write: Writes all of `data` to `fd`, retrying short writes.
+ */
+static int log_write(int fd, const uint8_t *data, uint64_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            return io_error;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return no_error;
+}
+
+/*
+ * eml_log_open: Opens (or creates) the log at `path`. Records are checked & decoded, and a torn or corrupt tail left
+ *               by a crash is truncated. If `durable`, every append is synced to disk before it returns.
+ */
+int eml_log_open(const char *path, bool durable, eml_log **log) {
+    static const uint32_t header[2] = {EML_LOG_MAGIC, 1};
+    log_dictionary d = {NULL, 0, 0};
+    int error = no_error;
+
+    *log = calloc(1, sizeof(eml_log));
+    if (*log == NULL) {
+        return allocation_error;
+    }
+
+    (*log)->durable = durable;
+    (*log)->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if ((*log)->fd < 0) {
+        free(*log);
+        *log = NULL;
+        return io_error;
+    }
+
+    struct stat st;
+    if (fstat((*log)->fd, &st) != 0) {
+        error = io_error;
+        goto bail;
+    }
+
+    if ((uint64_t)st.st_size < sizeof(header)) {
+        // New (or torn while being created)
+        if (ftruncate((*log)->fd, 0) != 0 || (error = log_write((*log)->fd, (const uint8_t *)header, sizeof(header)))) {
+            error = error ? error : io_error;
+            goto bail;
+        }
+
+        (*log)->size = sizeof(header);
+        return no_error;
+    }
+
+    const uint8_t *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, (*log)->fd, 0);
+    if (base == MAP_FAILED) {
+        error = io_error;
+        goto bail;
+    }
+
+    if (memcmp(base, header, sizeof(header)) != 0) {
+        munmap((void *)base, st.st_size);
+        error = log_format_error;
+        goto bail;
+    }
+
+    uint64_t offset = sizeof(header);
+    const uint8_t *payload;
+    uint32_t length;
+    while (log_record(base, st.st_size, offset, &payload, &length)) {
+        const uint8_t *p = payload;
+        uint32_t first = d.count;
+        eml_result *result;
+
+        // Decoded in full, so replay never hands a callback the records before one that cannot be read
+        if ((error = log_read_names(&p, payload + length, &d)) || (error = log_decode(p, payload + length, &d, &result))) {
+            break;
+        }
+        free_result(result);
+
+        for (uint32_t i = first; i < d.count && error == no_error; i++) {
+            char *name = malloc(d.names[i].length + 1);
+            uint32_t id;
+
+            if (name == NULL) {
+                error = allocation_error;
+                break;
+            }
+
+            memcpy(name, d.names[i].name, d.names[i].length);
+            name[d.names[i].length] = '\0';
+            error = name_table_intern(&(*log)->names, name, &id);
+            free(name);
+        }
+
+        if (error) {
+            break;
+        }
+
+        offset += LOG_RECORD_HEADER_LENGTH + length;
+    }
+
+    munmap((void *)base, st.st_size);
+    free(d.names);
+
+    if (error == log_format_error) {
+        error = no_error; // A record that checksums but does not decode is treated as the torn tail
+    }
+
+    if (error) {
+        goto bail;
+    }
+
+    if (offset < (uint64_t)st.st_size && ftruncate((*log)->fd, offset) != 0) {
+        error = io_error;
+        goto bail;
+    }
+
+    (*log)->size = offset;
+    return no_error;
+
+    bail:
+        eml_log_close(*log);
+        *log = NULL;
+        return error;
+}
+
+/*
+ * eml_log_append: Appends `result` as one record with a single write. A failed write or sync is truncated away, so
+ *                 the log only ever grows by whole records, & its names only with the records that introduce them.
+ */
+int eml_log_append(eml_log *log, eml_result *result) {
+    name_table fresh = {NULL, NULL, 0, 0};
+    int error = no_error;
+
+    // Room for the record's names is made first, so nothing can fail once the record is on disk
+    if ((error = log_encode(log, &fresh, result)) || (error = name_table_reserve(&log->names, fresh.count))) {
+        goto bail;
+    }
+
+    if ((error = log_write(log->fd, log->record.data, log->record.length))
+        || (log->durable && fdatasync(log->fd) != 0 && (error = io_error))) {
+        if (ftruncate(log->fd, log->size) != 0) {
+            error = io_error;
+        }
+        goto bail;
+    }
+
+    log->size += log->record.length;
+
+    // The record is on disk, so the names it introduced now belong to the log (in the same order as their ids)
+    for (uint32_t i = 0; i < fresh.count; i++) {
+        name_table_adopt(&log->names, fresh.names[i]);
+    }
+    fresh.count = 0;
+
+    bail:
+        name_table_free(&fresh);
+        return error;
+}
+
+/*
+ * eml_log_replay: Decodes every record in order, handing each result to `callback`, which owns (and must free) it.
+ *                 Stops early with the callback's return value if it is non-zero.
+ */
+int eml_log_replay(eml_log *log, int (*callback)(eml_result *result, void *context), void *context) {
+    log_dictionary d = {NULL, 0, 0};
+    int error = no_error;
+
+    const uint8_t *base = mmap(NULL, log->size, PROT_READ, MAP_SHARED, log->fd, 0);
+    if (base == MAP_FAILED) {
+        return io_error;
+    }
+
+    uint64_t offset = LOG_HEADER_LENGTH;
+    const uint8_t *payload;
+    uint32_t length;
+    while (offset < log->size) {
+        eml_result *result;
+        const uint8_t *p;
+
+        if (!log_record(base, log->size, offset, &payload, &length)) {
+            error = log_format_error;
+            break;
+        }
+
+        p = payload;
+        if ((error = log_read_names(&p, payload + length, &d)) || (error = log_decode(p, payload + length, &d, &result))) {
+            break;
+        }
+
+        if ((error = callback(result, context))) {
+            break;
+        }
+
+        offset += LOG_RECORD_HEADER_LENGTH + length;
+    }
+
+    munmap((void *)base, log->size);
+    free(d.names);
+    return error;
+}
+
+/*
+ * eml_log_close: Closes & frees an eml_log.
+ */
+void eml_log_close(eml_log *log) {
+    if (log == NULL) {
+        return;
+    }
+
+    close(log->fd);
+    name_table_free(&log->names);
+    free(log->body.data);
+    free(log->record.data);
+    free(log);
+}
+
+/*
+ * eml_share: Seals `result` in a shared handle holding one reference. The handle owns `result` from here on: it must
+ *            no longer be modified (eml_convert_weight()) or passed to free_result(). The read APIs (print_result,
+ *            eml_freeze, eml_hash, eml_equal, eml_query_run, ...) only read it, so they need no locking.
+ */
+int eml_share(eml_result *result, eml_shared **shared) {
+    *shared = malloc(sizeof(eml_shared));
+    if (*shared == NULL) {
+        return allocation_error;
+    }
+
+    atomic_init(&(*shared)->references, 1);
+    (*shared)->result = result;
+    return no_error;
+}
+
+/*
+ * eml_shared_result: Returns the result of a shared handle, valid (& read-only) while the caller holds a reference.
+ */
+eml_result *eml_shared_result(eml_shared *shared) {
+    return shared->result;
+}
+
+/*
+ * eml_shared_retain: Takes another reference for a new consumer & returns `shared`.
+ */
+eml_shared *eml_shared_retain(eml_shared *shared) {
+    // Nothing is published by retaining, the caller already holds a reference
+    atomic_fetch_add_explicit(&shared->references, 1, memory_order_relaxed);
+    return shared;
+}
+
+/*
+ * eml_shared_release: Drops a reference. The last release frees the result & the handle.
+ */
+void eml_shared_release(eml_shared *shared) {
+    if (shared == NULL) {
+        return;
+    }
+
+    // Release orders this thread's reads before the count drops; acquire (for the last release) orders every other
+    // thread's reads before the free
+    if (atomic_fetch_sub_explicit(&shared->references, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    free_result(shared->result);
+    free(shared);
+}
+
+/*
+ * eml_ingest: Reads & parses the files at `paths` on `threads` workers (0 for one per core), passing each parse to
+ *             `callback`. Every worker keeps INGEST_QUEUE_DEPTH files in flight through its own io_uring, parsing
+ *             finished reads while the rest are pending; without io_uring the workers read with blocking calls.
+ *             Returns the first non-zero callback return, or an error of the ingest itself.
+ */
+int eml_ingest(const char **paths, uint32_t count, uint32_t threads, eml_ingest_callback callback, void *context) {
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? cores : 1;
+    }
+
+    if (threads > count) {
+        threads = count ? count : 1;
+    }
+
+    int error = no_error;
+    uint32_t started = 0;
+    ingest_job job;
+    ingest_worker *workers = calloc(threads, sizeof(ingest_worker));
+    pthread_t *ids = calloc(threads, sizeof(pthread_t));
+
+    if (workers == NULL || ids == NULL) {
+        error = allocation_error;
+        goto bail;
+    }
+
+    job.paths = paths;
+    job.count = count;
+    job.callback = callback;
+    job.context = context;
+    atomic_init(&job.next, 0);
+    atomic_init(&job.stop, 0);
+
+    for (uint32_t i = 0; i < threads; i++) {
+        workers[i].job = &job;
+    }
+
+    // The calling thread is the first worker
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&ids[started], NULL, ingest_worker_run, &workers[started]) != 0) {
+            error = thread_error;
+            break;
+        }
+    }
+
+    ingest_worker_run(&workers[0]);
+
+    for (uint32_t i = 1; i < started; i++) {
+        pthread_join(ids[i], NULL);
     }
-}
 
-/*
- * upgrade_to_asymmetric: Allocates tst->asymmetric_work & moves existing tst->(no_work | standard_work | standard_varied_work) kind to left side.
- */
-static int upgrade_to_asymmetric(eml_single_t *tst) {
-    tst->asymmetric_work = malloc(sizeof(eml_asymmetric_k));
-    if (tst->asymmetric_work == NULL) {
-        return allocation_error;
+    for (uint32_t i = 0; i < threads && error == no_error; i++) {
+        error = workers[i].error;
     }
 
-    tst->asymmetric_work->left_none_k = NULL;
-    tst->asymmetric_work->left_standard_k = NULL;
-    tst->asymmetric_work->left_standard_varied_k = NULL;
-    tst->asymmetric_work->right_none_k = NULL;
-    tst->asymmetric_work->right_standard_k = NULL;
-    tst->asymmetric_work->right_standard_varied_k = NULL;
+    if (error == no_error) {
+        error = atomic_load(&job.stop);
+    }
 
-    move_to_asymmetric(tst, left);
-    return no_error;
+    bail:
+        free(workers);
+        free(ids);
+        return error;
 }
 
 /*
- * upgrade_to_standard_varied: Allocates tst->standard_varied_work & migrates tst->standard_work.
+ * ingest_claim: Claims the next unread file for `slot`. False once every file is claimed or the ingest stopped.
  */
-static int upgrade_to_standard_varied(eml_single_t *tst) {
-    tst->standard_varied_work = malloc(sizeof(eml_reps) * tst->standard_work->sets + sizeof(eml_number));
-    if (tst->standard_varied_work == NULL) {
-        return allocation_error;
+static bool ingest_claim(ingest_job *job, ingest_slot *slot) {
+    if (atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+        return false;
     }
-    
-    tst->standard_varied_work->sets = tst->standard_work->sets;
 
-    // standard_varied_kind defaults
-    for (int i = 0; i < tst->standard_varied_work->sets; i++) {
-        tst->standard_varied_work->vReps[i].type = unmodified;
+    uint_fast32_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+    if (i >= job->count) {
+        return false;
     }
 
-    free(tst->standard_work);
-    tst->standard_work = NULL;
-    return no_error;
+    slot->i = i;
+    slot->fd = -1;
+    slot->length = 0;
+    return true;
 }
 
 /*
- * upgrade_to_standard: Allocates tst->standard_work.
+ * ingest_grow: Ensures `slot` has buffer room past slot->length, doubling the buffer when full.
  */
-static int upgrade_to_standard(eml_single_t *tst) {
-    tst->standard_work = malloc(sizeof(eml_standard_k));
-    if (tst->standard_work == NULL) {
+static int ingest_grow(ingest_slot *slot) {
+    if (slot->length < slot->capacity) {
+        return no_error;
+    }
+
+    uint64_t capacity = slot->capacity ? slot->capacity * 2 : INGEST_BUFFER_SIZE;
+    char *buffer = realloc(slot->buffer, capacity);
+    if (buffer == NULL) {
         return allocation_error;
     }
 
-    tst->standard_work->reps.type = unmodified;
+    slot->buffer = buffer;
+    slot->capacity = capacity;
     return no_error;
 }
 
 /*
- * format_eml_number: Returns a temporary formatted eml_number string which is valid until next call or exits.
+ * ingest_finish: Closes the slot's file & hands its parse (or `error`) to the callback. Returns the callback's return.
  */
-static void format_eml_number(eml_number *e, char *f) {
-    if (*e & eml_number_H) {
-        uint32_t masked = (*e & eml_number_mask);
-        sprintf(f, "%u.%u", masked / 100U, masked % 100U);
-    } else {
-        // <= 21474836U check ignored
-        sprintf(f, "%u", *e);
+static int ingest_finish(ingest_job *job, ingest_slot *slot, int error) {
+    eml_result *result = NULL;
+    int stop;
+
+    if (slot->fd >= 0) {
+        close(slot->fd);
+        slot->fd = -1;
+    }
+
+    if (atomic_load_explicit(&job->stop, memory_order_relaxed)) {
+        return no_error;
+    }
+
+    if (error == no_error) {
+        error = slot->length > UINT32_MAX ? out_of_range_error : parse_length(slot->buffer, slot->length, &result);
+    }
+
+    if ((stop = job->callback(slot->i, result, error, job->context))) {
+        int expected = 0;
+        atomic_compare_exchange_strong(&job->stop, &expected, stop);
     }
+
+    return stop;
 }
 
 /*
- * print_standard_k: Prints an eml_standard_k to stdout.
+ * ingest_pread: Reads & parses files one at a time with blocking calls. The fallback without io_uring.
  */
-static void print_standard_k(eml_standard_k *k) {
-    char value[MAX_FORMATTED_EML_STRING_LENGTH];
-    char modifier[MAX_FORMATTED_EML_STRING_LENGTH];
+static int ingest_pread(ingest_worker *w) {
+    ingest_slot *slot = &w->slots[0];
 
-    format_eml_number((eml_number *)&(k->reps.value), value);
-    format_eml_number((eml_number *)&(k->reps.modifier), modifier);
+    while (ingest_claim(w->job, slot)) {
+        ssize_t n = 0;
+        int error = no_error;
 
-    switch (k->reps.type) {
-        case unmodified:
-            printf("%i sets of %s reps", k->sets, value);
-            break;
-        case unmodifiedFailure:
-            printf("%i sets to failure", k->sets);
-            break;
-        case unmodifiedTime:
-            printf("%i time sets of %s seconds", k->sets, value);
-            break;
-        case unmodifiedTimeFailure:
-            printf("%i time sets to failure", k->sets);
-            break;
-        case weight:
-            printf("%i sets of %s reps with %s %s", k->sets, value, modifier, weightUnit);
-            break;
-        case weightFailure:
-            printf("%i sets to failure with %s %s", k->sets, modifier, weightUnit);
-            break;
-        case timeWeight:
-            printf("%i time sets of %s seconds with %s %s", k->sets, value, modifier, weightUnit);
-            break;
-        case timeWeightFaliure:
-            printf("%i time sets to failure with %s %s", k->sets, modifier, weightUnit);
-            break;
-        case rpe:
-            printf("%i sets of %s reps with RPE of %s", k->sets, value, modifier);
-            break;
-        case timeRPE:
-            printf("%i time sets of %s seconds with RPE of %s", k->sets, value, modifier);
-            break;
+        slot->fd = open(w->job->paths[slot->i], O_RDONLY | O_CLOEXEC);
+        if (slot->fd < 0) {
+            ingest_finish(w->job, slot, io_error);
+            continue;
+        }
+
+        do {
+            if ((error = ingest_grow(slot))) {
+                break;
+            }
+
+            n = pread(slot->fd, slot->buffer + slot->length, slot->capacity - slot->length, slot->length);
+            slot->length += n > 0 ? n : 0;
+        } while (n > 0);
+
+        ingest_finish(w->job, slot, error ? error : n < 0 ? io_error : no_error);
     }
 
-    printf("\n");
+    return no_error;
 }
 
 /*
- * print_standard_varied_k: Prints an eml_standard_varied_k to stdout.
+ * ingest_worker_run: Runs a worker through io_uring when the kernel allows it, otherwise through ingest_pread().
  */
-static void print_standard_varied_k(eml_standard_varied_k *k) {
-    int count = k->sets;
-    printf("%i sets\n", count);
-    for (int i = 0; i < count; i++) {
-        printf(" - ");
+static void *ingest_worker_run(void *arg) {
+    ingest_worker *w = arg;
 
-        // standard_varied_k emulates standard_k for printing
-        eml_standard_k shim;
-        shim.sets = k->sets;
-        shim.reps = k->vReps[i];
-        print_standard_k(&shim); // FIXME: Prints X sets of ... on every line
+    for (uint32_t i = 0; i < INGEST_QUEUE_DEPTH; i++) {
+        w->slots[i].fd = -1;
+    }
+
+    #ifdef EML_IO_URING
+        ingest_ring r;
+        if (ingest_ring_init(&r, INGEST_QUEUE_DEPTH) == no_error) {
+            w->error = ingest_uring(w, &r);
+            ingest_ring_free(&r);
+        } else {
+            w->error = ingest_pread(w);
+        }
+    #else
+        w->error = ingest_pread(w);
+    #endif
+
+    for (uint32_t i = 0; i < INGEST_QUEUE_DEPTH; i++) {
+        free(w->slots[i].buffer);
     }
+
+    return NULL;
 }
 
+#ifdef EML_IO_URING
 /*
- * print_single_t: Prints a eml_single_t to stdout.
+ * ingest_ring_init: Sets up & maps an io_uring of `entries` submissions (io_uring_setup(2)).
  */
-static void print_single_t(eml_single_t *s) {
-    printf("--- single_t ---\n");
-    printf("Name: %s\n", s->name);
+static int ingest_ring_init(ingest_ring *r, uint32_t entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(ingest_ring));
+
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        return io_error;
+    }
 
-    if (s->no_work != NULL) {
-        printf("No work\n");
-    } else if (s->standard_work != NULL) {
-        printf("Standard work\n");
-        print_standard_k(s->standard_work);
-    } else if (s->standard_varied_work != NULL) {
-        printf("Standard varied work\n");
-        print_standard_varied_k(s->standard_varied_work);
-    } else if (s->asymmetric_work != NULL) {
-        printf("Asymetric work\n");
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->sq_ring_size = r->cq_ring_size = r->sq_ring_size > r->cq_ring_size ? r->sq_ring_size : r->cq_ring_size;
+    }
 
-        if (s->asymmetric_work->left_none_k != NULL) {
-            printf("LEFT: No work\n");
-        } else if (s->asymmetric_work->left_standard_k != NULL) {
-            printf("LEFT: Standard work ");
-            print_standard_k(s->asymmetric_work->left_standard_k);
-        } else if (s->asymmetric_work->left_standard_varied_k != NULL) {
-            printf("LEFT: Standard varied work ");
-            print_standard_varied_k(s->asymmetric_work->left_standard_varied_k);
-        }
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        r->sq_ring = NULL;
+        goto bail;
+    }
 
-        if (s->asymmetric_work->right_none_k != NULL) {
-            printf("RIGHT: No work\n");
-        } else if (s->asymmetric_work->right_standard_k != NULL) {
-            printf("RIGHT: Standard work ");
-            print_standard_k(s->asymmetric_work->right_standard_k);
-        } else if (s->asymmetric_work->right_standard_varied_k != NULL) {
-            printf("RIGHT: Standard varied work ");
-            print_standard_varied_k(s->asymmetric_work->right_standard_varied_k);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            r->cq_ring = NULL;
+            goto bail;
         }
     }
+
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto bail;
+    }
+
+    r->sq_tail = (uint32_t *)((char *)r->sq_ring + p.sq_off.tail);
+    r->sq_mask = (uint32_t *)((char *)r->sq_ring + p.sq_off.ring_mask);
+    r->sq_array = (uint32_t *)((char *)r->sq_ring + p.sq_off.array);
+    r->cq_head = (uint32_t *)((char *)r->cq_ring + p.cq_off.head);
+    r->cq_tail = (uint32_t *)((char *)r->cq_ring + p.cq_off.tail);
+    r->cq_mask = (uint32_t *)((char *)r->cq_ring + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)r->cq_ring + p.cq_off.cqes);
+    r->tail = *r->sq_tail;
+    return no_error;
+
+    bail:
+        ingest_ring_free(r);
+        return io_error;
 }
 
 /*
- * print_super_t: Prints a eml_super_t to stdout.
+ * ingest_ring_free: Unmaps & closes an io_uring.
  */
-static void print_super_t(eml_super_t *s) {
-    printf("----- SUPER -----\n");
-    eml_super_member_t *current = s->sets;
-    while(current != NULL) {
-        print_single_t(current->single);
-        current = current->next;
+static void ingest_ring_free(ingest_ring *r) {
+    if (r->sqes != NULL) {
+        munmap(r->sqes, r->sqes_size);
     }
-    printf("--- SUPER END ---\n");
-    return;
+
+    if (r->cq_ring != NULL && r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_ring_size);
+    }
+
+    if (r->sq_ring != NULL) {
+        munmap(r->sq_ring, r->sq_ring_size);
+    }
+
+    close(r->fd);
 }
 
 /*
- * print_circuit_t: Prints a eml_circuit_t to stdout.
+ * ingest_sqe: Queues a zeroed submission for `slot`, to be sent by the next ingest_submit().
  */
-static void print_circuit_t(eml_circuit_t *c) {
-    printf("----- CIRCUIT -----\n");
-    eml_super_member_t *current = c->sets;
-    while(current != NULL) {
-        print_single_t(current->single);
-        current = current->next;
+static struct io_uring_sqe *ingest_sqe(ingest_ring *r, uint8_t opcode, uint32_t slot) {
+    uint32_t index = r->tail++ & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = slot;
+    r->sq_array[index] = index;
+    r->queued++;
+    return sqe;
+}
+
+/*
+ * ingest_submit: Publishes the queued submissions & waits for at least `wait` completions (io_uring_enter(2)).
+ */
+static int ingest_submit(ingest_ring *r, uint32_t wait) {
+    // Release makes the submissions visible to the kernel before the tail that covers them
+    atomic_store_explicit((_Atomic uint32_t *)r->sq_tail, r->tail, memory_order_release);
+
+    while (r->queued > 0 || wait > 0) {
+        int n = syscall(__NR_io_uring_enter, r->fd, r->queued, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return io_error;
+        }
+
+        r->queued -= n;
+        wait = 0;
     }
-    printf("--- CIRCUIT END ---\n");
-    return;
+
+    return no_error;
 }
 
 /*
- * print_emlobj: Prints an eml_obj to stdout.
+ * ingest_read: Queues a read of the slot's file into the rest of its buffer.
  */
-static void print_emlobj(eml_obj *e) {
-    switch (e->type) {
-        case single:
-            print_single_t((eml_single_t*) e->data);
-            break;
-        case super:
-            print_super_t((eml_super_t*) e->data);
-            break;
-        case circuit:
-            print_circuit_t((eml_circuit_t*) e->data);
+static void ingest_read(ingest_ring *r, ingest_slot *slot, uint32_t s) {
+    struct io_uring_sqe *sqe = ingest_sqe(r, IORING_OP_READ, s);
+    uint64_t room = slot->capacity - slot->length;
+
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->buffer + slot->length);
+    sqe->len = room > UINT32_MAX ? UINT32_MAX : room;
+    sqe->off = slot->length;
+}
+
+/*
+ * ingest_uring: Keeps every slot busy with an open or read through `r`, parsing each file as its last read completes.
+ *               A read that fills the buffer is followed by another; one that comes back short is the end of the file.
+ */
+static int ingest_uring(ingest_worker *w, ingest_ring *r) {
+    bool busy[INGEST_QUEUE_DEPTH] = {false};
+    uint32_t in_flight = 0;
+    int error = no_error;
+
+    for (uint32_t s = 0; s < INGEST_QUEUE_DEPTH && ingest_claim(w->job, &w->slots[s]); s++) {
+        struct io_uring_sqe *sqe = ingest_sqe(r, IORING_OP_OPENAT, s);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)w->job->paths[w->slots[s].i];
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        busy[s] = true;
+        in_flight++;
+    }
+
+    while (in_flight > 0) {
+        if ((error = ingest_submit(r, 1))) {
             break;
+        }
+
+        // Acquire pairs with the kernel's release of the completions it posted
+        uint32_t head = *r->cq_head;
+        uint32_t tail = atomic_load_explicit((_Atomic uint32_t *)r->cq_tail, memory_order_acquire);
+
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            uint32_t s = cqe->user_data;
+            int32_t res = cqe->res;
+            ingest_slot *slot = &w->slots[s];
+
+            atomic_store_explicit((_Atomic uint32_t *)r->cq_head, head + 1, memory_order_release);
+
+            if (res < 0) {
+                ingest_finish(w->job, slot, io_error);
+            } else if (slot->fd < 0 || (slot->length += res) == slot->capacity) {
+                // The open completed, or a read filled the buffer: read (more)
+                slot->fd = slot->fd < 0 ? res : slot->fd;
+
+                if ((error = ingest_grow(slot)) == no_error) {
+                    ingest_read(r, slot, s);
+                    continue;
+                }
+
+                ingest_finish(w->job, slot, error);
+                error = no_error;
+            } else {
+                ingest_finish(w->job, slot, no_error);
+            }
+
+            // The slot is free again
+            if (ingest_claim(w->job, slot)) {
+                struct io_uring_sqe *sqe = ingest_sqe(r, IORING_OP_OPENAT, s);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uint64_t)(uintptr_t)w->job->paths[slot->i];
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            } else {
+                busy[s] = false;
+                in_flight--;
+            }
+        }
     }
+
+    if (error) {
+        ingest_drain(w, r, busy, in_flight);
+    }
+
+    return error;
 }
 
-void print_result(eml_result *result) {
-    if (result == NULL) {
-        return;
+/*
+ * ingest_drain: After the ring failed, cancels the opens & reads still in flight & reaps their completions, so none
+ *               lands in a buffer once it is freed. Every claimed file is then finished with io_error.
+ */
+static void ingest_drain(ingest_worker *w, ingest_ring *r, bool *busy, uint32_t in_flight) {
+    // Cancellations complete with an id past the slots, & only while the submission ring has room for them
+    for (uint32_t s = 0; s < INGEST_QUEUE_DEPTH && r->queued < INGEST_QUEUE_DEPTH; s++) {
+        if (busy[s]) {
+            struct io_uring_sqe *sqe = ingest_sqe(r, IORING_OP_ASYNC_CANCEL, INGEST_QUEUE_DEPTH);
+            sqe->addr = s;
+        }
     }
 
-    printf("--- Parsed EML ---\n");
-    printf("Header:\n");
+    while (in_flight > 0 && ingest_submit(r, 1) == no_error) {
+        uint32_t head = *r->cq_head;
+        uint32_t tail = atomic_load_explicit((_Atomic uint32_t *)r->cq_tail, memory_order_acquire);
 
-    eml_header_t *h = result->header;
-    while (h != NULL) {
-        printf(" - Parameter: %s, Value: %s\n", h->parameter, h->value);
-        h = h->next;
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            uint32_t s = cqe->user_data;
+            int32_t res = cqe->res;
+
+            atomic_store_explicit((_Atomic uint32_t *)r->cq_head, head + 1, memory_order_release);
+            if (s >= INGEST_QUEUE_DEPTH || !busy[s]) {
+                continue;
+            }
+
+            // An open that still completed leaves a file to close
+            if (w->slots[s].fd < 0 && res >= 0) {
+                w->slots[s].fd = res;
+            }
+
+            ingest_finish(w->job, &w->slots[s], io_error);
+            busy[s] = false;
+            in_flight--;
+        }
     }
 
-    printf("Body:\n");
-    eml_obj *obj = result->objs;
-    while(obj != NULL) {
-        print_emlobj(obj);
-        obj = obj->next;
+    for (uint32_t s = 0; s < INGEST_QUEUE_DEPTH; s++) {
+        if (!busy[s]) {
+            continue;
+        }
+
+        // The kernel may yet finish a read it could not be asked to cancel, so its buffer is left to it
+        ingest_finish(w->job, &w->slots[s], io_error);
+        w->slots[s].buffer = NULL;
+        w->slots[s].capacity = 0;
     }
 }
+#endif
 
 /*
- * free_single_t: Frees a eml_single_t.
+ * clear_single_t: Frees the name & work owned by a eml_single_t, but not the eml_single_t itself.
  */
-static void free_single_t(eml_single_t *s) {
+static void clear_single_t(eml_single_t *s) {
     if (s->name != NULL) {
         free(s->name);
     }
@@ -1222,33 +8021,29 @@ static void free_single_t(eml_single_t *s) {
 
         free(s->asymmetric_work);
     }
-
-    free(s);
 }
 
 /*
- * free_super_t: Frees a eml_super_t.
+ * clear_super_t: Frees the members owned by a eml_super_t, but not the eml_super_t itself.
  */
-static void free_super_t(eml_super_t *s) {
-    eml_super_member_t *current = s->sets;
-    while(current != NULL) {
-        free_single_t(current->single);
-        
-        eml_super_member_t *t = current;
-        current = current->next;
-        free(t);
+static void clear_super_t(eml_super_t *s) {
+    for (uint32_t i = 0; i < s->count; i++) {
+        clear_single_t(&s->members[i]);
+    }
+
+    if (s->members != NULL) {
+        free(s->members);
     }
-    free(s);
 }
 
 /*
- * free_emlobj: Frees an eml_obj.
+ * free_emlobj: Frees the EML Token held by an eml_obj.
  */
 static void free_emlobj(eml_obj *e) {
     if (e->type == single) {
-        free_single_t((eml_single_t*) e->data);
+        clear_single_t(&e->data.single);
     } else {
-        free_super_t((eml_super_t*) e->data);
+        clear_super_t(&e->data.super);
     }
 }
 
@@ -1260,6 +8055,28 @@ void free_result(eml_result *result) {
         return;
     }
 
+    STAT(free_results, 1);
+    STAT_TIMER(start);
+
+    if (result->block != NULL) {
+        free(result->block);
+        STAT_ELAPSED(free_result_nanoseconds, start);
+        return;
+    }
+
+    // Interned work belongs to its table
+    for (uint32_t i = 0; i < result->count && result->works != NULL; i++) {
+        eml_obj *o = &result->objs[i];
+
+        if (o->type == single) {
+            detach_work(&o->data.single);
+        } else {
+            for (uint32_t j = 0; j < o->data.super.count; j++) {
+                detach_work(&o->data.super.members[j]);
+            }
+        }
+    }
+
     eml_header_t *h = result->header;
     while (h != NULL) {
         result->header = h->next;
@@ -1270,13 +8087,72 @@ void free_result(eml_result *result) {
         h = result->header;
     }
 
-    eml_obj *obj = result->objs;
-    while(obj != NULL) {
-        result->objs = obj->next;
-        free_emlobj(obj);
-        obj = result->objs;
+    for (uint32_t i = 0; i < result->count; i++) {
+        free_emlobj(&result->objs[i]);
+    }
+
+    if (result->objs != NULL) {
+        free(result->objs);
     }
 
     free(result);
     result = NULL;
+    STAT_ELAPSED(free_result_nanoseconds, start);
+}
+
+/*
+ * eml_stats_get: Copies the calling thread's counters into `out` (all zero unless built with -DEML_STATS).
+ */
+void eml_stats_get(eml_stats *out) {
+    #ifdef EML_STATS
+        *out = stats;
+    #else
+        memset(out, 0, sizeof(eml_stats));
+    #endif
+}
+
+/*
+ * eml_stats_reset: Zeroes the calling thread's counters.
+ */
+void eml_stats_reset(void) {
+    #ifdef EML_STATS
+        memset(&stats, 0, sizeof(eml_stats));
+    #endif
+}
+
+#ifdef EML_STATS
+/*
+ * stats_now: Monotonic time in nanoseconds.
+ */
+static uint64_t stats_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/*
+ * stats_malloc, stats_calloc, stats_realloc: Count the call & requested bytes, then call the C library's allocator.
+ */
+static void *stats_malloc(size_t size) {
+    STAT(mallocs, 1);
+    STAT(malloc_bytes, size);
+    return (malloc)(size);
+}
+
+static void *stats_calloc(size_t count, size_t size) {
+    STAT(mallocs, 1);
+    STAT(malloc_bytes, count * size);
+    return (calloc)(count, size);
+}
+
+static void *stats_realloc(void *p, size_t size) {
+    STAT(mallocs, 1);
+    STAT(malloc_bytes, size);
+    return (realloc)(p, size);
 }
+
+// Allocations in a file that includes this one are its own, not the library's
+#undef malloc
+#undef calloc
+#undef realloc
+#endif
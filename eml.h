@@ -1,6 +1,20 @@
+#ifndef EML_H
+#define EML_H
+
 #include <stdint.h>
 
-typedef uint32_t bool;
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * eml_bool - The library's 32b boolean. C++ has its own (1 byte) bool, so structs use eml_bool to keep one layout.
+ */
+typedef uint32_t eml_bool;
+
+#ifndef __cplusplus
+typedef eml_bool bool;
+#endif
 
 /*
  * eml_number - An unsigned 32b fixed-point number
@@ -66,7 +80,7 @@ typedef struct Reps {
  * Description: No work for designated exercise. Often used in asymmetric work to define unilateral exercises.
  * Example: "squat":;
  */
-typedef bool eml_none_k;
+typedef eml_bool eml_none_k;
 
 /* 
  * Standard Work
@@ -116,23 +130,16 @@ typedef struct Single {
 } eml_single_t;
 
 /*
- * eml_single_t - A linked list node holding onto eml_single_t within a super.
- */
-typedef struct SuperMember {
-    eml_single_t       *single;
-    struct SuperMember *next;
-} eml_super_member_t;
-
-/*
- * eml_super_t - A collection of eml_super_member_t.
+ * eml_super_t - A contiguous, growable array of `count` eml_single_t members.
  */
 typedef struct Superset {
-    uint32_t           count;
-    eml_super_member_t *sets;
+    uint32_t     count;
+    uint32_t     capacity;
+    eml_single_t *members;
 } eml_super_t;
 
 /*
- * eml_circuit_t - A collection of eml_super_member_t.
+ * eml_circuit_t - A contiguous, growable array of eml_single_t members.
  */
 typedef eml_super_t eml_circuit_t;
 
@@ -144,22 +151,344 @@ typedef eml_super_t eml_circuit_t;
 typedef enum EMLObjtype { single, super, circuit } eml_objtype;
 
 /*
- * eml_obj - Wrapper around an EML Token.
+ * eml_obj - An EML Token stored inline, discriminated by `type`.
  */
 typedef struct EMLObj {
-    eml_objtype   type;
-    void          *data;
-    struct EMLObj *next;
+    eml_objtype type;
+
+    union {
+        eml_single_t  single;
+        eml_super_t   super;
+        eml_circuit_t circuit;
+    } data;
 } eml_obj;
 
 /*
- * eml_result - Parser output in the form of a linked list for the header and objects respectively
+ * eml_work_table - Deduplicates work by content across results (see eml_work_intern()). Opaque.
+ */
+typedef struct WorkTable eml_work_table;
+
+/*
+ * eml_result - Parser output in the form of a linked list for the header and a contiguous array of `count` objects
  */
 typedef struct Result {
-    eml_header_t *header;
-    eml_obj      *objs;
+    eml_header_t   *header;
+    eml_obj        *objs;
+    uint32_t       count;
+    uint32_t       capacity;
+    void           *block; // The one allocation holding the whole result when parsed by parse_exact(), otherwise NULL
+    eml_work_table *works; // The table owning the result's (interned) work, otherwise NULL
 } eml_result;
 
+/* EML Frozen Results */
+
+/*
+ * eml_offset - A byte offset from the start of an eml_frozen block. 0 is reserved for "absent".
+ */
+typedef uint32_t eml_offset;
+
+/*
+ * eml_frozen_kind - The kind of work held by an eml_frozen_work.
+ */
+typedef enum FrozenKind { frozen_absent, frozen_none, frozen_standard, frozen_standard_varied } eml_frozen_kind;
+
+/*
+ * eml_frozen_work - Work of an eml_frozen_single. `count` eml_reps live at `reps`
+ *                   (1 for standard work, `sets` for standard varied work).
+ */
+typedef struct FrozenWork {
+    uint32_t   kind;
+    uint32_t   sets;
+    uint32_t   count;
+    eml_offset reps;
+} eml_frozen_work;
+
+/*
+ * eml_frozen_single - A frozen eml_single_t. Symmetric work is held in `left_work`, `right_work` is frozen_absent.
+ */
+typedef struct FrozenSingle {
+    eml_offset      name;
+    eml_bool        asymmetric;
+    eml_frozen_work left_work;
+    eml_frozen_work right_work;
+} eml_frozen_single;
+
+/*
+ * eml_frozen_obj - A frozen eml_obj. `count` contiguous eml_frozen_single live at `singles`
+ *                  (1 for a single, the member count for a super or circuit).
+ */
+typedef struct FrozenObj {
+    uint32_t   type;
+    uint32_t   count;
+    eml_offset singles;
+} eml_frozen_obj;
+
+/*
+ * eml_frozen_header - A frozen eml_header_t.
+ */
+typedef struct FrozenHeader {
+    eml_offset parameter;
+    eml_offset value;
+} eml_frozen_header;
+
+/*
+ * eml_frozen - A finished eml_result laid out in one contiguous block of `size` bytes using offsets
+ *              instead of pointers. The block can be cloned with memcpy, written to a file or placed
+ *              in shared memory and read in place without fix-ups.
+ *
+ *              Layout: eml_frozen | eml_frozen_header[] | eml_frozen_obj[] | eml_frozen_single[] | eml_reps[] | strings
+ */
+typedef struct Frozen {
+    uint32_t   magic;
+    uint32_t   size;
+    uint32_t   header_count;
+    eml_offset header;
+    uint32_t   count;
+    eml_offset objs;
+} eml_frozen;
+
+/* EML Queries */
+
+/*
+ * eml_query_name_mode - How a query matches exercise names.
+ */
+typedef enum QueryNameMode { any_name, exact_name, prefix_name } eml_query_name_mode;
+
+/*
+ * eml_query_sides - Whether a query matches symmetric work, asymmetric work or both.
+ */
+typedef enum QuerySides { any_sides, symmetric_sides, asymmetric_sides } eml_query_sides;
+
+/*
+ * eml_query_modifier - Which modifiers a query's modifier range applies to.
+ */
+typedef enum QueryModifier { any_modifier, weight_modifier, rpe_modifier } eml_query_modifier;
+
+/*
+ * eml_range - An inclusive range. eml_numbers are compared decoded to hundredths (120 and 120.00 are both 12000).
+ */
+typedef struct Range {
+    uint32_t min;
+    uint32_t max;
+} eml_range;
+
+/*
+ * eml_query - Predicates over singles & super/circuit members, all of which must hold. Start from eml_query_init().
+ *
+ *             objtypes      - Bit set of (1 << eml_objtype) the single belongs to, 0 for any.
+ *             kinds         - Bit set of (1 << eml_frozen_kind) one side's work must be, 0 for any.
+ *             reps_types    - Bit set of (1 << eml_reps.type) a rep on that side must be, 0 for any.
+ *             sets          - Range the side's number of sets must fall in.
+ *             reps          - Range the rep's value must fall in, in hundredths (5 reps is 500).
+ *             modifier      - Range the rep's weight/RPE modifier must fall in, in hundredths. Reps without a
+ *                             modifier never match a narrowed modifier range.
+ *             modifier_kind - The modifiers `modifier` applies to. Other than any_modifier, the rep must have a
+ *                             modifier of that kind.
+ *             unit          - "lbs" or "kg" to compare weights converted to it from each result's header unit, or
+ *                             NULL to compare them as written.
+ */
+typedef struct Query {
+    const char          *name;
+    eml_query_name_mode name_mode;
+    eml_query_sides     sides;
+    uint32_t            objtypes;
+    uint32_t            kinds;
+    uint32_t            reps_types;
+    eml_range           sets;
+    eml_range           reps;
+    eml_range           modifier;
+    eml_query_modifier  modifier_kind;
+    const char          *unit;
+} eml_query;
+
+/*
+ * eml_compiled_query - An eml_query validated & reduced to what the matcher needs by eml_query_compile().
+ */
+typedef struct CompiledQuery {
+    eml_query query;
+    uint32_t  name_length;
+    eml_bool  match_reps;
+    eml_bool  match_modifier;
+    eml_bool  convert_weights;
+    eml_bool  to_kg;
+} eml_compiled_query;
+
+/*
+ * eml_query_match - A matching single: results[result]->objs[obj], member `member` if the object is a super/circuit.
+ */
+typedef struct QueryMatch {
+    uint32_t     result;
+    uint32_t     obj;
+    uint32_t     member;
+    eml_single_t *single;
+} eml_query_match;
+
+/* EML Index */
+
+/*
+ * eml_posting_flags - How an exercise occurs in a posting.
+ */
+typedef enum PostingFlags { posting_super = 0x1, posting_circuit = 0x2, posting_asymmetric = 0x4 } eml_posting_flags;
+
+/*
+ * eml_posting - An exercise name occurring in top-level object `obj` of document `doc`, with eml_posting_flags.
+ */
+typedef struct Posting {
+    uint32_t doc;
+    uint32_t obj;
+    uint32_t flags;
+} eml_posting;
+
+/*
+ * eml_index_term - An exercise name in an index file & its postings list, sorted by (doc, obj) & varint encoded.
+ */
+typedef struct IndexTerm {
+    uint64_t postings;
+    uint64_t length;
+    uint32_t count;
+    uint32_t name;
+} eml_index_term;
+
+/*
+ * eml_index_file - Header of an index file, followed by `term_count` eml_index_term sorted by name, the names
+ *                  & the postings lists. Offsets are from the start of the file.
+ */
+typedef struct IndexFile {
+    uint32_t magic;
+    uint32_t term_count;
+    uint64_t size;
+} eml_index_file;
+
+/*
+ * eml_index - An index file mapped into memory by eml_index_open().
+ */
+typedef struct Index {
+    const char           *base;
+    uint64_t             size;
+    const eml_index_term *terms;
+    uint32_t             term_count;
+} eml_index;
+
+/* EML Rollups */
+
+/*
+ * eml_session - A parsed workout & when it was performed, in seconds since the epoch.
+ */
+typedef struct Session {
+    int64_t    timestamp;
+    eml_result *result;
+} eml_session;
+
+/*
+ * eml_rollup_side - Which side of an exercise a series covers. Symmetric work is rolled up as both_sides.
+ */
+typedef enum RollupSide { both_sides, left_side, right_side } eml_rollup_side;
+
+/*
+ * eml_rollup_point - One week of one exercise side. Weights are in hundredths of the sessions' header unit
+ *                    (convert the sessions to one unit first), estimated 1RMs are 0 when no set qualified.
+ *
+ *                    week         - Start of the 7 day bucket (from the epoch) the point covers.
+ *                    best_epley   - Best weight * (1 + reps / 30) over weighted sets.
+ *                    best_brzycki - Best weight * 36 / (37 - reps) over weighted sets of fewer than 37 reps.
+ *                    top_weight   - Heaviest weighted set (ties broken by reps) & its reps.
+ *                    volume       - Sum of sets * reps * weight.
+ */
+typedef struct RollupPoint {
+    int64_t  week;
+    uint32_t best_epley;
+    uint32_t best_brzycki;
+    uint32_t top_weight;
+    uint32_t top_reps;
+    uint64_t volume;
+} eml_rollup_point;
+
+/*
+ * eml_rollup_series - The weekly points of one exercise side, sorted by week.
+ */
+typedef struct RollupSeries {
+    char             *name;
+    uint32_t         side;
+    uint32_t         count;
+    eml_rollup_point *points;
+} eml_rollup_series;
+
+/*
+ * eml_rollup - Per-exercise progression series, sorted by name then side.
+ */
+typedef struct Rollup {
+    uint32_t          count;
+    eml_rollup_series *series;
+} eml_rollup;
+
+/* EML Corpus */
+
+/*
+ * eml_corpus_file - Header of a corpus file: the documents, each followed by a sentinel, then a table of
+ *                   `count` eml_corpus_entry at `table`. Offsets are from the start of the file.
+ */
+typedef struct CorpusFile {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t table;
+    uint64_t size;
+} eml_corpus_file;
+
+/*
+ * eml_corpus_entry - Where a document lives in a corpus file & its (optional, 0 if unused) id.
+ */
+typedef struct CorpusEntry {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t id;
+} eml_corpus_entry;
+
+/*
+ * eml_corpus_writer - Appends documents to a corpus file. The table is written by eml_corpus_writer_close().
+ */
+typedef struct CorpusWriter {
+    void             *file;
+    eml_corpus_entry *entries;
+    uint64_t         count;
+    uint64_t         capacity;
+    uint64_t         offset;
+} eml_corpus_writer;
+
+/*
+ * eml_corpus - A corpus file mapped into memory by eml_corpus_open().
+ */
+typedef struct Corpus {
+    const char             *base;
+    uint64_t               size;
+    uint64_t               count;
+    const eml_corpus_entry *entries;
+} eml_corpus;
+
+/* EML Log */
+
+/*
+ * eml_log - An append-only, checksummed log of parsed workouts opened by eml_log_open(). Opaque.
+ */
+typedef struct Log eml_log;
+
+/* EML Shared Results */
+
+/*
+ * eml_shared - A sealed, reference counted eml_result made by eml_share(). Opaque. Retaining & releasing are atomic,
+ *              so handles may be passed between threads; the result is freed by the last eml_shared_release().
+ */
+typedef struct Shared eml_shared;
+
+/* EML Ingest */
+
+/*
+ * eml_ingest_callback - Receives the parse of paths[i] on the worker thread that parsed it, so it must be thread safe.
+ *                       Owns `result`, which is NULL when `error` (io_error or a parse error) is set. Returning
+ *                       non-zero stops the ingest.
+ */
+typedef int (*eml_ingest_callback)(uint32_t i, eml_result *result, int error, void *context);
+
 /*
  * Errors
  */
@@ -188,8 +517,328 @@ typedef enum Errors {
     missing_weight_unit,                  // Header must contain weight unit parameter
     bad_reps_type_transition,             // eml string had an incorrect application of 'F', 'T', '@', '%', or some combination therein to REPS
     rpe_to_failure,                       // You cannot make RPE to failure
+    frozen_layout_error,                  // eml_frozen block is truncated, has a bad magic or an offset out of bounds
+    unknown_weight_unit_error,            // Weight unit must be "lbs" or "kg"
+    weight_conversion_overflow_error,     // A converted weight does not fit in an eml_number
+    bad_query_error,                      // Query has an empty range, an unknown name mode or is missing its name
+    io_error,                             // A file could not be opened, read, written or mapped
+    index_format_error,                   // Index file is truncated, has a bad magic or an offset out of bounds
+    thread_error,                         // A worker thread could not be started
+    corpus_format_error,                  // Corpus file is truncated, has a bad magic or an offset out of bounds
+    out_of_range_error,                   // Index is past the end of a collection
+    log_format_error,                     // Log file has a bad magic or a record that does not decode
+    shared_work_error,                    // Work interned in an eml_work_table is read-only & belongs to that table
+    template_error,                       // Template placeholder is malformed or not a reps/modifier value, or the values don't match the placeholders
+    aggregate_format_error,               // Aggregates file is truncated, has a bad magic or checksum or does not decode
 } eml_error;
 
+/* EML Work Tables */
+
+/*
+ * eml_work_stats - What an eml_work_table shares.
+ * unique - distinct work nodes the table holds
+ * references - work pointers interned into it (unique + those replaced by an existing node)
+ * bytes_saved - bytes of duplicate work freed from interned results
+ */
+typedef struct WorkStats {
+    uint64_t unique;
+    uint64_t references;
+    uint64_t bytes_saved;
+} eml_work_stats;
+
+/* EML Templates */
+
+/*
+ * eml_template - A workout compiled once by eml_template_compile() from EML with "$N" placeholders (N from 0) in reps
+ *                & weight/RPE modifier positions, e.g. "squat":5x$0@$1; Instantiating it with one eml_number per
+ *                placeholder makes an eml_result or EML text without parsing again. Opaque.
+ */
+typedef struct Template eml_template;
+
+/* EML Diffs */
+
+/*
+ * eml_difference_kind - How the performed EML differs from the planned EML.
+ * missing_exercise - a planned single was not performed
+ * extra_exercise - a performed single was not planned
+ * set_count_change - a side has a different number of sets (no work has 0)
+ * reps_value_change - a set has a different number of reps (or seconds)
+ * reps_modifier_change - a set has a different weight or RPE
+ * reps_type_change - a set has a different eml_reps.type (failure, time, weight or RPE added or dropped)
+ */
+typedef enum DifferenceKind {
+    missing_exercise,
+    extra_exercise,
+    set_count_change,
+    reps_value_change,
+    reps_modifier_change,
+    reps_type_change,
+} eml_difference_kind;
+
+// eml_difference.*_obj & *_member of the result a missing or extra single is absent from
+#define EML_DIFF_ABSENT 0xFFFFFFFFU
+
+// eml_difference.set of a change to every set of a side
+#define EML_DIFF_EVERY_SET 0xFFFFFFFFU
+
+/*
+ * eml_difference - One difference found by eml_diff(), between planned->objs[planned_obj] & performed->objs[performed_obj]
+ *                  (member *_member of a super/circuit, otherwise 0).
+ *
+ *                  kind      - An eml_difference_kind.
+ *                  side      - The eml_rollup_side changed: both_sides unless either single is asymmetric.
+ *                  set       - The set changed, EML_DIFF_EVERY_SET for set counts & for reps of standard work on both.
+ *                  planned   - Sets (set_count_change), the reps value or modifier as an eml_number (reps_value_change,
+ *                  performed   reps_modifier_change) or the eml_reps.type (reps_type_change). 0 otherwise. A
+ *                              performed weight in the other of "lbs" & "kg" is converted to planned's unit, in
+ *                              hundredths.
+ */
+typedef struct Difference {
+    uint32_t kind;
+    uint32_t side;
+    uint32_t planned_obj;
+    uint32_t planned_member;
+    uint32_t performed_obj;
+    uint32_t performed_member;
+    uint32_t set;
+    uint32_t planned;
+    uint32_t performed;
+} eml_difference;
+
+/* EML CSV */
+
+/*
+ * eml_csv_rows - What one CSV row stands for.
+ * csv_set_groups - a side's standard work (all of its sets), or one set of varied work
+ * csv_sets - one set, standard work being expanded to a row per set
+ */
+typedef enum CsvRows { csv_set_groups, csv_sets } eml_csv_rows;
+
+/*
+ * eml_csv_sink - Receives the next `length` bytes of CSV. A non-zero return stops the writer with io_error.
+ */
+typedef int (*eml_csv_sink)(const char *data, uint32_t length, void *context);
+
+/*
+ * eml_csv_writer - Transcodes EML, written to it whole or in chunks, to CSV without parsing whole documents: the
+ *                  parser only ever holds one top level object. Documents may follow each other, each starting with
+ *                  its header. After a header row naming them, each row has the value of each chosen header
+ *                  parameter (empty if the document has none), then:
+ *
+ *                  document - Index of the document (header) in the input.
+ *                  object   - Index of the top level object in its document.
+ *                  type     - single, super or circuit.
+ *                  member   - Index of the single in its super/circuit, 0 for a single.
+ *                  exercise - The single's name.
+ *                  side     - both (symmetric work), left or right.
+ *                  set      - Index of the set, empty for a group of standard sets & for no work.
+ *                  sets     - Number of sets the row stands for, 0 for no work.
+ *                  reps     - Reps (or seconds of a timeset), empty when to failure or for no work.
+ *                  failure  - 1 if to failure, otherwise 0.
+ *                  time     - 1 for a timeset, otherwise 0.
+ *                  weight_value - The weight modifier, if any (named apart from the header's "weight").
+ *                  rpe_value    - The RPE modifier, if any.
+ *
+ *                  Fields holding ',', '"' or line breaks are quoted. Opaque.
+ */
+typedef struct CsvWriter eml_csv_writer;
+
+/* EML Lazy Documents */
+
+/*
+ * eml_lazy_entry - A top level object as found by eml_lazy_open(): its type, its bytes [begin, end) in the document
+ *                  &, for a single, the bytes of its name (name_length 0 for a super/circuit).
+ */
+typedef struct LazyEntry {
+    eml_objtype type;
+    uint32_t    begin;
+    uint32_t    end;
+    uint32_t    name_begin;
+    uint32_t    name_length;
+} eml_lazy_entry;
+
+/*
+ * eml_lazy - A document opened by one structural pass over its objects, each parsed only when first asked for (&
+ *            kept). The document must outlive it. Opaque.
+ */
+typedef struct Lazy eml_lazy;
+
+/* EML Aggregates */
+
+/*
+ * eml_aggregate_best - The heaviest weight of any weighted set of `reps` reps.
+ */
+typedef struct AggregateBest {
+    uint32_t reps;
+    uint32_t weight;
+} eml_aggregate_best;
+
+/*
+ * eml_aggregate - Running totals of one exercise side, sided as eml_rollup_series are. Weights are in hundredths of
+ *                 the sessions' header unit (convert the sessions to one unit first).
+ *
+ *                 sets    - Sets of any work.
+ *                 reps    - Reps of the sets counted in reps (not time).
+ *                 tonnage - Sum of sets * reps * weight over weighted sets.
+ *                 last    - Latest timestamp of a session with work for the exercise side.
+ *                 bests   - The best weight at each rep count of weighted sets, sorted by reps.
+ */
+typedef struct Aggregate {
+    const char         *name;
+    uint32_t           side;
+    uint32_t           best_count;
+    uint64_t           sets;
+    uint64_t           reps;
+    uint64_t           tonnage;
+    int64_t            last;
+    eml_aggregate_best *bests;
+} eml_aggregate;
+
+/*
+ * eml_aggregates - Per exercise side aggregates, updated a session at a time by eml_aggregates_add(). Opaque.
+ */
+typedef struct Aggregates eml_aggregates;
+
+/* EML Stats */
+
+// Number of eml_error codes (sizes eml_stats.errors)
+#define EML_ERROR_COUNT (aggregate_format_error + 1)
+
+/*
+ * eml_stats - Hot path counters of one thread. Only kept when eml.c is built with -DEML_STATS; otherwise the
+ *             counting compiles away and eml_stats_get() returns zeroes.
+ * bytes_scanned - input bytes the parser walked over (including those of documents that failed)
+ * objects - top level objects; singles counts every single, including the members of supers & circuits
+ * flushes - calls to flush(), one per buffered number written into a single
+ * upgrades_to_* - work kind upgrades, each of which allocates (& for standard_varied, frees) a work struct
+ * reps_type_transitions - modifiers & failure/time markers applied to reps
+ * mallocs / malloc_bytes - malloc, calloc & realloc calls made by the library & the bytes they asked for
+ * free_results / free_result_nanoseconds - calls to free_result() & the monotonic time spent in them
+ * errors - parse failures, by eml_error code
+ */
+typedef struct Stats {
+    uint64_t bytes_scanned;
+    uint64_t objects;
+    uint64_t singles;
+    uint64_t supers;
+    uint64_t circuits;
+    uint64_t flushes;
+    uint64_t upgrades_to_standard;
+    uint64_t upgrades_to_standard_varied;
+    uint64_t upgrades_to_asymmetric;
+    uint64_t reps_type_transitions;
+    uint64_t mallocs;
+    uint64_t malloc_bytes;
+    uint64_t free_results;
+    uint64_t free_result_nanoseconds;
+    uint64_t errors[EML_ERROR_COUNT];
+} eml_stats;
+
 int parse(char *eml_string, eml_result **result);
+int parse_length(char *eml_string, uint32_t length, eml_result **result);
+int parse_exact(char *eml_string, uint32_t length, eml_result **result);
+int parse_parallel(char *eml_string, uint32_t length, uint32_t threads, eml_result **result);
+uint32_t parse_error_offset(void);
 void print_result(eml_result *result);
 void free_result(eml_result *result);
+
+int eml_freeze(eml_result *result, eml_frozen **frozen);
+int eml_frozen_clone(const eml_frozen *frozen, eml_frozen **clone);
+int eml_frozen_validate(const void *block, uint32_t size);
+const void *eml_frozen_at(const eml_frozen *frozen, eml_offset offset);
+
+int eml_convert_weight(eml_result *result, const char *unit);
+int eml_convert_weight_batch(eml_result **results, uint32_t count, const char *unit);
+
+uint32_t eml_number_hundredths(eml_number e);
+eml_number eml_number_normalize(eml_number e);
+int eml_number_compare(eml_number a, eml_number b);
+int eml_number_add(eml_number a, eml_number b, eml_number *sum);
+int eml_number_multiply(eml_number a, eml_number b, eml_number *product);
+double eml_number_to_double(eml_number e);
+int eml_number_from_double(double d, eml_number *e);
+void eml_number_normalize_batch(const eml_number *values, eml_number *normalized, uint32_t count);
+int eml_number_add_batch(const eml_number *a, const eml_number *b, eml_number *sums, uint32_t count);
+int eml_number_multiply_batch(const eml_number *a, const eml_number *b, eml_number *products, uint32_t count);
+void eml_number_compare_batch(const eml_number *a, const eml_number *b, int32_t *order, uint32_t count);
+uint64_t eml_number_sum_batch(const eml_number *values, uint32_t count);
+
+uint64_t eml_hash(eml_result *result);
+eml_bool eml_equal(eml_result *a, eml_result *b);
+
+int eml_work_table_create(eml_work_table **table);
+int eml_work_intern(eml_work_table *table, eml_result *result);
+void eml_work_table_stats(eml_work_table *table, eml_work_stats *stats);
+void eml_work_table_free(eml_work_table *table);
+
+int eml_template_compile(const char *text, uint32_t length, eml_template **tmpl);
+uint32_t eml_template_slots(eml_template *tmpl);
+int eml_template_instantiate(eml_template *tmpl, const eml_number *values, uint32_t count, eml_result **result);
+int eml_template_write(eml_template *tmpl, const eml_number *values, uint32_t count, char *buffer, uint32_t capacity, uint32_t *length);
+void eml_template_free(eml_template *tmpl);
+
+int eml_diff(eml_result *planned, eml_result *performed, eml_difference *differences, uint32_t capacity, uint32_t *found);
+
+int eml_csv_open(const char **columns, uint32_t count, eml_csv_rows rows, eml_csv_sink sink, void *context, eml_csv_writer **csv);
+int eml_csv_write(eml_csv_writer *csv, const char *data, uint32_t length);
+int eml_csv_close(eml_csv_writer *csv);
+
+int eml_lazy_open(char *eml_string, uint32_t length, eml_lazy **lazy);
+eml_header_t *eml_lazy_header(eml_lazy *lazy);
+uint32_t eml_lazy_count(eml_lazy *lazy);
+const eml_lazy_entry *eml_lazy_at(eml_lazy *lazy, uint32_t i);
+int eml_lazy_object(eml_lazy *lazy, uint32_t i, eml_obj **obj);
+eml_bool eml_lazy_find(eml_lazy *lazy, const char *name, uint32_t from, uint32_t *i);
+void eml_lazy_free(eml_lazy *lazy);
+
+int eml_aggregates_create(eml_aggregates **aggregates);
+int eml_aggregates_add(eml_aggregates *aggregates, eml_session *session);
+uint32_t eml_aggregates_count(eml_aggregates *aggregates);
+const eml_aggregate *eml_aggregates_at(eml_aggregates *aggregates, uint32_t i);
+const eml_aggregate *eml_aggregates_find(eml_aggregates *aggregates, const char *name, eml_rollup_side side);
+int eml_aggregates_save(eml_aggregates *aggregates, const char *path);
+int eml_aggregates_load(const char *path, eml_aggregates **aggregates);
+void eml_aggregates_free(eml_aggregates *aggregates);
+
+void eml_query_init(eml_query *query);
+int eml_query_compile(eml_query *query, eml_compiled_query *compiled);
+int eml_query_run(eml_compiled_query *compiled, eml_result **results, uint32_t count, eml_query_match *matches, uint32_t capacity, uint32_t *found);
+
+int eml_index_build(char **documents, uint32_t count, const char *path);
+int eml_index_open(const char *path, eml_index **index);
+int eml_index_lookup(eml_index *index, const char *name, eml_posting *postings, uint32_t capacity, uint32_t *found);
+int eml_index_intersect(eml_index *index, const char **names, uint32_t count, uint32_t *docs, uint32_t capacity, uint32_t *found);
+void eml_index_close(eml_index *index);
+
+int eml_rollup_build(eml_session *sessions, uint32_t count, uint32_t threads, eml_rollup **rollup);
+void eml_rollup_free(eml_rollup *rollup);
+
+int eml_corpus_writer_open(const char *path, eml_corpus_writer **writer);
+int eml_corpus_writer_add(eml_corpus_writer *writer, const char *document, uint64_t length, uint64_t id);
+int eml_corpus_writer_close(eml_corpus_writer *writer);
+int eml_corpus_open(const char *path, eml_corpus **corpus);
+int eml_corpus_document(eml_corpus *corpus, uint64_t i, const char **document, uint64_t *length, uint64_t *id);
+int eml_corpus_parse(eml_corpus *corpus, uint64_t i, eml_result **result);
+void eml_corpus_split(eml_corpus *corpus, uint32_t part, uint32_t parts, uint64_t *begin, uint64_t *end);
+void eml_corpus_close(eml_corpus *corpus);
+
+int eml_log_open(const char *path, eml_bool durable, eml_log **log);
+int eml_log_append(eml_log *log, eml_result *result);
+int eml_log_replay(eml_log *log, int (*callback)(eml_result *result, void *context), void *context);
+void eml_log_close(eml_log *log);
+
+int eml_share(eml_result *result, eml_shared **shared);
+eml_result *eml_shared_result(eml_shared *shared);
+eml_shared *eml_shared_retain(eml_shared *shared);
+void eml_shared_release(eml_shared *shared);
+
+int eml_ingest(const char **paths, uint32_t count, uint32_t threads, eml_ingest_callback callback, void *context);
+
+void eml_stats_get(eml_stats *stats);
+void eml_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
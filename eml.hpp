@@ -0,0 +1,462 @@
+#ifndef EML_HPP
+#define EML_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "eml.h"
+
+/*
+ * eml.hpp - C++17 binding of the C API. Views (single, rep, ...) are a pointer into an eml_result wrapped with typed
+ *           accessors, so they cost nothing over the C structs & live as long as the result they came from. Names are
+ *           std::string_views of the result's strings.
+ *
+ *           eml::result r;
+ *           if (int error = eml::result::parse(text, r)) { ... }
+ *           for (eml::object o : r.objects()) {
+ *               if (auto s = std::get_if<eml::single>(&o)) { s->name(); s->work(); ... }
+ *           }
+ */
+
+namespace eml {
+
+class rep;
+class single;
+class superset;
+class circuit;
+
+/*
+ * object - A top level object of a result.
+ */
+using object = std::variant<single, superset, circuit>;
+
+namespace detail {
+
+rep view(const eml_reps *r) noexcept;
+single view(const eml_single_t *s) noexcept;
+object view(const eml_obj *o) noexcept;
+
+/*
+ * view_iterator - Iterates a C array of `T`, yielding the view of each element (see view()).
+ */
+template <typename T>
+class view_iterator {
+public:
+    using value_type = decltype(view(std::declval<const T *>()));
+    using reference = value_type;
+    using pointer = void;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::input_iterator_tag; // Yields views by value
+    using iterator_concept = std::forward_iterator_tag;
+
+    view_iterator() noexcept = default;
+    explicit view_iterator(const T *p) noexcept : p_(p) {}
+
+    value_type operator*() const noexcept { return view(p_); }
+    view_iterator &operator++() noexcept { ++p_; return *this; }
+    view_iterator operator++(int) noexcept { view_iterator i = *this; ++p_; return i; }
+
+    friend bool operator==(view_iterator a, view_iterator b) noexcept { return a.p_ == b.p_; }
+    friend bool operator!=(view_iterator a, view_iterator b) noexcept { return a.p_ != b.p_; }
+
+private:
+    const T *p_ = nullptr;
+};
+
+/*
+ * view_range - The `size()` elements of a C array of `T`, as views.
+ */
+template <typename T>
+class view_range {
+public:
+    using iterator = view_iterator<T>;
+
+    view_range() noexcept = default;
+    view_range(const T *first, std::size_t size) noexcept : first_(first), size_(size) {}
+
+    iterator begin() const noexcept { return iterator(first_); }
+    iterator end() const noexcept { return iterator(first_ + size_); }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    typename iterator::value_type operator[](std::size_t i) const noexcept { return view(first_ + i); }
+
+private:
+    const T     *first_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace detail
+
+/*
+ * rep - Reps (or seconds of a timeset) & their modifier. See eml_reps.
+ */
+class rep {
+public:
+    explicit rep(const eml_reps *r) noexcept : r_(r) {}
+
+    eml_number value() const noexcept { return r_->value; }
+    decltype(eml_reps::type) type() const noexcept { return r_->type; }
+
+    bool failure() const noexcept {
+        switch (r_->type) {
+        case eml_reps::unmodifiedFailure:
+        case eml_reps::unmodifiedTimeFailure:
+        case eml_reps::weightFailure:
+        case eml_reps::timeWeightFaliure:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool time() const noexcept {
+        switch (r_->type) {
+        case eml_reps::unmodifiedTime:
+        case eml_reps::unmodifiedTimeFailure:
+        case eml_reps::timeWeight:
+        case eml_reps::timeWeightFaliure:
+        case eml_reps::timeRPE:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::optional<eml_number> weight() const noexcept {
+        switch (r_->type) {
+        case eml_reps::weight:
+        case eml_reps::weightFailure:
+        case eml_reps::timeWeight:
+        case eml_reps::timeWeightFaliure:
+            return r_->modifier.weight;
+        default:
+            return std::nullopt;
+        }
+    }
+
+    std::optional<eml_number> rpe() const noexcept {
+        if (r_->type == eml_reps::rpe || r_->type == eml_reps::timeRPE) {
+            return r_->modifier.rpe;
+        }
+
+        return std::nullopt;
+    }
+
+    const eml_reps *get() const noexcept { return r_; }
+
+private:
+    const eml_reps *r_;
+};
+
+using reps_range = detail::view_range<eml_reps>;
+
+/*
+ * none_work - No work. See eml_none_k.
+ */
+class none_work {
+public:
+    explicit none_work(const eml_none_k *n) noexcept : n_(n) {}
+
+    const eml_none_k *get() const noexcept { return n_; }
+
+private:
+    const eml_none_k *n_;
+};
+
+/*
+ * standard_work - Sets of the same reps. See eml_standard_k.
+ */
+class standard_work {
+public:
+    explicit standard_work(const eml_standard_k *k) noexcept : k_(k) {}
+
+    uint32_t sets() const noexcept { return k_->sets; }
+    eml::rep rep() const noexcept { return eml::rep(&k_->reps); }
+    reps_range reps() const noexcept { return reps_range(&k_->reps, 1); }
+
+    const eml_standard_k *get() const noexcept { return k_; }
+
+private:
+    const eml_standard_k *k_;
+};
+
+/*
+ * varied_work - Sets of varying reps, one per set. See eml_standard_varied_k.
+ */
+class varied_work {
+public:
+    explicit varied_work(const eml_standard_varied_k *v) noexcept : v_(v) {}
+
+    uint32_t sets() const noexcept { return v_->sets; }
+    reps_range reps() const noexcept { return reps_range(v_->vReps, v_->sets); }
+
+    const eml_standard_varied_k *get() const noexcept { return v_; }
+
+private:
+    const eml_standard_varied_k *v_;
+};
+
+/*
+ * side_work - The work of one side of asymmetric work (std::monostate if it has none).
+ */
+using side_work = std::variant<std::monostate, none_work, standard_work, varied_work>;
+
+/*
+ * asymmetric_work - Separate left & right work. See eml_asymmetric_k.
+ */
+class asymmetric_work {
+public:
+    explicit asymmetric_work(const eml_asymmetric_k *a) noexcept : a_(a) {}
+
+    side_work left() const noexcept { return side(a_->left_none_k, a_->left_standard_k, a_->left_standard_varied_k); }
+    side_work right() const noexcept { return side(a_->right_none_k, a_->right_standard_k, a_->right_standard_varied_k); }
+
+    const eml_asymmetric_k *get() const noexcept { return a_; }
+
+private:
+    static side_work side(const eml_none_k *n, const eml_standard_k *k, const eml_standard_varied_k *v) noexcept {
+        if (n != nullptr) {
+            return none_work(n);
+        } else if (k != nullptr) {
+            return standard_work(k);
+        } else if (v != nullptr) {
+            return varied_work(v);
+        }
+
+        return std::monostate();
+    }
+
+    const eml_asymmetric_k *a_;
+};
+
+/*
+ * work - The work of a single (std::monostate if it has none).
+ */
+using work = std::variant<std::monostate, none_work, standard_work, varied_work, asymmetric_work>;
+
+/*
+ * single - An exercise & its work. See eml_single_t.
+ */
+class single {
+public:
+    explicit single(const eml_single_t *s) noexcept : s_(s) {}
+
+    std::string_view name() const noexcept { return s_->name; }
+
+    eml::work work() const noexcept {
+        if (s_->asymmetric_work != nullptr) {
+            return asymmetric_work(s_->asymmetric_work);
+        } else if (s_->no_work != nullptr) {
+            return none_work(s_->no_work);
+        } else if (s_->standard_work != nullptr) {
+            return standard_work(s_->standard_work);
+        } else if (s_->standard_varied_work != nullptr) {
+            return varied_work(s_->standard_varied_work);
+        }
+
+        return std::monostate();
+    }
+
+    const eml_single_t *get() const noexcept { return s_; }
+
+private:
+    const eml_single_t *s_;
+};
+
+using members_range = detail::view_range<eml_single_t>;
+
+/*
+ * superset - Singles done back to back. See eml_super_t.
+ */
+class superset {
+public:
+    explicit superset(const eml_super_t *s) noexcept : s_(s) {}
+
+    members_range members() const noexcept { return members_range(s_->members, s_->count); }
+
+    const eml_super_t *get() const noexcept { return s_; }
+
+private:
+    const eml_super_t *s_;
+};
+
+/*
+ * circuit - Singles done as a circuit. See eml_circuit_t.
+ */
+class circuit {
+public:
+    explicit circuit(const eml_circuit_t *c) noexcept : c_(c) {}
+
+    members_range members() const noexcept { return members_range(c_->members, c_->count); }
+
+    const eml_circuit_t *get() const noexcept { return c_; }
+
+private:
+    const eml_circuit_t *c_;
+};
+
+using objects_range = detail::view_range<eml_obj>;
+
+/*
+ * header - A header parameter & its value.
+ */
+struct header {
+    std::string_view parameter;
+    std::string_view value;
+};
+
+/*
+ * headers_range - The header of a result, in the order of its list.
+ */
+class headers_range {
+public:
+    class iterator {
+    public:
+        using value_type = header;
+        using reference = header;
+        using pointer = void;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() noexcept = default;
+        explicit iterator(const eml_header_t *h) noexcept : h_(h) {}
+
+        header operator*() const noexcept { return header{h_->parameter, h_->value}; }
+        iterator &operator++() noexcept { h_ = h_->next; return *this; }
+        iterator operator++(int) noexcept { iterator i = *this; h_ = h_->next; return i; }
+
+        friend bool operator==(iterator a, iterator b) noexcept { return a.h_ == b.h_; }
+        friend bool operator!=(iterator a, iterator b) noexcept { return a.h_ != b.h_; }
+
+    private:
+        const eml_header_t *h_ = nullptr;
+    };
+
+    explicit headers_range(const eml_header_t *first) noexcept : first_(first) {}
+
+    iterator begin() const noexcept { return iterator(first_); }
+    iterator end() const noexcept { return iterator(); }
+
+private:
+    const eml_header_t *first_;
+};
+
+/*
+ * result - Owns an eml_result, freeing it on destruction. Move-only; empty after being moved from.
+ */
+class result {
+public:
+    result() noexcept = default;
+    explicit result(eml_result *r) noexcept : r_(r) {}
+    result(result &&other) noexcept : r_(std::exchange(other.r_, nullptr)) {}
+    result(const result &) = delete;
+    result &operator=(const result &) = delete;
+
+    result &operator=(result &&other) noexcept {
+        if (this != &other) {
+            free_result(r_);
+            r_ = std::exchange(other.r_, nullptr);
+        }
+
+        return *this;
+    }
+
+    ~result() { free_result(r_); }
+
+    /*
+     * parse: Parses `text` into `out` (see parse_length()). Returns an eml_error, leaving `out` empty on error.
+     */
+    static int parse(std::string_view text, result &out) noexcept {
+        eml_result *r = nullptr;
+
+        if (text.size() > UINT32_MAX) {
+            return out_of_range_error;
+        }
+
+        // parse_length() only reads its text
+        int error = parse_length(const_cast<char *>(text.data()), (uint32_t)text.size(), &r);
+        out = result(r);
+        return error;
+    }
+
+    /*
+     * parse_exact: Like parse(), with the result in one allocation (see parse_exact()).
+     */
+    static int parse_exact(std::string_view text, result &out) noexcept {
+        eml_result *r = nullptr;
+
+        if (text.size() > UINT32_MAX) {
+            return out_of_range_error;
+        }
+
+        int error = ::parse_exact(const_cast<char *>(text.data()), (uint32_t)text.size(), &r);
+        out = result(r);
+        return error;
+    }
+
+    explicit operator bool() const noexcept { return r_ != nullptr; }
+
+    eml_result *get() const noexcept { return r_; }
+    eml_result *release() noexcept { return std::exchange(r_, nullptr); }
+
+    objects_range objects() const noexcept { return objects_range(r_->objs, r_->count); }
+    headers_range headers() const noexcept { return headers_range(r_->header); }
+
+    /*
+     * header: Returns the value of header `parameter`, or an empty string_view without one. Of repeated headers the
+     *         first declared (the last listed) is the one the parser uses.
+     */
+    std::string_view header(std::string_view parameter) const noexcept {
+        std::string_view value;
+
+        for (eml::header h : headers()) {
+            if (h.parameter == parameter) {
+                value = h.value;
+            }
+        }
+
+        return value;
+    }
+
+    uint64_t hash() const noexcept { return eml_hash(r_); }
+    int convert_weight(const char *unit) noexcept { return eml_convert_weight(r_, unit); }
+
+    friend bool operator==(const result &a, const result &b) noexcept { return eml_equal(a.r_, b.r_); }
+    friend bool operator!=(const result &a, const result &b) noexcept { return !eml_equal(a.r_, b.r_); }
+
+private:
+    eml_result *r_ = nullptr;
+};
+
+namespace detail {
+
+inline rep view(const eml_reps *r) noexcept {
+    return rep(r);
+}
+
+inline single view(const eml_single_t *s) noexcept {
+    return single(s);
+}
+
+inline object view(const eml_obj *o) noexcept {
+    switch (o->type) {
+    case ::super:
+        return superset(&o->data.super);
+    case ::circuit:
+        return circuit(&o->data.circuit);
+    default:
+        return single(&o->data.single);
+    }
+}
+
+} // namespace detail
+
+} // namespace eml
+
+#endif
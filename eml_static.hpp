@@ -0,0 +1,830 @@
+#ifndef EML_STATIC_HPP
+#define EML_STATIC_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "eml.h"
+
+/*
+ * eml_static.hpp - Parses EML string literals at compile time (C++17), into fixed size structures with no heap & no
+ *                  startup parse. The grammar is that of parse(): a literal parse() rejects fails to compile with the
+ *                  same eml_error.
+ *
+ *                  constexpr auto program = EML_STATIC("{\"version\":\"1.0\",\"weight\":\"lbs\"}\"squat\":5x5@120;");
+ *
+ *                  A program is laid out like an eml_frozen, with indices into its arrays in place of offsets.
+ */
+#define EML_STATIC(literal) (::eml::static_parse([] { return ::std::string_view(literal); }))
+
+namespace eml {
+
+/*
+ * static_program - A parsed literal: `header_count` headers, `count` objects & the singles, reps & strings (each
+ *                  terminated) they index. An eml_frozen_obj's `singles`, an eml_frozen_single's `name`, ... are indices
+ *                  into `singles`, `strings`, ...
+ */
+template <uint32_t Headers, uint32_t Objects, uint32_t Singles, uint32_t Reps, uint32_t Strings>
+struct static_program {
+    std::array<eml_frozen_header, Headers> headers{};
+    std::array<eml_frozen_obj, Objects>    objs{};
+    std::array<eml_frozen_single, Singles> singles{};
+    std::array<eml_reps, Reps>             reps{};
+    std::array<char, Strings>              strings{};
+
+    uint32_t header_count = 0;
+    uint32_t count = 0;
+    uint32_t single_count = 0;
+    uint32_t reps_count = 0;
+    uint32_t string_length = 0;
+
+    int      error = no_error;
+    uint32_t error_offset = 0;
+
+    /*
+     * string: Returns the string at index `i` of `strings`.
+     */
+    constexpr std::string_view string(uint32_t i) const {
+        return std::string_view(strings.data() + i);
+    }
+
+    /*
+     * header: Returns the value of header `parameter`, or an empty string_view without one.
+     */
+    constexpr std::string_view header(std::string_view parameter) const {
+        for (uint32_t i = 0; i < header_count; i++) {
+            if (string(headers[i].parameter) == parameter) {
+                return string(headers[i].value);
+            }
+        }
+
+        return std::string_view();
+    }
+
+    /*
+     * members: Returns the `o.count` singles of an object.
+     */
+    constexpr const eml_frozen_single *members(const eml_frozen_obj &o) const {
+        return singles.data() + o.singles;
+    }
+
+    /*
+     * work_reps: Returns the `w.count` reps of some work.
+     */
+    constexpr const eml_reps *work_reps(const eml_frozen_work &w) const {
+        return reps.data() + w.reps;
+    }
+};
+
+namespace detail {
+
+using reps_type = decltype(eml_reps::type);
+
+/*
+ * draft_work - Work of a single being parsed, mirroring eml_single_t's no_work, standard_work & standard_varied_work
+ *              (reps indices, or -1 for none).
+ */
+struct draft_work {
+    bool     none = false;
+    int64_t  standard = -1;
+    uint32_t standard_sets = 0;
+    int64_t  varied = -1;
+    uint32_t varied_sets = 0;
+};
+
+/*
+ * static_parser - parse_length() & the functions it calls, over a static_program `P` with room enough for the literal.
+ */
+template <typename P>
+struct static_parser {
+    std::string_view s;
+    uint32_t         position = 0;
+    P                &out;
+    bool             version = false;
+    bool             weight_unit = false;
+
+    constexpr static_parser(std::string_view text, P &program) : s(text), out(program) {}
+
+    /*
+     * reps_alloc: Takes `count` unmodified reps, returning the first's index, or -1 once there is no room.
+     */
+    constexpr int64_t reps_alloc(uint64_t count) {
+        if (count > out.reps.size() - out.reps_count) {
+            return -1;
+        }
+
+        int64_t first = out.reps_count;
+        for (uint32_t i = 0; i < count; i++) {
+            out.reps[out.reps_count].value = 0;
+            out.reps[out.reps_count].modifier.weight = 0;
+            out.reps[out.reps_count].type = eml_reps::unmodified;
+            out.reps_count++;
+        }
+
+        return first;
+    }
+
+    /*
+     * parse: See parse_length().
+     */
+    constexpr int parse() {
+        int error = no_error;
+
+        while (position < s.size()) {
+            switch (s[position]) {
+            case '{':
+                // As parse_length(), an error within the header is overlooked (the document then rarely parses on)
+                parse_header();
+
+                if (!version) {
+                    return missing_version;
+                }
+
+                if (!weight_unit) {
+                    return missing_weight_unit;
+                }
+                break;
+            case 's':
+            case 'c':
+                if (out.count == out.objs.size()) {
+                    return allocation_error;
+                }
+
+                out.objs[out.count].type = s[position] == 's' ? ::super : ::circuit;
+                out.objs[out.count].singles = out.single_count;
+                if ((error = parse_super_t(out.objs[out.count++]))) {
+                    return error;
+                }
+                break;
+            case '"':
+                if (out.count == out.objs.size() || out.single_count == out.singles.size()) {
+                    return allocation_error;
+                }
+
+                out.objs[out.count].type = ::single;
+                out.objs[out.count].singles = out.single_count;
+                out.objs[out.count++].count = 1;
+                if ((error = parse_single_t(out.singles[out.single_count++]))) {
+                    return error;
+                }
+                break;
+            case ';':
+                ++position;
+                break;
+            default:
+                return unexpected_error;
+            }
+        }
+
+        return no_error;
+    }
+
+    /*
+     * parse_header: See parse_header(). Notes whether there is a version & weight unit, as validate_header_t() does.
+     */
+    constexpr int parse_header() {
+        int error = no_error;
+
+        if (s[position++] != '{') {
+            return missing_header_start_char;
+        }
+
+        while (position < s.size()) {
+            switch (s[position]) {
+            case '}':
+                ++position;
+                return no_error;
+            case ',':
+                ++position;
+                break;
+            case '"':
+                if (out.header_count == out.headers.size()) {
+                    return allocation_error;
+                }
+
+                if ((error = parse_header_t(out.headers[out.header_count]))) {
+                    return error;
+                }
+
+                version = version || out.string(out.headers[out.header_count].parameter) == "version";
+                weight_unit = weight_unit || out.string(out.headers[out.header_count].parameter) == "weight";
+                out.header_count++;
+                break;
+            default:
+                return unexpected_error;
+            }
+        }
+
+        return unexpected_error;
+    }
+
+    /*
+     * parse_header_t: See parse_header_t(). A header needs both a parameter & a value.
+     */
+    constexpr int parse_header_t(eml_frozen_header &h) {
+        int error = no_error;
+        bool pv = false;
+        bool parameter = false;
+        bool value = false;
+
+        while (position < s.size()) {
+            switch (s[position]) {
+            case '}':
+            case ',':
+                return parameter && value ? no_error : unexpected_error;
+            case ':':
+                pv = true;
+                ++position;
+                break;
+            case '"':
+                // A second string where one was already read is a missing ':' or ','
+                if (pv ? value : parameter) {
+                    return unexpected_error;
+                }
+
+                if ((error = parse_string(pv ? h.value : h.parameter))) {
+                    return error;
+                }
+
+                (pv ? value : parameter) = true;
+                break;
+            default:
+                return unexpected_error;
+            }
+        }
+
+        return unexpected_error;
+    }
+
+    /*
+     * parse_string: See parse_string().
+     */
+    constexpr int parse_string(eml_offset &str) {
+        uint32_t length = 0;
+
+        ++position;
+        while (position < s.size()) {
+            if (s[position] == '"') {
+                ++position;
+
+                if (length == 0) {
+                    return empty_string_error;
+                }
+
+                if (length + 1 > out.strings.size() - out.string_length) {
+                    return allocation_error;
+                }
+
+                str = out.string_length;
+                for (uint32_t i = 0; i < length; i++) {
+                    out.strings[out.string_length++] = s[position - 1 - length + i];
+                }
+                out.strings[out.string_length++] = '\0';
+                return no_error;
+            }
+
+            if (length > 127) {
+                return string_length_error;
+            }
+
+            length++;
+            ++position;
+        }
+
+        return unexpected_error;
+    }
+
+    /*
+     * parse_super_t: See parse_super_t(). Members are parsed into consecutive singles.
+     */
+    constexpr int parse_super_t(eml_frozen_obj &o) {
+        int error = no_error;
+
+        while (position < s.size()) {
+            switch (s[position]) {
+            case '"':
+                if (out.single_count == out.singles.size()) {
+                    return allocation_error;
+                }
+
+                o.count++;
+                if ((error = parse_single_t(out.singles[out.single_count++]))) {
+                    return error;
+                }
+                break;
+            case ')':
+                ++position;
+                return no_error;
+            default: // '(' & the rest of "super" / "circuit"
+                ++position;
+                break;
+            }
+        }
+
+        return unexpected_error;
+    }
+
+    /*
+     * move_work: See move_to_asymmetric(). Returns the first of none, standard & varied work `w` has & takes it from `w`.
+     */
+    constexpr eml_frozen_work move_work(draft_work &w) {
+        eml_frozen_work f{};
+
+        if (w.none) {
+            f.kind = frozen_none;
+            w.none = false;
+        } else if (w.standard >= 0) {
+            f.kind = frozen_standard;
+            f.sets = w.standard_sets;
+            f.count = 1;
+            f.reps = w.standard;
+            w.standard = -1;
+        } else if (w.varied >= 0) {
+            f.kind = frozen_standard_varied;
+            f.sets = f.count = w.varied_sets;
+            f.reps = w.varied;
+            w.varied = -1;
+        }
+
+        return f;
+    }
+
+    /*
+     * upgrade_to_standard_varied: See upgrade_to_standard_varied().
+     */
+    constexpr int upgrade_to_standard_varied(draft_work &w, uint32_t sets) {
+        if ((w.varied = reps_alloc(sets)) < 0) {
+            return allocation_error;
+        }
+
+        w.varied_sets = sets;
+        w.standard = -1;
+        return no_error;
+    }
+
+    /*
+     * parse_single_t: See parse_single_t(). Where parse_single_t() would reach through missing work (',' outside varied
+     *                 reps, ...) this is an unexpected_error, & a rep past a varied work's sets an extra_variable_reps_error.
+     */
+    constexpr int parse_single_t(eml_frozen_single &f) {
+        int error = no_error;
+        draft_work w;
+
+        f.asymmetric = false;
+        f.left_work = eml_frozen_work{};
+        f.right_work = eml_frozen_work{};
+
+        if ((error = parse_string(f.name))) {
+            return error;
+        }
+
+        eml_kind_flag kind = none;
+        eml_modifier_flag modifier = no_mod;
+
+        eml_number buffer_int = 0;
+        uint32_t dcount = 0;
+        uint32_t vcount = 0;
+        uint32_t temp = 0;
+
+        if (position >= s.size() || s[position++] != ':') {
+            return name_work_separator_error;
+        }
+
+        while (position < s.size()) {
+            char current = s[position];
+
+            switch (current) {
+            case '"':
+                ++position;
+                break;
+            case ':':
+                if (f.asymmetric) {
+                    return unexpected_error;
+                }
+
+                if (kind == standard_varied && vcount < w.varied_sets) {
+                    return missing_variable_reps_error;
+                }
+
+                if ((error = flush(w, nullptr, kind, modifier, buffer_int, dcount))) {
+                    return error;
+                }
+
+                modifier = no_mod;
+                kind = none;
+
+                f.asymmetric = true;
+                f.left_work = move_work(w);
+                f.right_work = eml_frozen_work{};
+
+                ++position;
+                break;
+            case 'x':
+                if (kind != none) {
+                    return unexpected_error;
+                }
+
+                if (position + 1 < s.size() && s[position + 1] == '(') {
+                    if ((error = upgrade_to_standard_varied(w, buffer_int))) {
+                        return error;
+                    }
+                } else {
+                    if ((w.standard = reps_alloc(1)) < 0) {
+                        return allocation_error;
+                    }
+                    w.standard_sets = buffer_int;
+                }
+
+                buffer_int = 0;
+                kind = standard;
+
+                ++position;
+                break;
+            case '(':
+                if (w.varied < 0) {
+                    if (w.standard < 0) {
+                        return unexpected_error;
+                    }
+
+                    if ((error = upgrade_to_standard_varied(w, w.standard_sets))) {
+                        return error;
+                    }
+                }
+
+                vcount = 0;
+                kind = standard_varied;
+
+                ++position;
+                break;
+            case ',':
+            case ')':
+                if (kind != standard_varied || w.varied < 0) {
+                    return unexpected_error;
+                }
+
+                if (vcount >= w.varied_sets) {
+                    return extra_variable_reps_error;
+                }
+
+                if ((error = flush(w, &vcount, kind, modifier, buffer_int, dcount))) {
+                    return error;
+                }
+
+                vcount++;
+                modifier = no_mod;
+
+                if (current == ')' && vcount < w.varied_sets) {
+                    return missing_variable_reps_error;
+                }
+
+                ++position;
+                break;
+            case 'F':
+            case 'T':
+                switch (kind) {
+                case none:
+                    return current == 'F' ? none_work_to_failure_error : modifier_on_none_work_error;
+                case standard:
+                    if (w.standard < 0) {
+                        return unexpected_error;
+                    }
+
+                    if ((error = applying_reps_type(out.reps[w.standard], current == 'F' ? eml_reps::unmodifiedFailure : eml_reps::unmodifiedTime))) {
+                        return error;
+                    }
+                    break;
+                case standard_varied:
+                    if (vcount >= w.varied_sets) {
+                        return current == 'F' ? to_failure_used_as_macro_error : time_macro_error;
+                    }
+
+                    if ((error = applying_reps_type(out.reps[w.varied + vcount], current == 'F' ? eml_reps::unmodifiedFailure : eml_reps::unmodifiedTime))) {
+                        return error;
+                    }
+                    break;
+                }
+
+                ++position;
+                break;
+            case '@':
+            case '%':
+                switch (kind) {
+                case none:
+                    return modifier_on_none_work_error;
+                case standard:
+                    if (w.standard < 0) {
+                        return unexpected_error;
+                    }
+
+                    out.reps[w.standard].value = buffer_int;
+                    break;
+                case standard_varied:
+                    if (vcount < w.varied_sets) {
+                        out.reps[w.varied + vcount].value = buffer_int;
+                    }
+                    break;
+                }
+
+                buffer_int = 0;
+                dcount = 0;
+                modifier = current == '@' ? weight_mod : rpe_mod;
+
+                ++position;
+                break;
+            case '.':
+                if (kind == none) {
+                    return fractional_sets_error;
+                }
+
+                if (dcount) {
+                    return multiple_radix_points_error;
+                }
+
+                if (modifier == no_mod) {
+                    return fractional_none_modifier_value_error;
+                }
+
+                buffer_int = buffer_int * 100U | eml_number_H;
+
+                ++dcount;
+                ++position;
+                break;
+            case ';':
+                if (kind == standard_varied && vcount < w.varied_sets) {
+                    return missing_variable_reps_error;
+                }
+
+                if ((error = flush(w, nullptr, kind, modifier, buffer_int, dcount))) {
+                    return error;
+                }
+
+                if (f.asymmetric) {
+                    f.right_work = move_work(w);
+                } else {
+                    f.left_work = move_work(w);
+                }
+
+                ++position;
+                return no_error;
+            default:
+                // As parse_single_t(), any other byte is taken for a digit
+                switch (dcount) {
+                case 0:
+                    temp = buffer_int * 10U + (uint32_t)(int)current - '0';
+
+                    if (temp > 21474836U) {
+                        return integral_overflow_error;
+                    }
+
+                    buffer_int = temp;
+                    break;
+                case 1:
+                case 2:
+                    temp = buffer_int + ((uint32_t)(int)current - '0') * (dcount == 1 ? 10U : 1U);
+
+                    if ((temp & eml_number_mask) > 2147483647U) {
+                        return fp_overflow_error;
+                    }
+
+                    buffer_int = temp;
+                    dcount++;
+                    break;
+                default:
+                    return too_many_fp_digits;
+                }
+
+                ++position;
+                break;
+            }
+        }
+
+        return unexpected_error;
+    }
+
+    /*
+     * applying_reps_type: See applying_reps_type().
+     */
+    static constexpr int applying_reps_type(eml_reps &r, reps_type t) {
+        switch (r.type) {
+        case eml_reps::unmodified:
+            switch (t) {
+            case eml_reps::unmodifiedFailure:
+            case eml_reps::unmodifiedTime:
+            case eml_reps::weight:
+            case eml_reps::rpe:
+                r.type = t;
+                return no_error;
+            default:
+                return bad_reps_type_transition;
+            }
+        case eml_reps::unmodifiedFailure:
+            switch (t) {
+            case eml_reps::unmodifiedTime:
+                r.type = eml_reps::unmodifiedTimeFailure;
+                return no_error;
+            case eml_reps::weight:
+                r.type = eml_reps::weightFailure;
+                return no_error;
+            case eml_reps::rpe:
+                return rpe_to_failure;
+            default:
+                return bad_reps_type_transition;
+            }
+        case eml_reps::unmodifiedTime:
+            switch (t) {
+            case eml_reps::unmodifiedFailure:
+                r.type = eml_reps::unmodifiedTimeFailure;
+                return no_error;
+            case eml_reps::weight:
+                r.type = eml_reps::timeWeight;
+                return no_error;
+            case eml_reps::rpe:
+                r.type = eml_reps::timeRPE;
+                return no_error;
+            default:
+                return bad_reps_type_transition;
+            }
+        case eml_reps::unmodifiedTimeFailure:
+            switch (t) {
+            case eml_reps::weight:
+                r.type = eml_reps::timeWeightFaliure;
+                return no_error;
+            case eml_reps::rpe:
+                return rpe_to_failure;
+            default:
+                return bad_reps_type_transition;
+            }
+        default:
+            return bad_reps_type_transition;
+        }
+    }
+
+    /*
+     * modify: Applies modifier `mod` with value `buf` to `r`, as flush() does.
+     */
+    static constexpr int modify(eml_reps &r, eml_modifier_flag mod, eml_number buf) {
+        int error = no_error;
+
+        switch (mod) {
+        case no_mod:
+            r.value = buf;
+            break;
+        case weight_mod:
+        case rpe_mod:
+            if ((error = applying_reps_type(r, mod == weight_mod ? eml_reps::weight : eml_reps::rpe))) {
+                return error;
+            }
+            r.modifier.weight = buf; // The weight & rpe of the union alike, as only one member is active in constexpr
+            break;
+        }
+
+        return no_error;
+    }
+
+    /*
+     * flush: See flush().
+     */
+    constexpr int flush(draft_work &w, uint32_t *vcount, eml_kind_flag kind, eml_modifier_flag mod, eml_number &buf, uint32_t &dcount) {
+        int error = no_error;
+
+        if (dcount == 1) {
+            return missing_digit_following_radix_error;
+        }
+
+        switch (kind) {
+        case none:
+            if (mod != no_mod) {
+                return modifier_on_none_work_error;
+            }
+
+            w.none = true;
+            break;
+        case standard:
+            if (w.standard < 0) {
+                return unexpected_error;
+            }
+
+            if ((error = modify(out.reps[w.standard], mod, buf))) {
+                return error;
+            }
+            break;
+        case standard_varied:
+            if (vcount != nullptr) {
+                if ((error = modify(out.reps[w.varied + *vcount], mod, buf))) {
+                    return error;
+                }
+                break;
+            }
+
+            // A macro modifier, applied to the reps without one
+            for (uint32_t i = 0; i < w.varied_sets && mod != no_mod; i++) {
+                eml_reps &r = out.reps[w.varied + i];
+
+                switch (r.type) {
+                case eml_reps::unmodified:
+                case eml_reps::unmodifiedTime:
+                    break;
+                case eml_reps::unmodifiedFailure:
+                case eml_reps::unmodifiedTimeFailure:
+                    if (mod == rpe_mod) {
+                        return rpe_to_failure;
+                    }
+                    break;
+                default:
+                    continue;
+                }
+
+                if ((error = modify(r, mod, buf))) {
+                    return error;
+                }
+            }
+            break;
+        }
+
+        buf = 0;
+        dcount = 0;
+        return no_error;
+    }
+};
+
+/*
+ * draft_program - Room for anything a literal of `Length` bytes could parse to.
+ */
+template <uint32_t Length>
+using draft_program = static_program<Length / 4 + 1, Length / 2 + 1, Length / 2 + 1, Length + 1, Length + 1>;
+
+/*
+ * parse_draft: Parses `text` (`Length` bytes) into a draft_program.
+ */
+template <uint32_t Length>
+constexpr draft_program<Length> parse_draft(std::string_view text) {
+    draft_program<Length> draft{};
+    static_parser<draft_program<Length>> parser(text, draft);
+
+    draft.error = parser.parse();
+    draft.error_offset = parser.position;
+    return draft;
+}
+
+/*
+ * static_error - Fails to compile for a literal that does not parse, naming its eml_error & the byte it was found at.
+ */
+template <int Error, uint32_t Offset>
+struct static_error {
+    static_assert(Error == no_error, "EML literal does not parse: see static_error<eml_error, offset>");
+    static constexpr bool ok = true;
+};
+
+/*
+ * exact: Copies the used part of a draft into a program of exactly its size.
+ */
+template <typename P, typename D>
+constexpr P exact(const D &draft) {
+    P program{};
+
+    for (uint32_t i = 0; i < program.headers.size(); i++) {
+        program.headers[i] = draft.headers[i];
+    }
+
+    for (uint32_t i = 0; i < program.objs.size(); i++) {
+        program.objs[i] = draft.objs[i];
+    }
+
+    for (uint32_t i = 0; i < program.singles.size(); i++) {
+        program.singles[i] = draft.singles[i];
+    }
+
+    for (uint32_t i = 0; i < program.reps.size(); i++) {
+        program.reps[i] = draft.reps[i];
+    }
+
+    for (uint32_t i = 0; i < program.strings.size(); i++) {
+        program.strings[i] = draft.strings[i];
+    }
+
+    program.header_count = draft.header_count;
+    program.count = draft.count;
+    program.single_count = draft.single_count;
+    program.reps_count = draft.reps_count;
+    program.string_length = draft.string_length;
+    return program;
+}
+
+} // namespace detail
+
+/*
+ * static_parse: Parses the literal `literal()` returns (see EML_STATIC) into a static_program of exactly its size.
+ */
+template <typename Literal>
+constexpr auto static_parse(Literal literal) {
+    constexpr std::string_view text = literal();
+    constexpr auto draft = detail::parse_draft<text.size()>(text);
+    static_assert(detail::static_error<draft.error, draft.error_offset>::ok);
+
+    return detail::exact<static_program<draft.header_count, draft.count, draft.single_count, draft.reps_count, draft.string_length>>(draft);
+}
+
+} // namespace eml
+
+#endif
@@ -0,0 +1,776 @@
+#include "eml.c"
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * emld: Local parse service. Listens on a Unix domain socket & parses EML documents for any number of pipelining
+ *       clients, batching requests across a pool of workers.
+ *
+ *       Build: cc -O2 -pthread emld.c -o emld
+ *       Run:   ./emld [socket path] [workers]
+ *
+ * Frames are little-endian uint32s followed by a payload:
+ * request  - length, id, format, then `length` bytes of EML (format_stats sends no document)
+ * response - length, id, status (eml_error), offset (where parsing stopped when status is set), then `length` bytes:
+ *            format_binary - the eml_frozen block of the result (see eml_freeze())
+ *            format_json - the result as JSON
+ *            format_stats - the service's counters, latency percentiles & queue depth as JSON
+ * Responses carry the id of their request & may arrive out of order. A connection is not read from while it has
+ * EMLD_MAX_IN_FLIGHT requests unanswered, or while the service holds EMLD_MAX_PENDING (or EMLD_MAX_PENDING_BYTES of)
+ * requests, so clients that outpace the workers are slowed rather than queued without bound. A document counts against
+ * the service only once it is read whole, so a client that stops mid document holds up only its own connection.
+ */
+
+#define EMLD_SOCKET_PATH "/tmp/emld.sock"
+#define EMLD_REQUEST_HEADER_LENGTH 12
+#define EMLD_RESPONSE_HEADER_LENGTH 16
+
+// Largest document accepted; larger ones are skipped & answered with out_of_range_error
+#define EMLD_MAX_DOCUMENT (16 * 1024 * 1024)
+
+// Requests a worker takes off the queue at a time
+#define EMLD_BATCH_SIZE 32
+
+// Requests of one connection being read, queued or served at once; its reader waits for responses past this
+#define EMLD_MAX_IN_FLIGHT 64
+
+// Requests (& their document bytes, once read) admitted across all connections at once; readers wait for room past either
+#define EMLD_MAX_PENDING 1024
+#define EMLD_MAX_PENDING_BYTES (256 * 1024 * 1024)
+
+// Latencies kept for the percentiles (the most recent ones)
+#define EMLD_LATENCY_SAMPLES 4096
+
+typedef enum EmldFormat { format_binary, format_json, format_stats } emld_format;
+
+/*
+ * emld_connection - A client. Referenced by its reader & each of its queued requests; the last release closes it.
+ *                   `write_lock` keeps the responses of concurrent workers whole & guards `in_flight`, the
+ *                   connection's requests not yet answered, which workers signal `drained` as they lower.
+ */
+typedef struct EmldConnection {
+    int                  fd;
+    pthread_mutex_t      write_lock;
+    pthread_cond_t       drained;
+    uint32_t             in_flight;
+    atomic_uint_fast32_t references;
+} emld_connection;
+
+/*
+ * emld_request - A queued document. `received` is its arrival time in nanoseconds.
+ */
+typedef struct EmldRequest {
+    struct EmldRequest *next;
+    emld_connection    *connection;
+    uint32_t           id;
+    uint32_t           format;
+    uint32_t           length;
+    uint64_t           received;
+    char               document[];
+} emld_request;
+
+/*
+ * emld_queue - Requests waiting for a worker. `max_depth` is the deepest the queue has been. `pending` & `bytes`
+ *              count the requests admitted by emld_admit() (& their documents) until emld_retire(); readers wait on
+ *              `space` for them to fall.
+ */
+typedef struct EmldQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;
+    pthread_cond_t  space;
+    emld_request    *head;
+    emld_request    *tail;
+    uint32_t        depth;
+    uint32_t        max_depth;
+    uint32_t        pending;
+    uint64_t        bytes;
+} emld_queue;
+
+/*
+ * emld_counters - Service counters. `latencies` is a ring of the most recent request latencies in nanoseconds.
+ */
+typedef struct EmldCounters {
+    pthread_mutex_t lock;
+    uint64_t        requests;
+    uint64_t        errors;
+    uint64_t        batches;
+    uint64_t        latencies[EMLD_LATENCY_SAMPLES];
+} emld_counters;
+
+static emld_queue queue = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0, 0, 0, 0};
+static emld_counters counters = {PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, {0}};
+
+static const char *reps_type_names[] = {
+    "unmodified", "unmodifiedFailure", "unmodifiedTime", "unmodifiedTimeFailure", "weight", "weightFailure",
+    "timeWeight", "timeWeightFailure", "rpe", "timeRPE"
+};
+
+static uint64_t emld_now(void);
+static void put_u32(uint8_t *p, uint32_t v);
+static uint32_t get_u32(const uint8_t *p);
+static bool read_full(int fd, void *data, uint64_t length);
+static bool write_full(int fd, const void *data, uint64_t length);
+
+static void emld_connection_release(emld_connection *c);
+static void emld_admit(emld_connection *c, uint32_t length);
+static void emld_retire(emld_connection *c, uint64_t length, uint32_t n);
+static void emld_enqueue(emld_request *r);
+static uint32_t emld_dequeue(emld_request **batch, uint32_t capacity);
+
+static int json_printf(byte_buffer *b, const char *format, ...);
+static uint32_t utf8_length(const unsigned char *p);
+static int json_string(byte_buffer *b, const char *str);
+static int json_number(byte_buffer *b, eml_number n);
+static int json_work(byte_buffer *b, eml_single_t *s, bool side);
+static int json_single_t(byte_buffer *b, eml_single_t *s);
+static int json_result(byte_buffer *b, eml_result *result);
+static int json_counters(byte_buffer *b);
+static int compare_latency(const void *a, const void *b);
+
+static int emld_serve(emld_request *r, byte_buffer *out);
+static void emld_record(emld_request **batch, uint32_t n, uint32_t errors);
+static void *emld_worker(void *arg);
+static void *emld_reader(void *arg);
+
+int main(int argc, char const *argv[]) {
+    const char *path = argc > 1 ? argv[1] : EMLD_SOCKET_PATH;
+    long workers = argc > 2 ? atol(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    struct sockaddr_un address;
+
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "emld: socket path too long\n");
+        return 1;
+    }
+
+    // A client hanging up mid-response is handled where the write fails
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("emld: socket");
+        return 1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        perror("emld: bind");
+        return 1;
+    }
+
+    for (long i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, emld_worker, NULL) != 0) {
+            perror("emld: worker");
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+
+    fprintf(stderr, "emld: listening on %s with %ld workers\n", path, workers);
+
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        emld_connection *c = malloc(sizeof(emld_connection));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->in_flight = 0;
+        pthread_mutex_init(&c->write_lock, NULL);
+        pthread_cond_init(&c->drained, NULL);
+        atomic_init(&c->references, 1);
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, emld_reader, c) != 0) {
+            emld_connection_release(c);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+/*
+ * emld_now: Monotonic time in nanoseconds.
+ */
+static uint64_t emld_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/*
+ * put_u32, get_u32: Little-endian frame fields.
+ */
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/*
+ * read_full: Reads exactly `length` bytes. False on EOF or error.
+ */
+static bool read_full(int fd, void *data, uint64_t length) {
+    while (length > 0) {
+        ssize_t n = read(fd, data, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        data = (char *)data + n;
+        length -= n;
+    }
+
+    return true;
+}
+
+/*
+ * write_full: Writes exactly `length` bytes. False once the client is gone.
+ */
+static bool write_full(int fd, const void *data, uint64_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return false;
+        }
+
+        data = (const char *)data + n;
+        length -= n;
+    }
+
+    return true;
+}
+
+/*
+ * emld_connection_release: Drops a reference to `c`, closing it with the last one.
+ */
+static void emld_connection_release(emld_connection *c) {
+    if (atomic_fetch_sub_explicit(&c->references, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    close(c->fd);
+    pthread_mutex_destroy(&c->write_lock);
+    pthread_cond_destroy(&c->drained);
+    free(c);
+}
+
+/*
+ * emld_admit: Waits until connection `c` & the service both have room for another request of `length` bytes, then
+ *             counts it against both. A lone request is always admitted, however long.
+ */
+static void emld_admit(emld_connection *c, uint32_t length) {
+    pthread_mutex_lock(&c->write_lock);
+    while (c->in_flight >= EMLD_MAX_IN_FLIGHT) {
+        pthread_cond_wait(&c->drained, &c->write_lock);
+    }
+    c->in_flight++;
+    pthread_mutex_unlock(&c->write_lock);
+
+    pthread_mutex_lock(&queue.lock);
+    while (queue.pending >= EMLD_MAX_PENDING || (queue.pending > 0 && queue.bytes + length > EMLD_MAX_PENDING_BYTES)) {
+        pthread_cond_wait(&queue.space, &queue.lock);
+    }
+    queue.pending++;
+    queue.bytes += length;
+    pthread_mutex_unlock(&queue.lock);
+}
+
+/*
+ * emld_retire: Uncounts `n` answered requests of connection `c` holding `length` bytes in all.
+ */
+static void emld_retire(emld_connection *c, uint64_t length, uint32_t n) {
+    pthread_mutex_lock(&queue.lock);
+    queue.pending -= n;
+    queue.bytes -= length;
+    pthread_cond_broadcast(&queue.space);
+    pthread_mutex_unlock(&queue.lock);
+
+    pthread_mutex_lock(&c->write_lock);
+    c->in_flight -= n;
+    pthread_cond_signal(&c->drained);
+    pthread_mutex_unlock(&c->write_lock);
+}
+
+/*
+ * emld_enqueue: Queues a request for the workers.
+ */
+static void emld_enqueue(emld_request *r) {
+    r->next = NULL;
+
+    pthread_mutex_lock(&queue.lock);
+    if (queue.tail == NULL) {
+        queue.head = r;
+    } else {
+        queue.tail->next = r;
+    }
+    queue.tail = r;
+
+    if (++queue.depth > queue.max_depth) {
+        queue.max_depth = queue.depth;
+    }
+
+    pthread_cond_signal(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+/*
+ * emld_dequeue: Waits for requests & takes up to `capacity` of them, grouped by connection (in arrival order within
+ *               each) so a connection's responses go out in one write.
+ */
+static uint32_t emld_dequeue(emld_request **batch, uint32_t capacity) {
+    uint32_t n = 0;
+
+    pthread_mutex_lock(&queue.lock);
+    while (queue.head == NULL) {
+        pthread_cond_wait(&queue.ready, &queue.lock);
+    }
+
+    while (queue.head != NULL && n < capacity) {
+        batch[n++] = queue.head;
+        queue.head = queue.head->next;
+        queue.depth--;
+    }
+
+    if (queue.head == NULL) {
+        queue.tail = NULL;
+    }
+    pthread_mutex_unlock(&queue.lock);
+
+    // Stable insertion sort by connection; batches are small
+    for (uint32_t i = 1; i < n; i++) {
+        emld_request *r = batch[i];
+        uint32_t j = i;
+
+        while (j > 0 && (uintptr_t)batch[j - 1]->connection > (uintptr_t)r->connection) {
+            batch[j] = batch[j - 1];
+            j--;
+        }
+        batch[j] = r;
+    }
+
+    return n;
+}
+
+/*
+ * json_printf: Appends formatted text (short: numbers & punctuation) to `b`.
+ */
+static int json_printf(byte_buffer *b, const char *format, ...) {
+    char text[64];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    return buffer_bytes(b, text, n < (int)sizeof(text) ? n : (int)sizeof(text) - 1);
+}
+
+/*
+ * utf8_length: Returns the length of the well-formed UTF-8 sequence starting at `p` (a byte >= 0x80), or 0 if it is
+ *              not one: a stray continuation, a truncated or overlong sequence, a surrogate or past U+10FFFF.
+ */
+static uint32_t utf8_length(const unsigned char *p) {
+    uint32_t length, code;
+
+    if (p[0] >= 0xC2 && p[0] <= 0xDF) {
+        length = 2;
+        code = p[0] & 0x1F;
+    } else if (p[0] >= 0xE0 && p[0] <= 0xEF) {
+        length = 3;
+        code = p[0] & 0x0F;
+    } else if (p[0] >= 0xF0 && p[0] <= 0xF4) {
+        length = 4;
+        code = p[0] & 0x07;
+    } else {
+        return 0;
+    }
+
+    // The terminator is not a continuation, so a truncated sequence stops at it
+    for (uint32_t i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        code = code << 6 | (p[i] & 0x3F);
+    }
+
+    if ((length == 3 && code < 0x800) || (length == 4 && (code < 0x10000 || code > 0x10FFFF))
+        || (code >= 0xD800 && code <= 0xDFFF)) {
+        return 0;
+    }
+
+    return length;
+}
+
+/*
+ * json_string: Appends `str` as a JSON string. Bytes that are not well-formed UTF-8 become U+FFFD.
+ */
+static int json_string(byte_buffer *b, const char *str) {
+    int error = buffer_bytes(b, "\"", 1);
+
+    for (const char *p = str; *p != '\0' && error == no_error; p++) {
+        uint32_t length;
+
+        if (*p == '"' || *p == '\\') {
+            error = json_printf(b, "\\%c", *p);
+        } else if ((unsigned char)*p < 0x20) {
+            error = json_printf(b, "\\u%04x", (unsigned char)*p);
+        } else if ((unsigned char)*p < 0x80) {
+            error = buffer_bytes(b, p, 1);
+        } else if ((length = utf8_length((const unsigned char *)p)) > 0) {
+            error = buffer_bytes(b, p, length);
+            p += length - 1;
+        } else {
+            error = buffer_bytes(b, "\\ufffd", 6);
+        }
+    }
+
+    return error ? error : buffer_bytes(b, "\"", 1);
+}
+
+/*
+ * json_number: Appends an eml_number as a JSON number.
+ */
+static int json_number(byte_buffer *b, eml_number n) {
+    char text[MAX_FORMATTED_EML_STRING_LENGTH];
+
+    format_eml_number(&n, text);
+    return buffer_bytes(b, text, strlen(text));
+}
+
+/*
+ * json_work: Appends one side's work: null (no work on this side), {"kind":"none"} or its sets & reps.
+ */
+static int json_work(byte_buffer *b, eml_single_t *s, bool side) {
+    uint32_t sets, count;
+    uint32_t kind = work_kind(s, side, &sets);
+    eml_reps *reps = work_reps(s, side, &count);
+    int error = no_error;
+
+    switch (kind) {
+        case frozen_absent:
+            return json_printf(b, "null");
+        case frozen_none:
+            return json_printf(b, "{\"kind\":\"none\"}");
+    }
+
+    error = json_printf(b, "{\"kind\":\"%s\",\"sets\":%u,\"reps\":[", kind == frozen_standard ? "standard" : "standard_varied", sets);
+
+    for (uint32_t i = 0; i < count && error == no_error; i++) {
+        error = json_printf(b, "%s{\"type\":\"%s\",\"value\":", i ? "," : "", reps_type_names[reps[i].type]);
+        error = error ? error : json_number(b, reps[i].value);
+
+        if (error == no_error && reps_has_modifier(&reps[i])) {
+            error = json_printf(b, ",\"%s\":", reps_has_weight(&reps[i]) ? "weight" : "rpe");
+            error = error ? error : json_number(b, reps[i].modifier.weight);
+        }
+
+        error = error ? error : json_printf(b, "}");
+    }
+
+    return error ? error : json_printf(b, "]}");
+}
+
+/*
+ * json_single_t: Appends {"name":..., "work":...} or, for asymmetric work, {"name":..., "left":..., "right":...}.
+ */
+static int json_single_t(byte_buffer *b, eml_single_t *s) {
+    int error = json_printf(b, "{\"name\":");
+    error = error ? error : json_string(b, s->name);
+
+    if (s->asymmetric_work == NULL) {
+        error = error ? error : json_printf(b, ",\"work\":");
+        error = error ? error : json_work(b, s, left);
+    } else {
+        error = error ? error : json_printf(b, ",\"left\":");
+        error = error ? error : json_work(b, s, left);
+        error = error ? error : json_printf(b, ",\"right\":");
+        error = error ? error : json_work(b, s, right);
+    }
+
+    return error ? error : json_printf(b, "}");
+}
+
+/*
+ * json_result: Appends {"header":{...},"objects":[...]}. Supers & circuits list their singles in "members".
+ */
+static int json_result(byte_buffer *b, eml_result *result) {
+    int error = json_printf(b, "{\"header\":{");
+
+    for (eml_header_t *h = result->header; h != NULL && error == no_error; h = h->next) {
+        error = h != result->header ? json_printf(b, ",") : no_error;
+        error = error ? error : json_string(b, h->parameter);
+        error = error ? error : json_printf(b, ":");
+        error = error ? error : json_string(b, h->value);
+    }
+
+    error = error ? error : json_printf(b, "},\"objects\":[");
+
+    for (uint32_t i = 0; i < result->count && error == no_error; i++) {
+        eml_obj *o = &result->objs[i];
+        error = i ? json_printf(b, ",") : no_error;
+
+        if (o->type == single) {
+            error = error ? error : json_single_t(b, &o->data.single);
+            continue;
+        }
+
+        error = error ? error : json_printf(b, "{\"type\":\"%s\",\"members\":[", o->type == super ? "super" : "circuit");
+        for (uint32_t j = 0; j < o->data.super.count && error == no_error; j++) {
+            error = j ? json_printf(b, ",") : no_error;
+            error = error ? error : json_single_t(b, &o->data.super.members[j]);
+        }
+        error = error ? error : json_printf(b, "]}");
+    }
+
+    return error ? error : json_printf(b, "]}");
+}
+
+/*
+ * compare_latency: qsort comparator for uint64_t latencies.
+ */
+static int compare_latency(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * json_counters: Appends the service's counters, queue depth & latency percentiles (in nanoseconds) of the most
+ *                recent EMLD_LATENCY_SAMPLES requests.
+ */
+static int json_counters(byte_buffer *b) {
+    static _Thread_local uint64_t sorted[EMLD_LATENCY_SAMPLES];
+    uint64_t requests, errors, batches, samples;
+    uint32_t depth, max_depth;
+
+    pthread_mutex_lock(&counters.lock);
+    requests = counters.requests;
+    errors = counters.errors;
+    batches = counters.batches;
+    samples = requests < EMLD_LATENCY_SAMPLES ? requests : EMLD_LATENCY_SAMPLES;
+    memcpy(sorted, counters.latencies, sizeof(uint64_t) * samples);
+    pthread_mutex_unlock(&counters.lock);
+
+    pthread_mutex_lock(&queue.lock);
+    depth = queue.depth;
+    max_depth = queue.max_depth;
+    pthread_mutex_unlock(&queue.lock);
+
+    qsort(sorted, samples, sizeof(uint64_t), compare_latency);
+
+    #define PERCENTILE(p) (samples ? (unsigned long long)sorted[(samples - 1) * (p) / 100] : 0ULL)
+    int error = json_printf(b, "{\"requests\":%llu,\"errors\":%llu,\"batches\":%llu,", (unsigned long long)requests,
+        (unsigned long long)errors, (unsigned long long)batches);
+    error = error ? error : json_printf(b, "\"queue_depth\":%u,\"max_queue_depth\":%u,", depth, max_depth);
+    error = error ? error : json_printf(b, "\"latency_ns\":{\"p50\":%llu,\"p90\":%llu,", PERCENTILE(50), PERCENTILE(90));
+    error = error ? error : json_printf(b, "\"p99\":%llu,\"max\":%llu}}", PERCENTILE(99), PERCENTILE(100));
+    #undef PERCENTILE
+
+    return error;
+}
+
+/*
+ * emld_serve: Parses a request & appends its response frame to `out`. Returns the request's eml_error.
+ */
+static int emld_serve(emld_request *r, byte_buffer *out) {
+    uint64_t start = out->length;
+    uint32_t offset = 0;
+    eml_result *result = NULL;
+    eml_frozen *frozen = NULL;
+    int error = no_error;
+
+    if ((error = buffer_reserve(out, EMLD_RESPONSE_HEADER_LENGTH))) {
+        return error;
+    }
+    out->length += EMLD_RESPONSE_HEADER_LENGTH;
+
+    switch (r->format) {
+        case format_stats:
+            error = json_counters(out);
+            break;
+        case format_binary:
+        case format_json:
+            if ((error = parse_length(r->document, r->length, &result))) {
+                offset = parse_error_offset();
+                break;
+            }
+
+            if (r->format == format_json) {
+                error = json_result(out, result);
+            } else if ((error = eml_freeze(result, &frozen)) == no_error) {
+                error = buffer_bytes(out, frozen, frozen->size);
+                free(frozen);
+            }
+
+            free_result(result);
+            break;
+        default:
+            error = unexpected_error;
+            break;
+    }
+
+    // Errors answer with the header alone
+    if (error) {
+        out->length = start + EMLD_RESPONSE_HEADER_LENGTH;
+    }
+
+    put_u32(out->data + start, out->length - start - EMLD_RESPONSE_HEADER_LENGTH);
+    put_u32(out->data + start + 4, r->id);
+    put_u32(out->data + start + 8, error);
+    put_u32(out->data + start + 12, offset);
+    return error;
+}
+
+/*
+ * emld_record: Counts a finished batch & the latencies of its requests.
+ */
+static void emld_record(emld_request **batch, uint32_t n, uint32_t errors) {
+    uint64_t now = emld_now();
+
+    pthread_mutex_lock(&counters.lock);
+    for (uint32_t i = 0; i < n; i++) {
+        counters.latencies[counters.requests++ % EMLD_LATENCY_SAMPLES] = now - batch[i]->received;
+    }
+    counters.errors += errors;
+    counters.batches++;
+    pthread_mutex_unlock(&counters.lock);
+}
+
+/*
+ * emld_worker: Serves batches of requests, writing each connection's responses in one write.
+ */
+static void *emld_worker(void *arg) {
+    (void)arg;
+    emld_request *batch[EMLD_BATCH_SIZE];
+    byte_buffer out = {NULL, 0, 0};
+
+    for (;;) {
+        uint32_t n = emld_dequeue(batch, EMLD_BATCH_SIZE);
+        uint32_t errors = 0;
+
+        for (uint32_t i = 0; i < n;) {
+            emld_connection *c = batch[i]->connection;
+            uint32_t end = i;
+
+            out.length = 0;
+            for (; end < n && batch[end]->connection == c; end++) {
+                if (emld_serve(batch[end], &out)) {
+                    errors++;
+                }
+            }
+
+            pthread_mutex_lock(&c->write_lock);
+            write_full(c->fd, out.data, out.length);
+            pthread_mutex_unlock(&c->write_lock);
+
+            uint64_t length = 0;
+            for (uint32_t j = i; j < end; j++) {
+                length += batch[j]->length;
+            }
+            emld_retire(c, length, end - i);
+
+            i = end;
+        }
+
+        emld_record(batch, n, errors);
+
+        for (uint32_t i = 0; i < n; i++) {
+            emld_connection_release(batch[i]->connection);
+            free(batch[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * emld_reader: Reads a connection's request frames onto the queue until the client hangs up.
+ */
+static void *emld_reader(void *arg) {
+    emld_connection *c = arg;
+    uint8_t header[EMLD_REQUEST_HEADER_LENGTH];
+
+    while (read_full(c->fd, header, EMLD_REQUEST_HEADER_LENGTH)) {
+        uint32_t length = get_u32(header);
+        uint32_t id = get_u32(header + 4);
+
+        if (length > EMLD_MAX_DOCUMENT) {
+            uint8_t response[EMLD_RESPONSE_HEADER_LENGTH];
+            char discard[4096];
+            bool open = true;
+
+            // Skip the document so the next frame lines up
+            while (length > 0 && open) {
+                uint32_t chunk = length < sizeof(discard) ? length : sizeof(discard);
+                open = read_full(c->fd, discard, chunk);
+                length -= chunk;
+            }
+
+            put_u32(response, 0);
+            put_u32(response + 4, id);
+            put_u32(response + 8, out_of_range_error);
+            put_u32(response + 12, 0);
+
+            pthread_mutex_lock(&c->write_lock);
+            write_full(c->fd, response, sizeof(response));
+            pthread_mutex_unlock(&c->write_lock);
+
+            if (!open) {
+                break;
+            }
+            continue;
+        }
+
+        // Read whole before it is admitted: a stalled client holds at most EMLD_MAX_DOCUMENT of its own, never the
+        // service's room. Admission then waits, so slow workers hold back readers rather than fill memory.
+        emld_request *r = malloc(sizeof(emld_request) + length + 1);
+        if (r == NULL || !read_full(c->fd, r->document, length)) {
+            free(r);
+            break;
+        }
+
+        emld_admit(c, length);
+
+        r->connection = c;
+        r->id = id;
+        r->format = get_u32(header + 8);
+        r->length = length;
+        r->received = emld_now();
+        r->document[length] = '\0';
+
+        atomic_fetch_add_explicit(&c->references, 1, memory_order_relaxed);
+        emld_enqueue(r);
+    }
+
+    emld_connection_release(c);
+    return NULL;
+}
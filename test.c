@@ -1,6 +1,1503 @@
+#include <unistd.h>
+
+// fdatasync() fails while failed_syncs > 0, to test the paths of a failed sync
+static int failed_syncs = 0;
+static int test_fdatasync(int fd);
+#define fdatasync(fd) test_fdatasync(fd)
 #include "eml.c"
+#undef fdatasync
+#include <dirent.h>
+
+#define HEADER "{\"version\":\"1.0\",\"weight\":\"lbs\"}"
+
+static int test_fdatasync(int fd) {
+    if (failed_syncs > 0) {
+        failed_syncs--;
+        errno = EIO;
+        return -1;
+    }
+
+    return fdatasync(fd);
+}
+
+static int failures = 0;
+
+// Reports a failed expectation & keeps going, so one run lists every failure
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+/*
+ * parsed: Parses `text` (a whole document, header included) or returns NULL.
+ */
+static eml_result *parsed(const char *text) {
+    eml_result *result;
+    char *copy = strdup(text);
+    int error = parse(copy, &result);
+
+    free(copy);
+    return error ? NULL : result;
+}
+
+static char scratch[] = "/tmp/eml-test.XXXXXX";
+
+/*
+ * scratch_path: Returns the path of file `name` in the scratch directory (valid until the next call).
+ */
+static const char *scratch_path(const char *name) {
+    static char path[sizeof(scratch) + sizeof(((struct dirent *)NULL)->d_name)];
+
+    snprintf(path, sizeof(path), "%s/%s", scratch, name);
+    return path;
+}
+
+/*
+ * remove_scratch: Removes the scratch directory & the files the tests left in it.
+ */
+static void remove_scratch(void) {
+    DIR *dir = opendir(scratch);
+    struct dirent *entry;
+
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            unlink(scratch_path(entry->d_name));
+        }
+    }
+
+    if (dir != NULL) {
+        closedir(dir);
+    }
+    rmdir(scratch);
+}
+
+/*
+ * rewrite_file: Replaces file `path` with `length` bytes of `data`.
+ */
+static void rewrite_file(const char *path, const void *data, uint64_t length) {
+    FILE *file = fopen(path, "wb");
+
+    fwrite(data, 1, length, file);
+    fclose(file);
+}
+
+/*
+ * read_file: Returns the contents of file `path` (free() it) & sets `length`, or NULL.
+ */
+static uint8_t *read_file(const char *path, uint64_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    rewind(file);
+
+    uint8_t *data = malloc(*length + 1);
+    if (fread(data, 1, *length, file) != *length) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    return data;
+}
+
+// Documents covering each kind of work, modifier & object, for comparing the parsers with one another
+static const char *samples[] = {
+    HEADER,
+    HEADER "\"squat\":5x5;",
+    HEADER "\"squat\":5x(5,4,3,2,1)@100;\"plyo-jump\":5x40T;",
+    HEADER "\"sl-rdl\":4x(4,3@30,2,1)@120:3x(F,F,F)@55.5;",
+    HEADER "\"sl-rdl\"::4x(4,3,2,1);\"squat\":;\"squat\"::;",
+    HEADER "\"squat\":5x5%8.5;\"bench\":3x(5%7,4,3F)@102.25;",
+    "{\"version\":\"1.0\",\"weight\":\"kg\",\"coach\":\"sam\"}super(\"squat\":5x5@100;\"row\":3x8;);\"curl\":3x10;",
+    HEADER "circuit(\"squat\":5x5;\"lunge\":2x10:2x8;\"plank\":3x60T;);super(\"a\":1x1;);",
+};
+
+// Documents with an error, each at a different place
+static const char *broken_samples[] = {
+    HEADER "\"squat\"5x5;",
+    HEADER "\"squat\":5x(5,4);",
+    HEADER "\"squat\":5.5x5;",
+    HEADER "\"squat\":5x5@1.2.3;",
+    HEADER "\"squat\":5x5;\"bench\":3x",
+    HEADER "\"\":5x5;",
+    "{\"version\":\"1.0\",\"weight\":\"lbs\"\"squat\":5x5;",
+    HEADER "\"squat\":5x(5,4,3,2,1)@1,00;",
+    HEADER "\"squat\":5x5,5;",
+    HEADER "\"squat\":5x5@120.3x(1,2,3);",
+    HEADER "\"sl-rdl\":4x4:3x3:2x2;",
+    HEADER "\"squat\":3x(5,4;",
+    "{\"weight\"}",
+    "{\"version\"}",
+    "{\"weight\":}",
+};
+
+/*
+ * parse_error: Returns the error of parsing `text`.
+ */
+static int parse_error(const char *text) {
+    eml_result *result;
+    char *copy = strdup(text);
+    int error = parse(copy, &result);
+
+    if (error == no_error) {
+        free_result(result);
+    }
+    free(copy);
+    return error;
+}
+
+/*
+ * test_super_members: Members of supers & circuits live in one array that grows past its first capacity.
+ */
+static void test_super_members(void) {
+    char text[4096] = HEADER "super(";
+    for (int i = 0; i < 40; i++) {
+        sprintf(text + strlen(text), "\"e%d\":%dx5;", i, i + 1);
+    }
+    strcat(text, ");circuit(\"a\":1x1;);");
+
+    eml_result *result = parsed(text);
+    CHECK(result != NULL);
+    if (result == NULL) {
+        return;
+    }
+
+    CHECK(result->count == 2);
+    CHECK(result->objs[0].type == super && result->objs[0].data.super.count == 40);
+    CHECK(result->objs[0].data.super.capacity >= 40);
+    for (uint32_t i = 0; i < result->objs[0].data.super.count; i++) {
+        char name[16];
+        sprintf(name, "e%u", i);
+        CHECK(strcmp(result->objs[0].data.super.members[i].name, name) == 0);
+        CHECK(result->objs[0].data.super.members[i].standard_work->sets == i + 1);
+    }
+    CHECK(result->objs[1].type == circuit && result->objs[1].data.circuit.count == 1);
+    free_result(result);
+
+    // A member's error fails the document, its earlier members freed with it
+    CHECK(parse_error(HEADER "super(\"a\":1x1;\"b\"5x5;);") == name_work_separator_error);
+}
+
+/*
+ * test_result_objects: Top level objects are one array, indexable in document order.
+ */
+static void test_result_objects(void) {
+    char *text = malloc(64 * 1000 + sizeof(HEADER));
+    strcpy(text, HEADER);
+    for (int i = 0; i < 1000; i++) {
+        sprintf(text + strlen(text), i % 3 ? "\"x%d\":%dx1;" : "super(\"x%d\":%dx1;);", i, i + 1);
+    }
+
+    eml_result *result = parsed(text);
+    free(text);
+    CHECK(result != NULL && result->count == 1000 && result->capacity >= 1000);
+    for (uint32_t i = 0; result != NULL && i < result->count; i++) {
+        eml_obj *o = &result->objs[i];
+        eml_single_t *s = o->type == single ? &o->data.single : &o->data.super.members[0];
+
+        CHECK(o->type == (i % 3 ? single : super));
+        CHECK(s->standard_work != NULL && s->standard_work->sets == i + 1);
+    }
+
+    free_result(result);
+}
+
+/*
+ * test_frozen: A frozen result reads back in place & through a clone; validation rejects a damaged block.
+ */
+static void test_frozen(void) {
+    eml_result *result = parsed(HEADER "\"squat\":5x5@120;super(\"a\":3x(3,2,1);\"b\"::2x4;);");
+    eml_frozen *frozen, *clone;
+
+    CHECK(result != NULL && eml_freeze(result, &frozen) == no_error);
+    if (result == NULL) {
+        return;
+    }
+
+    CHECK(eml_frozen_validate(frozen, frozen->size) == no_error);
+    CHECK(eml_frozen_clone(frozen, &clone) == no_error);
+    CHECK(memcmp(frozen, clone, frozen->size) == 0);
+    free(frozen);
+
+    // The clone reads without fix-ups, whatever address it landed at
+    CHECK(clone->count == 2 && clone->header_count == 2);
+    const eml_frozen_obj *fo = eml_frozen_at(clone, clone->objs);
+    const eml_frozen_single *fs = eml_frozen_at(clone, fo[0].singles);
+    const eml_reps *reps = eml_frozen_at(clone, fs->left_work.reps);
+    CHECK(strcmp(eml_frozen_at(clone, fs->name), "squat") == 0);
+    CHECK(fs->left_work.kind == frozen_standard && fs->left_work.sets == 5 && reps->type == weight);
+    CHECK(fo[1].type == super && fo[1].count == 2);
+    fs = eml_frozen_at(clone, fo[1].singles);
+    CHECK(fs[0].left_work.kind == frozen_standard_varied && fs[0].left_work.count == 3);
+    CHECK(fs[1].asymmetric && fs[1].left_work.kind == frozen_none && fs[1].right_work.kind == frozen_standard);
+    CHECK(eml_frozen_at(clone, 0) == NULL);
+
+    // Truncated, bad magic & an offset past the end
+    CHECK(eml_frozen_validate(clone, clone->size - 1) == frozen_layout_error);
+    CHECK(eml_frozen_validate(clone, sizeof(eml_frozen) - 1) == frozen_layout_error);
+    clone->magic ^= 1;
+    CHECK(eml_frozen_validate(clone, clone->size) == frozen_layout_error);
+    clone->magic ^= 1;
+    clone->objs = clone->size;
+    CHECK(eml_frozen_validate(clone, clone->size) == frozen_layout_error);
+
+    free(clone);
+    free_result(result);
+}
+
+/*
+ * test_convert_weight: Weights convert between units with the header; duplicate headers follow the parser's rule.
+ */
+static void test_convert_weight(void) {
+    eml_result *a = parsed(HEADER "\"squat\":5x5@100;\"bench\":3x(5@50,5,5)@60;");
+    eml_result *b = parsed("{\"version\":\"1.0\",\"weight\":\"kg\"}\"row\":2x8@45.36;");
+    eml_result *c = parsed(HEADER "\"plank\":3x60T;");
+    CHECK(a != NULL && b != NULL && c != NULL);
+    if (a == NULL || b == NULL || c == NULL) {
+        return;
+    }
+
+    eml_result *batch[] = {a, b, c};
+    CHECK(eml_convert_weight_batch(batch, 3, "kg") == no_error);
+    CHECK(strcmp(find_header_t(a, "weight")->value, "kg") == 0 && strcmp(find_header_t(c, "weight")->value, "kg") == 0);
+    CHECK(eml_number_hundredths(a->objs[0].data.single.standard_work->reps.modifier.weight) == 4536);
+    CHECK(eml_number_hundredths(a->objs[1].data.single.standard_varied_work->vReps[0].modifier.weight) == 2268);
+    CHECK(eml_number_hundredths(b->objs[0].data.single.standard_work->reps.modifier.weight) == 4536);
+
+    // Already in the unit: nothing to do
+    CHECK(eml_convert_weight_batch(batch, 3, "kg") == no_error);
+    CHECK(eml_convert_weight(a, "stone") == unknown_weight_unit_error);
+    CHECK(eml_convert_weight(b, "lbs") == no_error);
+    CHECK(eml_number_hundredths(b->objs[0].data.single.standard_work->reps.modifier.weight) == 10000);
+
+    free_result(a);
+    free_result(b);
+    free_result(c);
+
+    // The first declared of repeated headers configures parsing, conversion & printing alike
+    eml_result *d = parsed("{\"version\":\"1.0\",\"weight\":\"kg\",\"weight\":\"lbs\"}\"squat\":1x1@100;");
+    CHECK(d != NULL && strcmp(find_header_t(d, "weight")->value, "kg") == 0);
+    CHECK(d != NULL && eml_convert_weight(d, "kg") == no_error);
+    CHECK(d != NULL && eml_number_hundredths(d->objs[0].data.single.standard_work->reps.modifier.weight) == 10000);
+
+    // Printing reads the result's unit, leaving the parser's alone
+    strcpy(weightUnit, "lbs");
+    print_result(d);
+    CHECK(strcmp(weightUnit, "lbs") == 0);
+    free_result(d);
+}
+
+/*
+ * test_hash_equal: Structural equality ignores header order & how a result was built; hashes follow equality.
+ */
+static void test_hash_equal(void) {
+    const char *body = "\"squat\":5x5@120;super(\"a\":3x(3,2F,1%8);\"b\":2x4:;);\"c\"::1x30T;";
+    char text[512], swapped[512];
+    sprintf(text, HEADER "%s", body);
+    sprintf(swapped, "{\"weight\":\"lbs\",\"version\":\"1.0\"}%s", body);
+
+    eml_result *a = parsed(text);
+    eml_result *b = parsed(swapped);
+    eml_result *c;
+    CHECK(parse_exact(text, strlen(text), &c) == no_error && c->block != NULL);
+    CHECK(a != NULL && b != NULL);
+    if (a == NULL || b == NULL) {
+        return;
+    }
+
+    CHECK(eml_equal(a, b) && eml_hash(a) == eml_hash(b));
+    CHECK(eml_equal(a, c) && eml_hash(a) == eml_hash(c));
+
+    // Each of these differs from `body` in one place
+    const char *others[] = {
+        "\"squat\":5x5@125;super(\"a\":3x(3,2F,1%8);\"b\":2x4:;);\"c\"::1x30T;",
+        "\"squat\":5x5@120;circuit(\"a\":3x(3,2F,1%8);\"b\":2x4:;);\"c\"::1x30T;",
+        "\"squat\":5x5@120;super(\"a\":3x(3,2,1%8);\"b\":2x4:;);\"c\"::1x30T;",
+        "\"squat\":5x5@120;super(\"a\":3x(3,2F,1%8);\"b\":2x4;);\"c\"::1x30T;",
+        "\"squat\":5x5@120;super(\"a\":3x(3,2F,1%8);\"b\":2x4:;);\"c\":1x30T;",
+        "\"squat\":5x5@120;super(\"a\":3x(3,2F,1%8););\"c\"::1x30T;",
+        "\"squat\":5x5@120;super(\"a\":3x(3,2F,1%8);\"b\":2x4:;);",
+    };
+    for (uint32_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+        char other[512];
+        sprintf(other, HEADER "%s", others[i]);
+
+        eml_result *d = parsed(other);
+        CHECK(d != NULL && !eml_equal(a, d) && !eml_equal(d, a) && eml_hash(a) != eml_hash(d));
+        free_result(d);
+    }
+
+    eml_result *e = parsed("{\"version\":\"1.0\",\"weight\":\"kg\"}\"squat\":5x5@120;");
+    CHECK(e != NULL && !eml_equal(a, e));
+    free_result(e);
+
+    free_result(a);
+    free_result(b);
+    free_result(c);
+}
+
+/*
+ * query_count: Runs `query` over `results` & returns how many singles match, or UINT32_MAX on an error.
+ */
+static uint32_t query_count(eml_query *query, eml_result **results, uint32_t count) {
+    eml_compiled_query compiled;
+    eml_query_match matches[1];
+    uint32_t found;
+
+    if (eml_query_compile(query, &compiled) || eml_query_run(&compiled, results, count, matches, 1, &found)) {
+        return UINT32_MAX;
+    }
+
+    return found;
+}
+
+/*
+ * test_query: Each predicate narrows matches; weight ranges are unit aware & kept apart from RPE.
+ */
+static void test_query(void) {
+    eml_result *lbs = parsed(HEADER "\"squat\":5x5@150;\"squat-pause\":3x3%9;super(\"squat\":1x8@100;\"row\"::3x10;);\"bench\":2x(5@140,3F@150);");
+    eml_result *kg = parsed("{\"version\":\"1.0\",\"weight\":\"kg\"}\"squat\":5x5@70;\"squat\":5x5@60;");
+    CHECK(lbs != NULL && kg != NULL);
+    if (lbs == NULL || kg == NULL) {
+        return;
+    }
+
+    eml_result *results[] = {lbs, kg};
+    eml_query q;
+
+    eml_query_init(&q);
+    CHECK(query_count(&q, results, 2) == 7);
+
+    q.name = "squat";
+    q.name_mode = exact_name;
+    CHECK(query_count(&q, results, 2) == 4);
+    q.name_mode = prefix_name;
+    CHECK(query_count(&q, results, 2) == 5);
+    q.objtypes = 1U << super;
+    CHECK(query_count(&q, results, 2) == 1);
+
+    eml_query_init(&q);
+    q.sides = asymmetric_sides;
+    CHECK(query_count(&q, results, 2) == 1);
+    q.sides = symmetric_sides;
+    q.kinds = 1U << frozen_standard_varied;
+    CHECK(query_count(&q, results, 2) == 1);
+
+    eml_query_init(&q);
+    q.reps_types = 1U << weightFailure;
+    CHECK(query_count(&q, results, 2) == 1);
+    q.reps_types = 0;
+    q.sets.min = q.sets.max = 5;
+    CHECK(query_count(&q, results, 2) == 3);
+
+    // A range over any modifier takes RPE 9 with weights of 9 lbs or kg
+    eml_query_init(&q);
+    q.modifier.min = 0;
+    q.modifier.max = 900;
+    CHECK(query_count(&q, results, 2) == 1);
+    q.modifier_kind = weight_modifier;
+    CHECK(query_count(&q, results, 2) == 0);
+    q.modifier_kind = rpe_modifier;
+    CHECK(query_count(&q, results, 2) == 1);
+
+    // At least 140 lbs: the squat & bench in lbs & 70 kg (154.32 lbs), not 100 lbs or 60 kg (132.28 lbs). As written,
+    // the kg weights are all under 140
+    eml_query_init(&q);
+    q.modifier_kind = weight_modifier;
+    q.modifier.min = 14000;
+    CHECK(query_count(&q, results, 2) == 2);
+    q.unit = "lbs";
+    CHECK(query_count(&q, results, 2) == 3);
+    q.unit = "kg";
+    q.modifier.min = 6350; // 140 lbs is 63.50 kg
+    CHECK(query_count(&q, results, 2) == 3);
+
+    // Matches past the capacity are still counted
+    eml_compiled_query compiled;
+    eml_query_match matches[2];
+    uint32_t found;
+    eml_query_init(&q);
+    CHECK(eml_query_compile(&q, &compiled) == no_error);
+    CHECK(eml_query_run(&compiled, results, 2, matches, 2, &found) == no_error && found == 7);
+    CHECK(matches[1].result == 0 && matches[1].obj == 1 && strcmp(matches[1].single->name, "squat-pause") == 0);
+
+    // Bad queries & results of an unknown unit
+    eml_query_init(&q);
+    q.name_mode = exact_name;
+    CHECK(eml_query_compile(&q, &compiled) == bad_query_error);
+    eml_query_init(&q);
+    q.reps.min = 2;
+    q.reps.max = 1;
+    CHECK(eml_query_compile(&q, &compiled) == bad_query_error);
+    eml_query_init(&q);
+    q.unit = "stone";
+    CHECK(eml_query_compile(&q, &compiled) == unknown_weight_unit_error);
+
+    eml_result *stone = parsed("{\"version\":\"1.0\",\"weight\":\"st\"}\"squat\":5x5@10;");
+    eml_query_init(&q);
+    q.modifier.min = 1;
+    q.unit = "kg";
+    CHECK(stone != NULL && query_count(&q, &stone, 1) == UINT32_MAX);
+    q.unit = NULL;
+    CHECK(stone != NULL && query_count(&q, &stone, 1) == 1);
+    free_result(stone);
+
+    free_result(lbs);
+    free_result(kg);
+}
+
+/*
+ * test_index: An index maps names to (doc, obj) postings & intersects documents; a damaged file is refused.
+ */
+static void test_index(void) {
+    char *documents[] = {
+        HEADER "\"squat\":5x5;\"bench\":3x5;",
+        HEADER "super(\"squat\":1x1;\"row\":1x1;);\"squat\":1x1;",
+        HEADER "circuit(\"bench\"::1x1;);",
+    };
+    const char *path = scratch_path("index");
+    eml_posting postings[4];
+    uint32_t docs[4];
+    uint32_t found;
+    eml_index *index;
+
+    CHECK(eml_index_build(documents, 3, path) == no_error);
+    CHECK(eml_index_open(path, &index) == no_error);
+    if (index == NULL) {
+        return;
+    }
+
+    CHECK(eml_index_lookup(index, "squat", postings, 4, &found) == no_error && found == 3);
+    CHECK(postings[0].doc == 0 && postings[0].obj == 0 && postings[0].flags == 0);
+    CHECK(postings[1].doc == 1 && postings[1].obj == 0 && postings[1].flags == posting_super);
+    CHECK(postings[2].doc == 1 && postings[2].obj == 1 && postings[2].flags == 0);
+    CHECK(eml_index_lookup(index, "bench", postings, 1, &found) == no_error && found == 2);
+    CHECK(postings[0].doc == 0);
+    CHECK(eml_index_lookup(index, "bench", postings, 4, &found) == no_error && found == 2);
+    CHECK(postings[1].doc == 2 && postings[1].flags == (posting_circuit | posting_asymmetric));
+    CHECK(eml_index_lookup(index, "deadlift", postings, 4, &found) == no_error && found == 0);
+
+    const char *both[] = {"squat", "bench"};
+    const char *none[] = {"row", "bench"};
+    CHECK(eml_index_intersect(index, both, 2, docs, 4, &found) == no_error && found == 1 && docs[0] == 0);
+    CHECK(eml_index_intersect(index, none, 2, docs, 4, &found) == no_error && found == 0);
+    eml_index_close(index);
+
+    // A bad magic, then a size that disagrees with the file
+    uint64_t length;
+    uint8_t *data = read_file(path, &length);
+    data[0] ^= 1;
+    rewrite_file(path, data, length);
+    CHECK(eml_index_open(path, &index) == index_format_error);
+    data[0] ^= 1;
+    rewrite_file(path, data, length - 1);
+    CHECK(eml_index_open(path, &index) == index_format_error);
+    rewrite_file(path, data, 4);
+    CHECK(eml_index_open(path, &index) == index_format_error);
+    free(data);
+
+    CHECK(eml_index_open(scratch_path("missing"), &index) == io_error);
+
+    // Documents without exercises index to a header alone
+    char *empty[] = {HEADER};
+    path = scratch_path("empty_index");
+    CHECK(eml_index_build(empty, 1, path) == no_error);
+    CHECK(eml_index_open(path, &index) == no_error);
+    if (index == NULL) {
+        return;
+    }
+
+    CHECK(eml_index_lookup(index, "squat", postings, 4, &found) == no_error && found == 0);
+    CHECK(eml_index_intersect(index, both, 2, docs, 4, &found) == no_error && found == 0);
+    eml_index_close(index);
+}
+
+/*
+ * test_corpus: Documents come back with their ids & parse in place; splits cover the table once; damage is refused.
+ */
+static void test_corpus(void) {
+    const char *documents[] = {
+        HEADER "\"squat\":5x5;",
+        HEADER "\"bench\":3x5@100;\"row\":3x8;",
+        HEADER "\"curl\":3x",
+    };
+    const char *path = scratch_path("corpus");
+    eml_corpus_writer *writer;
+    eml_corpus *corpus;
+
+    CHECK(eml_corpus_writer_open(path, &writer) == no_error);
+    for (uint64_t i = 0; i < 3; i++) {
+        CHECK(eml_corpus_writer_add(writer, documents[i], strlen(documents[i]), i + 10) == no_error);
+    }
+    CHECK(eml_corpus_writer_close(writer) == no_error);
+    CHECK(eml_corpus_open(path, &corpus) == no_error);
+    if (corpus == NULL) {
+        return;
+    }
+
+    const char *document = NULL;
+    uint64_t length = 0, id = 0;
+    CHECK(corpus->count == 3);
+    CHECK(eml_corpus_document(corpus, 1, &document, &length, &id) == no_error);
+    CHECK(length == strlen(documents[1]) && memcmp(document, documents[1], length) == 0 && document[length] == '\0' && id == 11);
+    CHECK(eml_corpus_document(corpus, 3, &document, NULL, NULL) == out_of_range_error);
+
+    eml_result *result;
+    CHECK(eml_corpus_parse(corpus, 1, &result) == no_error && result->count == 2);
+    free_result(result);
+    CHECK(eml_corpus_parse(corpus, 2, &result) != no_error);
+    CHECK(eml_corpus_parse(corpus, 3, &result) == out_of_range_error);
+
+    // Two parts cover every document once; a part past the last & zero parts are empty
+    uint64_t begin, end, next;
+    eml_corpus_split(corpus, 0, 2, &begin, &end);
+    eml_corpus_split(corpus, 1, 2, &next, &length);
+    CHECK(begin == 0 && end == next && length == 3);
+    eml_corpus_split(corpus, 2, 2, &begin, &end);
+    CHECK(begin == end);
+    eml_corpus_split(corpus, 0, 0, &begin, &end);
+    CHECK(begin == end);
+    eml_corpus_close(corpus);
+
+    // A bad magic, a cut table, then a file shorter than the header
+    uint8_t *data = read_file(path, &length);
+    data[0] ^= 1;
+    rewrite_file(path, data, length);
+    CHECK(eml_corpus_open(path, &corpus) == corpus_format_error);
+    data[0] ^= 1;
+    rewrite_file(path, data, length - 8);
+    CHECK(eml_corpus_open(path, &corpus) == corpus_format_error);
+    rewrite_file(path, data, 4);
+    CHECK(eml_corpus_open(path, &corpus) == corpus_format_error);
+    free(data);
+
+    CHECK(eml_corpus_open(scratch_path("missing"), &corpus) == io_error);
+
+    // Documents whose header tokens lack a value fail to parse, as parse() fails them
+    const char *headless[] = {"{\"weight\"}", "{\"version\"}", "{\"weight\":}\"squat\":5x5;"};
+    CHECK(eml_corpus_writer_open(path, &writer) == no_error);
+    for (uint64_t i = 0; i < 3; i++) {
+        CHECK(eml_corpus_writer_add(writer, headless[i], strlen(headless[i]), i) == no_error);
+    }
+    CHECK(eml_corpus_writer_close(writer) == no_error && eml_corpus_open(path, &corpus) == no_error);
+    for (uint64_t i = 0; corpus != NULL && i < 3; i++) {
+        int error = parse_error(headless[i]);
+        CHECK(error != no_error && eml_corpus_parse(corpus, i, &result) == error && result == NULL);
+    }
+    eml_corpus_close(corpus);
+}
+
+/*
+ * collect: eml_log_replay callback keeping up to 4 results in `context`, an array of 5 whose last slot counts them.
+ */
+static int collect(eml_result *result, void *context) {
+    eml_result **results = context;
+    uintptr_t count = (uintptr_t)results[4];
+
+    if (count < 4) {
+        results[count] = result;
+    } else {
+        free_result(result);
+    }
+    results[4] = (eml_result *)(count + 1);
+    return no_error;
+}
+
+/*
+ * test_log: Appended results replay equal; a torn tail, or a record that checksums but does not decode, is cut off
+ *           at open so replay never sees it; a bad magic is refused.
+ */
+static void test_log(void) {
+    eml_result *first = parsed(HEADER "\"squat\":5x5@100;super(\"row\":3x8;\"curl\":3x(10,8,6););");
+    eml_result *second = parsed(HEADER "\"squat\":1x1@120;\"lunge\":2x10:2x8;");
+    CHECK(first != NULL && second != NULL);
+    if (first == NULL || second == NULL) {
+        return;
+    }
+
+    const char *path = scratch_path("log");
+    eml_result *replayed[5] = {NULL};
+    eml_log *log;
+
+    CHECK(eml_log_open(path, false, &log) == no_error);
+    CHECK(eml_log_append(log, first) == no_error && eml_log_append(log, second) == no_error);
+    CHECK(eml_log_replay(log, collect, replayed) == no_error && (uintptr_t)replayed[4] == 2);
+    CHECK(eml_equal(replayed[0], first) && eml_equal(replayed[1], second));
+    eml_log_close(log);
+    free_result(replayed[0]);
+    free_result(replayed[1]);
+
+    uint64_t length;
+    uint8_t *data = read_file(path, &length);
+
+    // A torn tail: half of a third record
+    uint8_t *torn = malloc(length + 6);
+    memcpy(torn, data, length);
+    memcpy(torn + length, data + LOG_HEADER_LENGTH, 6);
+    rewrite_file(path, torn, length + 6);
+    memset(replayed, 0, sizeof(replayed));
+    CHECK(eml_log_open(path, false, &log) == no_error);
+    CHECK(eml_log_replay(log, collect, replayed) == no_error && (uintptr_t)replayed[4] == 2);
+    eml_log_close(log);
+    free_result(replayed[0]);
+    free_result(replayed[1]);
+    free(torn);
+
+    uint64_t truncated;
+    free(read_file(path, &truncated));
+    CHECK(truncated == length);
+
+    // No names, one header whose parameter is name 5, which was never introduced
+    uint8_t undecodable[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 5, 5};
+    uint32_t record[2] = {4, crc32(undecodable + 8, 4)};
+    memcpy(undecodable, record, sizeof(record));
+    torn = malloc(length + sizeof(undecodable));
+    memcpy(torn, data, length);
+    memcpy(torn + length, undecodable, sizeof(undecodable));
+    rewrite_file(path, torn, length + sizeof(undecodable));
+    memset(replayed, 0, sizeof(replayed));
+    CHECK(eml_log_open(path, false, &log) == no_error);
+    CHECK(eml_log_append(log, second) == no_error);
+    CHECK(eml_log_replay(log, collect, replayed) == no_error && (uintptr_t)replayed[4] == 3);
+    CHECK(replayed[2] != NULL && eml_equal(replayed[2], second));
+    eml_log_close(log);
+    for (uint32_t i = 0; i < 3; i++) {
+        free_result(replayed[i]);
+    }
+    free(torn);
+
+    data[0] ^= 1;
+    rewrite_file(path, data, length);
+    CHECK(eml_log_open(path, false, &log) == log_format_error);
+    free(data);
+
+    // A record whose sync fails is cut off & its names ("lunge") are not the log's; the next append replays whole
+    unlink(path);
+    memset(replayed, 0, sizeof(replayed));
+    CHECK(eml_log_open(path, true, &log) == no_error && eml_log_append(log, first) == no_error);
+    free(read_file(path, &length));
+    uint32_t names = log->names.count;
+    failed_syncs = 1;
+    CHECK(eml_log_append(log, second) == io_error && failed_syncs == 0);
+    free(read_file(path, &truncated));
+    CHECK(truncated == length && log->names.count == names);
+    CHECK(eml_log_append(log, second) == no_error && log->names.count == names + 1);
+    CHECK(eml_log_replay(log, collect, replayed) == no_error && (uintptr_t)replayed[4] == 2);
+    CHECK(replayed[1] != NULL && eml_equal(replayed[0], first) && eml_equal(replayed[1], second));
+    eml_log_close(log);
+    free_result(replayed[0]);
+    free_result(replayed[1]);
+
+    // A result without objects replays equal
+    eml_result *empty = parsed(HEADER);
+    unlink(path);
+    memset(replayed, 0, sizeof(replayed));
+    CHECK(empty != NULL && eml_log_open(path, false, &log) == no_error && eml_log_append(log, empty) == no_error);
+    CHECK(eml_log_replay(log, collect, replayed) == no_error && (uintptr_t)replayed[4] == 1);
+    CHECK(replayed[0] != NULL && replayed[0]->count == 0 && eml_equal(replayed[0], empty));
+    eml_log_close(log);
+    free_result(replayed[0]);
+    free_result(empty);
+
+    free_result(first);
+    free_result(second);
+}
+
+/*
+ * test_stats: A parse counts its objects, allocations & errors (only with -DEML_STATS, else all stay zero); this
+ *             file's own allocations are not counted.
+ */
+static void test_stats(void) {
+    int error = parse_error(HEADER "\"squat\":5x");
+    eml_stats stats;
+
+    eml_stats_reset();
+    CHECK(parse_error(HEADER "\"squat\":5x5;super(\"row\":3x8;\"curl\":3x(10,8,6););") == no_error);
+    CHECK(parse_error(HEADER "\"squat\":5x") == error);
+    eml_stats_get(&stats);
+
+    #ifdef EML_STATS
+        // The failed document's object is counted & freed too
+        CHECK(stats.objects == 3 && stats.singles == 4 && stats.supers == 1 && stats.circuits == 0);
+        CHECK(stats.upgrades_to_standard_varied == 1 && stats.free_results == 2 && stats.mallocs > 0);
+
+        uint64_t errors = 0;
+        for (uint32_t i = 0; i < EML_ERROR_COUNT; i++) {
+            errors += stats.errors[i];
+        }
+        CHECK(errors == 1 && stats.errors[error] == 1);
+
+        uint64_t mallocs = stats.mallocs;
+        free(calloc(1, 64));
+        eml_stats_get(&stats);
+        CHECK(stats.mallocs == mallocs);
+    #else
+        eml_stats zero;
+        memset(&zero, 0, sizeof(zero));
+        CHECK(memcmp(&stats, &zero, sizeof(stats)) == 0);
+    #endif
+
+    eml_stats_reset();
+    eml_stats_get(&stats);
+    CHECK(stats.mallocs == 0 && stats.objects == 0);
+}
+
+/*
+ * test_parse_exact: Every sample parses into one block equal to parse_length()'s result; errors are parse_length()'s.
+ */
+static void test_parse_exact(void) {
+    for (uint32_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        char *copy = strdup(samples[i]);
+        eml_result *expected = parsed(samples[i]);
+        eml_result *result;
+
+        CHECK(parse_exact(copy, strlen(copy), &result) == no_error && expected != NULL);
+        if (result != NULL && expected != NULL) {
+            CHECK(result->block != NULL && eml_equal(result, expected));
+            CHECK(eml_hash(result) == eml_hash(expected));
+            free_result(result);
+        }
+        free_result(expected);
+        free(copy);
+    }
+
+    for (uint32_t i = 0; i < sizeof(broken_samples) / sizeof(broken_samples[0]); i++) {
+        char *copy = strdup(broken_samples[i]);
+        int error = parse_error(broken_samples[i]);
+        uint32_t offset = parse_error_offset();
+        eml_result *result;
+
+        CHECK(error != no_error);
+        CHECK(parse_exact(copy, strlen(copy), &result) == error && parse_error_offset() == offset && result == NULL);
+        free(copy);
+    }
+
+    // Only the first `length` bytes are parsed
+    char document[] = HEADER "\"squat\":5x5;\"bench\":3x";
+    eml_result *result;
+    CHECK(parse_exact(document, strlen(document) - strlen("\"bench\":3x"), &result) == no_error && result->count == 1);
+    free_result(result);
+}
+
+/*
+ * shared_reader: Thread that hashes the shared result it was handed a reference to, then releases it.
+ */
+static void *shared_reader(void *context) {
+    eml_shared *shared = context;
+    uint64_t *hash = malloc(sizeof(uint64_t));
+
+    *hash = eml_hash(eml_shared_result(shared));
+    eml_shared_release(shared);
+    return hash;
+}
+
+/*
+ * test_shared: Readers on other threads see the sealed result & the last release, whichever thread it is on, frees it.
+ */
+static void test_shared(void) {
+    eml_result *result = parsed(samples[6]);
+    CHECK(result != NULL);
+    if (result == NULL) {
+        return;
+    }
+
+    uint64_t hash = eml_hash(result);
+    pthread_t threads[4];
+    eml_shared *shared;
+
+    CHECK(eml_share(result, &shared) == no_error && eml_shared_result(shared) == result);
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(pthread_create(&threads[i], NULL, shared_reader, eml_shared_retain(shared)) == 0);
+    }
+
+    // Dropping the first reference early leaves the result to the readers
+    eml_shared_release(shared);
+    for (uint32_t i = 0; i < 4; i++) {
+        uint64_t *seen;
+        pthread_join(threads[i], (void **)&seen);
+        CHECK(*seen == hash);
+        free(seen);
+    }
+
+    eml_shared_release(NULL);
+}
+
+// What eml_ingest() reported for each file of test_ingest
+typedef struct IngestSeen {
+    uint32_t calls;
+    int      error;
+    uint64_t hash;
+} ingest_seen;
+
+/*
+ * ingested: eml_ingest callback recording the error & hash of each file. Every file is its own slot, so no locking.
+ */
+static int ingested(uint32_t i, eml_result *result, int error, void *context) {
+    ingest_seen *seen = context;
+
+    seen[i].calls++;
+    seen[i].error = error;
+    if (result != NULL) {
+        seen[i].hash = eml_hash(result);
+        free_result(result);
+    }
+    return no_error;
+}
+
+/*
+ * stop_ingest: eml_ingest callback that stops at the first file.
+ */
+static int stop_ingest(uint32_t i, eml_result *result, int error, void *context) {
+    (void)i;
+    (void)error;
+    (void)context;
+    free_result(result);
+    return out_of_range_error;
+}
+
+/*
+ * test_ingest: More files than a worker keeps in flight are each parsed once, as parse() would, on any thread count;
+ *              a missing file is an io_error; a callback's non-zero return stops the ingest & is returned.
+ */
+static void test_ingest(void) {
+    enum { files = 80, count = sizeof(samples) / sizeof(samples[0]) };
+    char *paths[files];
+    ingest_seen seen[files];
+    uint64_t hashes[count];
+
+    for (uint32_t i = 0; i < count; i++) {
+        eml_result *result = parsed(samples[i]);
+        hashes[i] = result ? eml_hash(result) : 0;
+        free_result(result);
+    }
+
+    // Every seventh file is missing & every eleventh is broken
+    for (uint32_t i = 0; i < files; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "ingest-%u", i);
+        paths[i] = strdup(scratch_path(name));
+
+        const char *text = i % 11 == 10 ? broken_samples[0] : samples[i % count];
+        if (i % 7 != 6) {
+            rewrite_file(paths[i], text, strlen(text));
+        }
+    }
+
+    uint32_t threads[] = {1, 3, 0};
+    for (uint32_t t = 0; t < 3; t++) {
+        memset(seen, 0, sizeof(seen));
+        CHECK(eml_ingest((const char **)paths, files, threads[t], ingested, seen) == no_error);
+
+        for (uint32_t i = 0; i < files; i++) {
+            CHECK(seen[i].calls == 1);
+            if (i % 7 == 6) {
+                CHECK(seen[i].error == io_error);
+            } else if (i % 11 == 10) {
+                CHECK(seen[i].error == parse_error(broken_samples[0]));
+            } else {
+                CHECK(seen[i].error == no_error && seen[i].hash == hashes[i % count]);
+            }
+        }
+    }
+
+    CHECK(eml_ingest((const char **)paths, files, 2, stop_ingest, NULL) == out_of_range_error);
+    CHECK(eml_ingest((const char **)paths, 0, 2, ingested, seen) == no_error);
+
+    for (uint32_t i = 0; i < files; i++) {
+        free(paths[i]);
+    }
+}
+
+/*
+ * test_number_batch: The batch kernels agree with their scalar forms on both number forms, overflow included;
+ *                    conversions from double round half up & refuse what does not fit.
+ */
+static void test_number_batch(void) {
+    enum { count = 67 }; // Not a multiple of any vector width, so the tails run too
+    eml_number a[count], b[count], out[count], scalar;
+    int32_t order[count];
+    uint64_t sum = 0;
+    uint32_t seed = 12345;
+
+    for (uint32_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        a[i] = i % 2 ? (seed >> 8) % 100000 | eml_number_H : (seed >> 8) % 1000;
+        seed = seed * 1103515245 + 12345;
+        b[i] = i % 3 ? (seed >> 8) % 100000 | eml_number_H : (seed >> 8) % 1000;
+    }
+
+    // 250 & 250.00 are the same number
+    a[0] = 250;
+    b[0] = 25000 | eml_number_H;
+
+    for (uint32_t i = 0; i < count; i++) {
+        sum += eml_number_hundredths(a[i]);
+    }
+
+    eml_number_normalize_batch(a, out, count);
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK(out[i] == eml_number_normalize(a[i]));
+    }
+
+    CHECK(eml_number_add_batch(a, b, out, count) == no_error);
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK(eml_number_add(a[i], b[i], &scalar) == no_error && out[i] == scalar);
+    }
+
+    CHECK(eml_number_multiply_batch(a, b, out, count) == no_error);
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK(eml_number_multiply(a[i], b[i], &scalar) == no_error && out[i] == scalar);
+    }
+
+    eml_number_compare_batch(a, b, order, count);
+    CHECK(order[0] == 0);
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK(order[i] == eml_number_compare(a[i], b[i]));
+    }
+
+    CHECK(eml_number_sum_batch(a, count) == sum);
+
+    // In place
+    memcpy(out, a, sizeof(a));
+    eml_number_normalize_batch(out, out, count);
+    CHECK(eml_number_compare(out[count - 1], a[count - 1]) == 0 && (out[count - 1] & eml_number_H));
+
+    // One overflowing lane fails the batch
+    a[count - 1] = eml_number_mask;
+    b[count - 1] = eml_number_mask;
+    CHECK(eml_number_add_batch(a, b, out, count) == fp_overflow_error);
+    CHECK(eml_number_multiply_batch(a, b, out, count) == fp_overflow_error);
+    CHECK(eml_number_add(a[count - 1], b[count - 1], &scalar) == fp_overflow_error);
+
+    eml_number e;
+    CHECK(eml_number_from_double(102.125, &e) == no_error && eml_number_hundredths(e) == 10213);
+    CHECK(eml_number_from_double(0.004, &e) == no_error && eml_number_hundredths(e) == 0);
+    CHECK(eml_number_to_double(1250 | eml_number_H) == 12.5 && eml_number_to_double(12) == 12.0);
+    CHECK(eml_number_from_double(-1.0, &e) == out_of_range_error);
+    CHECK(eml_number_from_double(0.0 / 0.0, &e) == out_of_range_error);
+    CHECK(eml_number_from_double(1e9, &e) == out_of_range_error);
+}
+
+/*
+ * test_intern: Equal work in interned results is one node, owned by the table & read-only; a parse_exact() result
+ *              interns copies; interning again is a no-op, into another table an error. Results still compare equal.
+ */
+static void test_intern(void) {
+    eml_result *a = parsed(HEADER "\"squat\":5x5@100;\"bench\":3x(5,4,3);\"lunge\":2x10:2x8;");
+    eml_result *b = parsed(HEADER "super(\"row\":5x5@100;\"curl\":3x(5,4,3););\"plank\":;");
+    eml_result *a_copy = parsed(HEADER "\"squat\":5x5@100;\"bench\":3x(5,4,3);\"lunge\":2x10:2x8;");
+    char text[] = HEADER "\"squat\":2x10;\"dip\":5x5@100;";
+    eml_result *exact;
+    eml_work_table *table, *other;
+
+    CHECK(a != NULL && b != NULL && a_copy != NULL && parse_exact(text, strlen(text), &exact) == no_error);
+    CHECK(eml_work_table_create(&table) == no_error && eml_work_table_create(&other) == no_error);
+    if (a == NULL || b == NULL || a_copy == NULL || exact == NULL || table == NULL || other == NULL) {
+        return;
+    }
+
+    CHECK(eml_work_intern(table, a) == no_error && eml_work_intern(table, b) == no_error);
+    CHECK(eml_work_intern(table, exact) == no_error);
+    CHECK(eml_work_intern(table, a) == no_error && eml_work_intern(other, a) == shared_work_error);
+
+    eml_single_t *squat = &a->objs[0].data.single, *bench = &a->objs[1].data.single;
+    eml_super_t *super = &b->objs[0].data.super;
+    CHECK(squat->standard_work == super->members[0].standard_work);
+    CHECK(bench->standard_varied_work == super->members[1].standard_varied_work);
+    CHECK(exact->objs[0].data.single.standard_work == a->objs[2].data.single.asymmetric_work->left_standard_k);
+    CHECK(exact->objs[1].data.single.standard_work == squat->standard_work);
+
+    // 5x5@100, 3x(5,4,3), 2x10, 2x8 & no work
+    eml_work_stats stats;
+    eml_work_table_stats(table, &stats);
+    CHECK(stats.unique == 5 && stats.references == 9);
+    CHECK(stats.bytes_saved == sizeof(eml_standard_k) + sizeof(eml_standard_varied_k) + 3 * sizeof(eml_reps));
+
+    CHECK(eml_equal(a, a_copy) && eml_hash(a) == eml_hash(a_copy));
+    CHECK(eml_convert_weight(a, "kg") == shared_work_error);
+
+    free_result(a);
+    free_result(b);
+    free_result(exact);
+    free_result(a_copy);
+    eml_work_table_free(table);
+    eml_work_table_free(other);
+}
+
+/*
+ * test_template: Instantiating equals parsing the text the template writes for the same values; malformed or
+ *                misplaced placeholders & values that do not fit are refused.
+ */
+static void test_template(void) {
+    const char *text = HEADER "\"squat\":5x$0@$1;super(\"row\":3x(8,$0,6)%$2;\"lunge\":2x$3:2x$3@$1;);\"$0\":1x1;";
+    eml_number values[][4] = {
+        {5, 100, 8, 10},
+        {12, 22550 | eml_number_H, 750 | eml_number_H, 1},
+    };
+    eml_template *tmpl;
+
+    CHECK(eml_template_compile(text, strlen(text), &tmpl) == no_error);
+    if (tmpl == NULL) {
+        return;
+    }
+    CHECK(eml_template_slots(tmpl) == 4);
+
+    for (uint32_t i = 0; i < 2; i++) {
+        char buffer[256];
+        uint32_t length;
+        eml_result *result;
+
+        CHECK(eml_template_write(tmpl, values[i], 4, buffer, sizeof(buffer), &length) == no_error);
+        CHECK(length == strlen(buffer) && strstr(buffer, "\"$0\"") != NULL);
+
+        eml_result *expected = parsed(buffer);
+        CHECK(eml_template_instantiate(tmpl, values[i], 4, &result) == no_error && expected != NULL);
+        if (result != NULL && expected != NULL) {
+            CHECK(result->block != NULL && eml_equal(result, expected) && eml_hash(result) == eml_hash(expected));
+        }
+        free_result(result);
+        free_result(expected);
+
+        // Too small: the length needed comes back
+        uint32_t needed;
+        CHECK(eml_template_write(tmpl, values[i], 4, buffer, 8, &needed) == out_of_range_error && needed == length);
+    }
+
+    // Wrong value counts, a fractional reps value & an integral part past the eml_number range
+    eml_number fractional[] = {550 | eml_number_H, 100, 8, 10};
+    eml_number huge[] = {5, 100000000, 8, 10};
+    eml_result *result;
+    CHECK(eml_template_instantiate(tmpl, values[0], 3, &result) == template_error && result == NULL);
+    CHECK(eml_template_instantiate(tmpl, fractional, 4, &result) == fractional_none_modifier_value_error);
+    CHECK(eml_template_instantiate(tmpl, huge, 4, &result) == integral_overflow_error);
+    eml_template_free(tmpl);
+
+    const char *malformed[] = {
+        HEADER "\"squat\":5x$;",
+        HEADER "\"squat\":5x$0.5;",
+        HEADER "\"squat\":5x1$0;",
+        HEADER "\"squat\":$0x5;",
+        HEADER "\"squat\":5x$0@$0.5;",
+    };
+    for (uint32_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        CHECK(eml_template_compile(malformed[i], strlen(malformed[i]), &tmpl) == template_error && tmpl == NULL);
+    }
+
+    // The text must parse once the placeholders are filled in
+    const char *broken = HEADER "\"squat\"5x$0;";
+    CHECK(eml_template_compile(broken, strlen(broken), &tmpl) != no_error && tmpl == NULL);
+}
+
+/*
+ * test_parse_parallel: A large document parses as parse_length() parses it, whatever its chunks: the same result, or
+ *                      the same error at the same offset once bytes anywhere in it are changed, added or removed.
+ */
+static void test_parse_parallel(void) {
+    static const char alphabet[] = "\"x(),:;@%.FTsc{0123456789";
+    uint32_t capacity = 5 * PARALLEL_MIN_CHUNK + 256, length = strlen(HEADER);
+    char *document = malloc(capacity), *copy = malloc(capacity);
+
+    // Sample bodies, their headers dropped, repeated under one header
+    memcpy(document, HEADER, length);
+    for (uint32_t i = 1; length < 5 * PARALLEL_MIN_CHUNK; i = i % (sizeof(samples) / sizeof(samples[0]) - 1) + 1) {
+        const char *body = strchr(samples[i], '}') + 1;
+        memcpy(document + length, body, strlen(body));
+        length += strlen(body);
+    }
+
+    uint32_t seed = 46;
+    for (uint32_t round = 0; round < 64; round++) {
+        uint32_t n = length;
+        memcpy(copy, document, length);
+
+        // Round 0 is the document as built; later rounds change 1 to 3 bytes past the header
+        for (uint32_t k = 0; k < (round ? 1 + round % 3 : 0); k++) {
+            seed = seed * 1103515245 + 12345;
+            uint32_t at = strlen(HEADER) + (seed >> 8) % (n - strlen(HEADER));
+            char byte = alphabet[(seed >> 4) % (sizeof(alphabet) - 1)];
+
+            switch (round % 3) {
+                case 0:
+                    copy[at] = byte;
+                    break;
+                case 1:
+                    memmove(copy + at, copy + at + 1, n - at - 1);
+                    n--;
+                    break;
+                default:
+                    memmove(copy + at + 1, copy + at, n - at);
+                    copy[at] = byte;
+                    n++;
+                    break;
+            }
+        }
+
+        eml_result *expected, *result;
+        int error = parse_length(copy, n, &expected);
+        uint32_t offset = parse_error_offset();
+
+        CHECK(round || error == no_error);
+        CHECK(parse_parallel(copy, n, 4, &result) == error && parse_error_offset() == offset);
+        CHECK(error != no_error || (result != NULL && eml_equal(result, expected)));
+        CHECK(error == no_error || result == NULL);
+        free_result(expected);
+        free_result(result);
+    }
+
+    free(document);
+    free(copy);
+}
+
+/*
+ * test_diff: Singles match by name in order; each kind of difference is found once, past `capacity` too; weights are
+ *            compared in the planned unit, converted as eml_convert_weight() converts, & unknown units are refused.
+ */
+static void test_diff(void) {
+    eml_result *planned = parsed(HEADER "\"squat\":5x5@100;\"bench\":3x(5,4,3)@80;super(\"row\":3x8;\"curl\":3x10;);");
+    eml_result *performed = parsed(HEADER "\"bench\":3x(5,4,2)@80;\"squat\":4x5@105;super(\"row\":3x(8,8,8);)\"dip\":3x10;");
+    eml_difference differences[8];
+    uint32_t found;
+
+    CHECK(planned != NULL && performed != NULL);
+    CHECK(eml_diff(planned, performed, differences, 8, &found) == no_error && found == 5);
+    CHECK(differences[0].kind == set_count_change && differences[0].planned == 5 && differences[0].performed == 4);
+    CHECK(differences[1].kind == reps_modifier_change && differences[1].set == EML_DIFF_EVERY_SET);
+    CHECK(differences[1].planned == 100 && differences[1].performed == 105 && differences[1].performed_obj == 1);
+    CHECK(differences[2].kind == reps_value_change && differences[2].set == 2 && differences[2].performed == 2);
+    CHECK(differences[3].kind == missing_exercise && differences[3].planned_obj == 2 && differences[3].planned_member == 1);
+    CHECK(differences[4].kind == extra_exercise && differences[4].performed_obj == 3);
+
+    // Only `capacity` are written, all are counted
+    eml_difference first[2];
+    CHECK(eml_diff(planned, performed, first, 2, &found) == no_error && found == 5);
+    CHECK(memcmp(first, differences, sizeof(first)) == 0);
+    CHECK(eml_diff(planned, planned, differences, 8, &found) == no_error && found == 0);
+    free_result(performed);
+
+    // 100lbs is 45.36kg to the hundredth; a difference gives the performed weight in lbs, as eml_convert_weight() would
+    eml_result *plan = parsed(HEADER "\"squat\":5x5@100;");
+    eml_result *same = parsed("{\"version\":\"1.0\",\"weight\":\"kg\"}\"squat\":5x5@45.36;");
+    eml_result *heavier = parsed("{\"version\":\"1.0\",\"weight\":\"kg\"}\"squat\":5x5@50;");
+    eml_result *lbs = parsed("{\"version\":\"1.0\",\"weight\":\"kg\"}\"squat\":5x5@50;");
+
+    CHECK(plan != NULL && same != NULL && heavier != NULL && lbs != NULL && eml_convert_weight(lbs, "lbs") == no_error);
+    CHECK(eml_diff(plan, same, differences, 8, &found) == no_error && found == 0);
+    CHECK(eml_diff(same, plan, differences, 8, &found) == no_error && found == 0);
+    CHECK(eml_diff(plan, heavier, differences, 8, &found) == no_error && found == 1);
+    CHECK(differences[0].kind == reps_modifier_change && differences[0].planned == 100);
+    CHECK(differences[0].performed == lbs->objs[0].data.single.standard_work->reps.modifier.weight);
+    CHECK(eml_diff(heavier, plan, differences, 8, &found) == no_error && found == 1);
+    CHECK(differences[0].kind == reps_modifier_change && differences[0].performed == (4536 | eml_number_H));
+
+    // Units that are not lbs & kg compare only with themselves
+    eml_result *stone = parsed("{\"version\":\"1.0\",\"weight\":\"stone\"}\"squat\":5x5@7;");
+    CHECK(stone != NULL);
+    CHECK(eml_diff(planned, stone, differences, 8, &found) == unknown_weight_unit_error && found == 0);
+    CHECK(eml_diff(stone, planned, differences, 8, &found) == unknown_weight_unit_error);
+    CHECK(eml_diff(stone, stone, differences, 8, &found) == no_error && found == 0);
+
+    free_result(planned);
+    free_result(plan);
+    free_result(same);
+    free_result(heavier);
+    free_result(lbs);
+    free_result(stone);
+}
+
+/*
+ * csv_collect: An eml_csv_sink appending to the byte_buffer `context`; fails once it holds more than 64 KiB.
+ */
+static int csv_collect(const char *data, uint32_t length, void *context) {
+    byte_buffer *b = context;
+    return b->length > 65536 || buffer_bytes(b, data, length);
+}
+
+/*
+ * test_csv: Documents transcode to one row per set group (or set) under their chosen header values, the same for
+ *           any split of the input; the modifier columns do not clash with a "weight" header column; errors stop it.
+ */
+static void test_csv(void) {
+    static const char *columns[] = {"weight", "coach"};
+    static const char expected[] =
+        "weight,coach,document,object,type,member,exercise,side,set,sets,reps,failure,time,weight_value,rpe_value\n"
+        "kg,sam,0,0,super,0,squat,both,,5,5,0,0,100,\n"
+        "kg,sam,0,0,super,1,row,both,,3,8,0,0,,\n"
+        "kg,sam,0,1,single,0,curl,both,,3,10,0,0,,\n"
+        "lbs,,1,0,single,0,sl-rdl,left,0,1,4,0,0,120,\n"
+        "lbs,,1,0,single,0,sl-rdl,left,1,1,3,0,0,30,\n"
+        "lbs,,1,0,single,0,sl-rdl,left,2,1,2,0,0,120,\n"
+        "lbs,,1,0,single,0,sl-rdl,left,3,1,1,0,0,120,\n"
+        "lbs,,1,0,single,0,sl-rdl,right,0,1,,1,0,55.50,\n"
+        "lbs,,1,0,single,0,sl-rdl,right,1,1,,1,0,55.50,\n"
+        "lbs,,1,0,single,0,sl-rdl,right,2,1,,1,0,55.50,\n"
+        "lbs,,1,1,single,0,\"a,b\",both,,0,,,,,\n"
+        "lbs,,1,2,single,0,c,both,,2,5,0,0,,8.50\n";
+    const char *input = "{\"version\":\"1.0\",\"weight\":\"kg\",\"coach\":\"sam\"}super(\"squat\":5x5@100;\"row\":3x8;);\"curl\":3x10;"
+        HEADER "\"sl-rdl\":4x(4,3@30,2,1)@120:3x(F,F,F)@55.5;\"a,b\":;\"c\":2x5%8.5;";
+    uint32_t length = strlen(input);
+
+    // Whole, then in chunks of 1 & 7 bytes
+    for (uint32_t chunk = length; chunk > 0; chunk = chunk == length ? 7 : chunk == 7 ? 1 : 0) {
+        byte_buffer out = {NULL, 0, 0};
+        eml_csv_writer *csv;
+        int error = eml_csv_open(columns, 2, csv_set_groups, csv_collect, &out, &csv);
+
+        for (uint32_t i = 0; i < length && !error; i += chunk) {
+            error = eml_csv_write(csv, input + i, length - i < chunk ? length - i : chunk);
+        }
+
+        CHECK(error == no_error && eml_csv_close(csv) == no_error);
+        CHECK(out.length == strlen(expected) && memcmp(out.data, expected, out.length) == 0);
+        free(out.data);
+    }
+
+    // A row per set, standard work expanded
+    byte_buffer out = {NULL, 0, 0};
+    eml_csv_writer *csv;
+    uint32_t rows = 0;
+
+    CHECK(eml_csv_open(NULL, 0, csv_sets, csv_collect, &out, &csv) == no_error);
+    CHECK(eml_csv_write(csv, samples[1], strlen(samples[1])) == no_error && eml_csv_close(csv) == no_error);
+    for (uint32_t i = 0; i < out.length; i++) {
+        rows += out.data[i] == '\n';
+    }
+    CHECK(rows == 6 && memcmp(out.data, "document,", 9) == 0);
+    free(out.data);
+
+    // A document with an error stops the writer, which returns the error again
+    const char *broken = broken_samples[1];
+    out = (byte_buffer){NULL, 0, 0};
+    CHECK(eml_csv_open(NULL, 0, csv_sets, csv_collect, &out, &csv) == no_error);
+    int error = eml_csv_write(csv, broken, strlen(broken));
+    CHECK(error == parse_error(broken) && eml_csv_write(csv, samples[1], strlen(samples[1])) == error);
+    CHECK(eml_csv_close(csv) == error);
+    free(out.data);
+
+    // A failing sink
+    out = (byte_buffer){NULL, 0, 0};
+    CHECK(eml_csv_open(NULL, 0, csv_sets, csv_collect, &out, &csv) == no_error);
+    for (uint32_t i = 0; i < 4096 && (error = eml_csv_write(csv, samples[2], strlen(samples[2]))) == no_error; i++) {
+    }
+    CHECK(error == io_error && eml_csv_close(csv) == io_error);
+    free(out.data);
+}
+
+/*
+ * test_lazy: Each object parses on demand (once) to what parse() makes of it; finding names parses nothing; errors
+ *            in the walk are found at open, those in an object when it is asked for, at their document offset.
+ */
+static void test_lazy(void) {
+    for (uint32_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        char *copy = strdup(samples[i]);
+        eml_result *expected = parsed(samples[i]);
+        eml_lazy *lazy;
+
+        CHECK(expected != NULL && eml_lazy_open(copy, strlen(copy), &lazy) == no_error);
+        if (expected == NULL || lazy == NULL) {
+            free_result(expected);
+            free(copy);
+            continue;
+        }
+
+        eml_result a = {eml_lazy_header(lazy), NULL, 0, 0, NULL, NULL};
+        eml_result b = {expected->header, NULL, 0, 0, NULL, NULL};
+        CHECK(eml_equal(&a, &b) && eml_lazy_count(lazy) == expected->count);
+
+        for (uint32_t j = 0; j < eml_lazy_count(lazy); j++) {
+            eml_obj *obj, *again;
+
+            CHECK(eml_lazy_object(lazy, j, &obj) == no_error && eml_lazy_object(lazy, j, &again) == no_error);
+            a = (eml_result){NULL, obj, 1, 1, NULL, NULL};
+            b = (eml_result){NULL, &expected->objs[j], 1, 1, NULL, NULL};
+            CHECK(obj == again && eml_equal(&a, &b) && eml_lazy_at(lazy, j)->type == obj->type);
+        }
+
+        eml_obj *obj;
+        CHECK(eml_lazy_at(lazy, expected->count) == NULL);
+        CHECK(eml_lazy_object(lazy, expected->count, &obj) == out_of_range_error);
+        eml_lazy_free(lazy);
+        free_result(expected);
+        free(copy);
+    }
+
+    // Singles are found by name, members of supers & circuits too, without parsing them
+    char document[] = HEADER "circuit(\"squat\":5x5;\"lunge\":2x10;);\"squat\":3x3;\"squat\"::;";
+    eml_lazy *lazy;
+    uint32_t i;
+
+    CHECK(eml_lazy_open(document, strlen(document), &lazy) == no_error && eml_lazy_count(lazy) == 3);
+    CHECK(eml_lazy_find(lazy, "lunge", 0, &i) && i == 0 && !eml_lazy_find(lazy, "lunge", 1, &i));
+    CHECK(eml_lazy_find(lazy, "squat", 1, &i) && i == 1 && eml_lazy_find(lazy, "squat", 2, &i) && i == 2);
+    CHECK(!eml_lazy_find(lazy, "squa", 0, &i) && !eml_lazy_find(lazy, "squat", 3, &i));
+    CHECK(eml_lazy_at(lazy, 1)->name_length == 5 && eml_lazy_at(lazy, 0)->name_length == 0);
+    CHECK(lazy->results[0] == NULL && lazy->results[1] == NULL && lazy->results[2] == NULL);
+    eml_lazy_free(lazy);
+
+    // A header error or a character no object starts with is found at open
+    char no_version[] = "{\"weight\":\"lbs\"}\"squat\":5x5;";
+    char stray[] = HEADER "\"squat\":5x5;x\"bench\":3x3;";
+    CHECK(eml_lazy_open(no_version, strlen(no_version), &lazy) == missing_version && lazy == NULL);
+    CHECK(eml_lazy_open(stray, strlen(stray), &lazy) == unexpected_error && lazy == NULL);
+    CHECK(parse_error_offset() == strlen(HEADER "\"squat\":5x5;"));
+
+    // As is a header token without its value, at the '}' ending it
+    char no_value[] = "{\"weight\"}\"squat\":5x5;";
+    char empty_value[] = "{\"version\":\"1.0\",\"weight\":}";
+    CHECK(eml_lazy_open(no_value, strlen(no_value), &lazy) == unexpected_error && lazy == NULL);
+    CHECK(parse_error_offset() == strlen("{\"weight\""));
+    CHECK(eml_lazy_open(empty_value, strlen(empty_value), &lazy) == unexpected_error && lazy == NULL);
+    CHECK(parse_error_offset() == strlen(empty_value) - 1);
+
+    // An object's error, only when it is parsed, at the offset parse_length() finds it
+    for (uint32_t k = 1; k < 4; k++) {
+        char *copy = strdup(broken_samples[k]);
+        int error = parse_error(broken_samples[k]);
+        uint32_t offset = parse_error_offset();
+        eml_obj *obj;
+
+        CHECK(eml_lazy_open(copy, strlen(copy), &lazy) == no_error && eml_lazy_count(lazy) == 1);
+        CHECK(eml_lazy_object(lazy, 0, &obj) == error && parse_error_offset() == offset);
+        eml_lazy_free(lazy);
+        free(copy);
+    }
+}
+
+/*
+ * same_aggregates: Whether two sets of aggregates hold the same exercise sides in the same order, totals & bests.
+ */
+static bool same_aggregates(eml_aggregates *a, eml_aggregates *b) {
+    if (eml_aggregates_count(a) != eml_aggregates_count(b)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < eml_aggregates_count(a); i++) {
+        const eml_aggregate *x = eml_aggregates_at(a, i);
+        const eml_aggregate *y = eml_aggregates_at(b, i);
+
+        if (strcmp(x->name, y->name) != 0 || x->side != y->side || x->sets != y->sets || x->reps != y->reps
+            || x->tonnage != y->tonnage || x->last != y->last || x->best_count != y->best_count
+            || (x->best_count && memcmp(x->bests, y->bests, sizeof(eml_aggregate_best) * x->best_count) != 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * test_aggregates: Saved aggregates load equal & keep adding as if never saved; a damaged or short file is the
+ *                  format's error, a missing one an io_error; a failed save leaves no file behind.
+ */
+static void test_aggregates(void) {
+    eml_session sessions[3] = {{-5, parsed(samples[2])}, {100, parsed(samples[3])}, {200, parsed(samples[5])}};
+    eml_aggregates *aggregates, *loaded = NULL;
+    const char *path = strdup(scratch_path("aggregates"));
+
+    CHECK(sessions[0].result != NULL && sessions[1].result != NULL && sessions[2].result != NULL);
+    CHECK(eml_aggregates_create(&aggregates) == no_error);
+    CHECK(eml_aggregates_add(aggregates, &sessions[0]) == no_error && eml_aggregates_add(aggregates, &sessions[1]) == no_error);
+    CHECK(eml_aggregates_save(aggregates, path) == no_error && access(scratch_path("aggregates.tmp"), F_OK) != 0);
+    CHECK(eml_aggregates_load(path, &loaded) == no_error && same_aggregates(aggregates, loaded));
+
+    const eml_aggregate *squat = eml_aggregates_find(loaded, "squat", both_sides);
+    CHECK(squat != NULL && squat->last == -5 && squat->sets == 5 && squat->reps == 15 && squat->best_count == 5);
+    CHECK(eml_aggregates_find(loaded, "sl-rdl", right_side) != NULL && eml_aggregates_find(loaded, "sl-rdl", both_sides) == NULL);
+
+    CHECK(eml_aggregates_add(aggregates, &sessions[2]) == no_error && eml_aggregates_add(loaded, &sessions[2]) == no_error);
+    CHECK(same_aggregates(aggregates, loaded) && eml_aggregates_find(loaded, "squat", both_sides)->last == 200);
+    eml_aggregates_free(loaded);
+
+    // Damage anywhere, a short file or another format's magic is refused; nothing is returned
+    uint64_t length;
+    uint8_t *data;
+    CHECK(eml_aggregates_save(aggregates, path) == no_error && (data = read_file(path, &length)) != NULL);
+    for (uint64_t at = 0; data != NULL && at < length; at += 7) {
+        data[at] ^= 0x20;
+        rewrite_file(path, data, length);
+        CHECK(eml_aggregates_load(path, &loaded) == aggregate_format_error && loaded == NULL);
+        data[at] ^= 0x20;
+    }
+
+    for (uint64_t cut = 0; data != NULL && cut < length; cut += 5) {
+        rewrite_file(path, data, cut);
+        CHECK(eml_aggregates_load(path, &loaded) == aggregate_format_error && loaded == NULL);
+    }
+    free(data);
+
+    CHECK(eml_aggregates_load(scratch_path("no-aggregates"), &loaded) == io_error && loaded == NULL);
+    CHECK(eml_aggregates_save(aggregates, scratch_path("missing/aggregates")) == io_error);
+
+    eml_aggregates_free(aggregates);
+    for (uint32_t i = 0; i < 3; i++) {
+        free_result(sessions[i].result);
+    }
+    free((char *)path);
+}
+
+/*
+ * test_rollup: Weekly series per exercise side, the same whatever the thread count; workless sessions roll up to none.
+ */
+static void test_rollup(void) {
+    eml_result *week1 = parsed(HEADER "\"squat\":5x5@100;\"lunge\":2x10@20:2x8@20;");
+    eml_result *week1b = parsed(HEADER "\"squat\":1x1@120;\"plank\":3x60T;");
+    eml_result *week2 = parsed(HEADER "\"squat\":3x(3@110,2@110,1F@110);");
+    eml_result *empty = parsed(HEADER);
+    CHECK(week1 != NULL && week1b != NULL && week2 != NULL && empty != NULL);
+    if (week1 == NULL || week1b == NULL || week2 == NULL || empty == NULL) {
+        return;
+    }
+
+    eml_session sessions[] = {{0, week1}, {86400, week1b}, {ROLLUP_WEEK + 5, week2}, {2 * ROLLUP_WEEK, empty}};
+    eml_rollup *rollup, *threaded;
+
+    CHECK(eml_rollup_build(sessions, 4, 1, &rollup) == no_error);
+    CHECK(eml_rollup_build(sessions, 4, 4, &threaded) == no_error);
+    if (rollup == NULL || threaded == NULL) {
+        return;
+    }
+
+    // lunge left, lunge right, plank (whose timed sets add nothing), squat
+    CHECK(rollup->count == 4 && threaded->count == 4);
+    CHECK(strcmp(rollup->series[0].name, "lunge") == 0 && rollup->series[0].side == left_side);
+    CHECK(rollup->series[1].side == right_side && rollup->series[1].points[0].volume == 2 * 8 * 2000);
+    CHECK(strcmp(rollup->series[2].name, "plank") == 0 && rollup->series[2].points[0].volume == 0);
+
+    eml_rollup_series *squat = &rollup->series[3];
+    CHECK(strcmp(squat->name, "squat") == 0 && squat->side == both_sides && squat->count == 2);
+    CHECK(squat->points[0].week == 0 && squat->points[1].week == ROLLUP_WEEK);
+    CHECK(squat->points[0].volume == 5 * 5 * 10000 + 12000);
+    CHECK(squat->points[0].top_weight == 12000 && squat->points[0].top_reps == 1);
+    CHECK(squat->points[0].best_epley == 12000 && squat->points[0].best_brzycki == 12000);
+    CHECK(squat->points[1].best_epley == 12100 && squat->points[1].top_reps == 3);
+    CHECK(squat->points[1].volume == (3 + 2 + 1) * 11000);
+
+    for (uint32_t i = 0; i < rollup->count; i++) {
+        CHECK(strcmp(rollup->series[i].name, threaded->series[i].name) == 0 && rollup->series[i].count == threaded->series[i].count);
+        for (uint32_t j = 0; j < rollup->series[i].count && j < threaded->series[i].count; j++) {
+            CHECK(memcmp(&rollup->series[i].points[j], &threaded->series[i].points[j], sizeof(eml_rollup_point)) == 0);
+        }
+    }
+    eml_rollup_free(rollup);
+    eml_rollup_free(threaded);
+
+    // No work at all, & no sessions
+    CHECK(eml_rollup_build(&sessions[3], 1, 1, &rollup) == no_error && rollup->count == 0);
+    eml_rollup_free(rollup);
+    CHECK(eml_rollup_build(NULL, 0, 0, &rollup) == no_error && rollup->count == 0);
+    eml_rollup_free(rollup);
+
+    free_result(week1);
+    free_result(week1b);
+    free_result(week2);
+    free_result(empty);
+}
 
 int main(int argc, char const *argv[]) {
+    if (mkdtemp(scratch) == NULL) {
+        return 1;
+    }
+
     /* Basic */ 
     char emlstring[] = "{\"version\":\"1.0\",\"weight\":\"lbs\"}\"squat\":5x5;"; // standard
     // char emlstring[] = "{\"version\":\"1.0\",\"weight\":\"lbs\"}\"squat\":5x(5,4,3,2,1);"; // standard varied
@@ -49,7 +1546,7 @@ int main(int argc, char const *argv[]) {
         printf("Failed with error: %d\n", error);
         printf("%s\n", emlstring);
 
-        for(int i = 0; i < current_postition - 1; i++) {
+        for (uint32_t i = 0; i + 1 < parse_error_offset(); i++) {
             printf(" ");
         }
 
@@ -59,5 +1556,31 @@ int main(int argc, char const *argv[]) {
 
     print_result(result);
     free_result(result);
-    return 0;
+
+    test_super_members();
+    test_result_objects();
+    test_frozen();
+    test_convert_weight();
+    test_hash_equal();
+    test_query();
+    test_index();
+    test_corpus();
+    test_log();
+    test_stats();
+    test_parse_exact();
+    test_shared();
+    test_ingest();
+    test_number_batch();
+    test_intern();
+    test_template();
+    test_parse_parallel();
+    test_diff();
+    test_csv();
+    test_lazy();
+    test_aggregates();
+    test_rollup();
+
+    remove_scratch();
+    printf("%s\n", failures ? "Tests failed" : "Tests passed");
+    return failures != 0;
 }
@@ -0,0 +1,270 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "eml.hpp"
+#include "eml_static.hpp"
+
+/*
+ * test.cpp: Tests of the C++ headers. Build with the library compiled as C:
+ *
+ *           cc -c eml.c && c++ -std=c++17 -pthread test.cpp eml.o -o test_cpp
+ */
+
+#define HEADER "{\"version\":\"1.0\",\"weight\":\"lbs\"}"
+
+static int failures = 0;
+
+// Reports a failed expectation & keeps going, so one run lists every failure
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+/*
+ * same_work: Whether static work & frozen work hold the same reps.
+ */
+template <typename P>
+static bool same_work(const P &program, const eml_frozen_work &a, const eml_frozen *frozen, const eml_frozen_work &b) {
+    if (a.kind != b.kind || a.sets != b.sets || a.count != b.count) {
+        return false;
+    }
+
+    const eml_reps *x = a.count ? program.work_reps(a) : nullptr;
+    const eml_reps *y = b.count ? (const eml_reps *)eml_frozen_at(frozen, b.reps) : nullptr;
+    for (uint32_t i = 0; i < a.count; i++) {
+        if (x[i].type != y[i].type || x[i].value != y[i].value || x[i].modifier.weight != y[i].modifier.weight) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * same_as_parse: Whether a static program holds what parse() makes of `text`, compared through eml_freeze().
+ */
+template <typename P>
+static bool same_as_parse(const P &program, const char *text) {
+    std::string copy(text);
+    eml_result *result;
+    eml_frozen *frozen;
+
+    if (parse(copy.data(), &result) != no_error) {
+        return false;
+    }
+
+    int error = eml_freeze(result, &frozen);
+    free_result(result);
+    if (error != no_error) {
+        return false;
+    }
+
+    bool same = program.header_count == frozen->header_count && program.count == frozen->count;
+    const eml_frozen_header *headers = (const eml_frozen_header *)eml_frozen_at(frozen, frozen->header);
+    for (uint32_t i = 0; same && i < frozen->header_count; i++) {
+        const char *parameter = (const char *)eml_frozen_at(frozen, headers[i].parameter);
+        same = program.header(parameter) == (const char *)eml_frozen_at(frozen, headers[i].value);
+    }
+
+    const eml_frozen_obj *objs = (const eml_frozen_obj *)eml_frozen_at(frozen, frozen->objs);
+    for (uint32_t i = 0; same && i < frozen->count; i++) {
+        same = program.objs[i].type == objs[i].type && program.objs[i].count == objs[i].count;
+
+        const eml_frozen_single *a = program.members(program.objs[i]);
+        const eml_frozen_single *b = (const eml_frozen_single *)eml_frozen_at(frozen, objs[i].singles);
+        for (uint32_t j = 0; same && j < objs[i].count; j++) {
+            same = program.string(a[j].name) == (const char *)eml_frozen_at(frozen, b[j].name)
+                && a[j].asymmetric == b[j].asymmetric
+                && same_work(program, a[j].left_work, frozen, b[j].left_work)
+                && same_work(program, a[j].right_work, frozen, b[j].right_work);
+        }
+    }
+
+    free(frozen);
+    return same;
+}
+
+/*
+ * draft_error: Parses `text` as a literal would be, at run time, returning its eml_error & setting `offset`.
+ */
+template <uint32_t Length>
+static int draft_error(const char (&text)[Length], uint32_t *offset) {
+    auto draft = eml::detail::parse_draft<Length - 1>(std::string_view(text, Length - 1));
+    *offset = draft.error_offset;
+    return draft.error;
+}
+
+/*
+ * parse_error: Returns the error of parsing `text` & sets `offset` to parse_error_offset().
+ */
+static int parse_error(const char *text, uint32_t *offset) {
+    std::string copy(text);
+    eml_result *result;
+    int error = parse(copy.data(), &result);
+
+    if (error == no_error) {
+        free_result(result);
+    }
+    *offset = parse_error_offset();
+    return error;
+}
+
+#define STATIC_CASE(text) CHECK(same_as_parse(EML_STATIC(text), text))
+
+/*
+ * test_static: Literals parse at compile time to what parse() makes of them, into structures of exactly their size.
+ */
+static void test_static() {
+    STATIC_CASE(HEADER);
+    STATIC_CASE(HEADER "\"squat\":5x5;");
+    STATIC_CASE(HEADER "\"squat\":5x(5,4,3,2,1)@100;\"plyo-jump\":5x40T;");
+    STATIC_CASE(HEADER "\"sl-rdl\":4x(4,3@30,2,1)@120:3x(F,F,F)@55.5;");
+    STATIC_CASE(HEADER "\"sl-rdl\"::4x(4,3,2,1);\"squat\":;\"squat\"::;");
+    STATIC_CASE(HEADER "\"squat\":5x5%8.5;\"bench\":3x(5%7,4,3F)@102.25;");
+    STATIC_CASE("{\"version\":\"1.0\",\"weight\":\"kg\",\"coach\":\"sam\"}super(\"squat\":5x5@100;\"row\":3x8;);\"curl\":3x10;");
+    STATIC_CASE(HEADER "circuit(\"squat\":5x5;\"lunge\":2x10:2x8;\"plank\":3x60T;);super(\"a\":1x1;);");
+
+    // Sized to the literal: 1 object, 2 singles, 1 + 3 reps
+    constexpr auto program = EML_STATIC(HEADER "super(\"a\":5x5;\"b\":3x(1,2,3)@50;);");
+    static_assert(program.count == 1 && program.single_count == 2 && program.reps_count == 4);
+    static_assert(program.objs.size() == 1 && program.reps.size() == 4);
+    static_assert(program.header("weight") == "lbs" && program.header("coach").empty());
+    static_assert(program.string(program.singles[1].name) == "b" && program.reps[3].value == 3);
+}
+
+/*
+ * test_static_errors: A literal that does not parse fails with parse()'s error, found at the same byte.
+ */
+static void test_static_errors() {
+    static const char missing_separator[] = HEADER "\"squat\"5x5;";
+    static const char missing_reps[] = HEADER "\"squat\":5x(5,4);";
+    static const char fractional_sets[] = HEADER "\"squat\":5.5x5;";
+    static const char radix_points[] = HEADER "\"squat\":5x5@1.2.3;";
+    static const char empty_name[] = HEADER "\"\":5x5;";
+    static const char header_strings[] = "{\"version\":\"1.0\",\"weight\":\"lbs\"\"squat\":5x5;";
+    static const char no_version[] = "{\"weight\":\"lbs\"}\"squat\":5x5;";
+    static const char extra_rep[] = HEADER "\"squat\":5x(5,4,3,2,1)@1,00;";
+    static const char standard_comma[] = HEADER "\"squat\":5x5,5;";
+    static const char second_sets[] = HEADER "\"squat\":5x5@120.3x(1,2,3);";
+    static const char third_side[] = HEADER "\"sl-rdl\":4x4:3x3:2x2;";
+    static const char open_reps[] = HEADER "\"squat\":3x(5,4;";
+    static const char no_value[] = "{\"weight\"}";
+    static const char empty_value[] = "{\"weight\":}";
+    uint32_t offset, expected;
+
+    #define ERROR_CASE(text) \
+        CHECK(draft_error(text, &offset) == parse_error(text, &expected) && offset == expected && offset != 0)
+
+    ERROR_CASE(missing_separator);
+    ERROR_CASE(missing_reps);
+    ERROR_CASE(fractional_sets);
+    ERROR_CASE(radix_points);
+    ERROR_CASE(empty_name);
+    ERROR_CASE(header_strings);
+    ERROR_CASE(no_version);
+    ERROR_CASE(extra_rep);
+    ERROR_CASE(standard_comma);
+    ERROR_CASE(second_sets);
+    ERROR_CASE(third_side);
+    ERROR_CASE(open_reps);
+    ERROR_CASE(no_value);
+    ERROR_CASE(empty_value);
+
+    #undef ERROR_CASE
+}
+
+/*
+ * test_binding: Views wrap the result's own structs (names are its strings, not copies) with the work's kind as a
+ *               variant; results move, compare & free themselves; a failed parse leaves an empty result.
+ */
+static void test_binding() {
+    std::string text = HEADER "\"squat\":5x5@120.5;super(\"a\":3x(1,2F,3)@8;\"b\":2x5:;)circuit(\"c\"::2x(4T,3);)";
+    eml::result r;
+
+    CHECK(eml::result::parse(text, r) == no_error && r);
+    if (!r) {
+        return;
+    }
+
+    eml_result *c = r.get();
+    auto objects = r.objects();
+    CHECK(objects.size() == 3 && r.header("weight") == "lbs" && r.header("coach").empty());
+
+    uint32_t headers = 0;
+    for (eml::header h : r.headers()) {
+        CHECK(r.header(h.parameter) == h.value);
+        headers++;
+    }
+    CHECK(headers == 2);
+
+    // "squat": standard work, the name being the C string itself
+    eml::object first = objects[0];
+    auto squat = std::get_if<eml::single>(&first);
+    CHECK(squat != nullptr && squat->name() == "squat" && squat->name().data() == c->objs[0].data.single.name);
+    if (squat != nullptr) {
+        eml::work work = squat->work();
+        auto standard = std::get_if<eml::standard_work>(&work);
+        CHECK(standard != nullptr && standard->sets() == 5 && standard->rep().value() == 5);
+        CHECK(standard && standard->rep().weight() == (12050 | eml_number_H) && !standard->rep().rpe());
+    }
+
+    // super: varied reps with a failure & a weight macro, then asymmetric work with no right side work
+    eml::object second = objects[1];
+    auto super = std::get_if<eml::superset>(&second);
+    CHECK(super != nullptr && super->members().size() == 2);
+    if (super != nullptr) {
+        eml::work work = super->members()[0].work();
+        auto varied = std::get_if<eml::varied_work>(&work);
+        uint32_t values[3], i = 0;
+        bool failed[3];
+
+        CHECK(varied != nullptr);
+        for (eml::rep rep : varied ? varied->reps() : eml::reps_range()) {
+            values[i] = rep.value();
+            failed[i++] = rep.failure();
+            CHECK(rep.weight() == 8U && !rep.rpe());
+        }
+        CHECK(i == 3 && values[0] == 1 && values[2] == 3 && !failed[0] && failed[1]);
+
+        work = super->members()[1].work();
+        auto asymmetric = std::get_if<eml::asymmetric_work>(&work);
+        CHECK(asymmetric != nullptr && std::holds_alternative<eml::standard_work>(asymmetric->left()));
+    }
+
+    eml::object third = objects[2];
+    auto circuit = std::get_if<eml::circuit>(&third);
+    CHECK(circuit != nullptr && circuit->members().size() == 1);
+    if (circuit != nullptr) {
+        eml::work work = circuit->members()[0].work();
+        auto asymmetric = std::get_if<eml::asymmetric_work>(&work);
+        CHECK(asymmetric != nullptr && std::holds_alternative<eml::none_work>(asymmetric->left()));
+
+        eml::side_work side = asymmetric ? asymmetric->right() : eml::side_work();
+        auto right = std::get_if<eml::varied_work>(&side);
+        CHECK(right != nullptr && right->sets() == 2 && right->reps()[0].time() && !right->reps()[1].time());
+    }
+
+    // Moves hand over the C result; a parse_exact() result & a parse of a view into a longer string are equal
+    eml::result moved(std::move(r));
+    CHECK(!r && moved.get() == c);
+
+    eml::result exact, prefix;
+    std::string longer = text + "\"bench\":3x";
+    CHECK(eml::result::parse_exact(text, exact) == no_error && exact.get()->block != nullptr);
+    CHECK(eml::result::parse(std::string_view(longer).substr(0, text.size()), prefix) == no_error);
+    CHECK(exact == moved && prefix == moved && prefix.hash() == moved.hash());
+
+    exact = std::move(prefix);
+    CHECK(!prefix && exact == moved);
+
+    // A failed parse leaves the result empty, freeing what it held
+    CHECK(eml::result::parse(longer, exact) != no_error && !exact);
+}
+
+int main() {
+    test_static();
+    test_static_errors();
+    test_binding();
+
+    printf("%s\n", failures ? "Tests failed" : "Tests passed");
+    return failures != 0;
+}